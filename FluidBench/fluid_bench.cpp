@@ -0,0 +1,494 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+// throughput of the gpu solver. sweeps grid sizes, iteration counts and
+// pressure solvers, times the whole step and every pass on its own, and
+// writes the results as json to track regressions between commits. runs from
+// the FluidFlow directory, where the shaders are
+//
+// usage: FluidBench [--sizes 128,256,...] [--iterations 20,40,...]
+//     [--solvers jacobi,sor,multigrid,direct] [--dye n] [--samples n]
+//     [--warmup n] [--splats n] [--sparse] [--compute] [--no-fuse]
+//     [--context native|egl|osmesa] [--velocity-format f] [--pressure-format f]
+//     [--picture-format f] [--json results.json] [--label text]
+//
+// --splats sets how many impulses the force pass adds every run, spread
+// over the window like independent emitters. --sparse draws the passes over
+// the moving tiles only, which on the still fields of a bench is few of them.
+// --no-fuse times the velocity boundary in the boundary pass again instead
+// of inside the projection. the format flags take the texture formats of
+// FluidFlow's, like rg16f
+//
+// the window is never shown. machines without a gpu run it on a software
+// driver, mesa's llvmpipe through LIBGL_ALWAYS_SOFTWARE=1 on linux or its
+// opengl32.dll next to the exe on windows, or without any display through
+// --context osmesa
+
+
+struct BenchConfig {
+	std::string solver;
+	int gridResolution;
+	int iterations;
+};
+
+struct BenchResult {
+	BenchConfig config;
+	std::string pass;
+	int width;
+	int height;
+	int dyeWidth;
+	int dyeHeight;
+	int samples;
+	double medianMs;
+	double p99Ms;
+	double meanMs;
+	double cellsPerSecond;
+	double bytes;						// modelled traffic of one run, < 0 when there is no model
+};
+
+static const char* PASS_NAMES[] = {
+	"advection", "diffusion", "force", "pressure", "projection", "boundary", "newImage"
+};
+static const SimulationPass PASSES[] = {
+	SimulationPass::ADVECTION, SimulationPass::DIFFUSION, SimulationPass::FORCE, SimulationPass::PRESSURE,
+	SimulationPass::PROJECTION, SimulationPass::BOUNDARY, SimulationPass::NEW_IMAGE
+};
+static const int PASS_COUNT = 7;
+
+
+static std::vector<int> parseList(const char* text) {
+	std::vector<int> values;
+	for (const char* p = text; *p != '\0';) {
+		values.push_back(std::atoi(p));
+		const char* comma = std::strchr(p, ',');
+		if (comma == NULL) {
+			break;
+		}
+		p = comma + 1;
+	}
+	return values;
+}
+
+
+static std::vector<std::string> parseNames(const char* text) {
+	std::vector<std::string> names;
+	std::string list = text;
+	size_t start = 0;
+	while (start <= list.size()) {
+		size_t comma = list.find(',', start);
+		if (comma == std::string::npos) {
+			comma = list.size();
+		}
+		if (comma > start) {
+			names.push_back(list.substr(start, comma - start));
+		}
+		start = comma + 1;
+	}
+	return names;
+}
+
+
+// least bytes a pass has to read and write, with texels of the fields'
+// formats. the solves touch the unknown, the right hand side and the result
+// in every iteration. the pressure pass first writes the divergence of the
+// velocity, its right hand side, as r32f. the force blends into the
+// splatCells its quads cover. the boundary pass reads and writes the
+// borderCells and copies them back to the read side, fused it only has the
+// pressure left. multigrid and the direct solve have no simple model
+static double passBytes(SimulationPass pass, const std::string& solver, int iterations, double cells, double dyeCells,
+	double splatCells, double borderCells, const FieldFormats& formats, bool fused) {
+	const double VELOCITY = (double)PingPongField::texelBytes(formats.velocity);
+	const double PRESSURE = (double)PingPongField::texelBytes(formats.pressure);
+	const double PICTURE = (double)PingPongField::texelBytes(formats.picture);
+	const double DIVERGENCE = (double)PingPongField::texelBytes(GL_R32F);
+
+	switch (pass) {
+	case SimulationPass::ADVECTION: return 2.0 * VELOCITY * cells;
+	case SimulationPass::DIFFUSION: return 3.0 * VELOCITY * cells * iterations;
+	case SimulationPass::FORCE: return 2.0 * VELOCITY * splatCells;
+	case SimulationPass::PRESSURE:
+		return solver == "jacobi" || solver == "sor" ?
+			(VELOCITY + DIVERGENCE) * cells + (2.0 * PRESSURE + DIVERGENCE) * cells * iterations : -1.0;
+	case SimulationPass::PROJECTION: return (2.0 * VELOCITY + PRESSURE) * cells;
+	case SimulationPass::BOUNDARY: return (fused ? 4.0 * PRESSURE : 4.0 * (VELOCITY + PRESSURE)) * borderCells;
+	case SimulationPass::NEW_IMAGE: return 2.0 * PICTURE * dyeCells + VELOCITY * cells;
+	}
+	return -1.0;
+}
+
+
+// milliseconds of every sample of run. consecutive gpu timestamps bracket
+// the samples, so the gpu never idles between them. drivers without
+// timestamps get cpu time around a glFinish per sample instead
+static std::vector<double> timeSamples(const std::function<void()>& run, int warmup, int samples, bool timestamps) {
+	for (int i = 0; i < warmup; i++) {
+		run();
+	}
+	glFinish();
+
+	std::vector<double> milliseconds(samples);
+	if (!timestamps) {
+		for (int i = 0; i < samples; i++) {
+			auto start = std::chrono::steady_clock::now();
+			run();
+			glFinish();
+			milliseconds[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		return milliseconds;
+	}
+
+	std::vector<unsigned int> queries(samples + 1);
+	glGenQueries(samples + 1, queries.data());
+	glQueryCounter(queries[0], GL_TIMESTAMP);
+	for (int i = 0; i < samples; i++) {
+		run();
+		glQueryCounter(queries[i + 1], GL_TIMESTAMP);
+	}
+
+	std::vector<GLuint64> times(samples + 1);
+	for (int i = 0; i <= samples; i++) {
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &times[i]);
+	}
+	glDeleteQueries(samples + 1, queries.data());
+
+	for (int i = 0; i < samples; i++) {
+		milliseconds[i] = (times[i + 1] - times[i]) / 1000000.0;
+	}
+	return milliseconds;
+}
+
+
+static BenchResult summarize(const BenchConfig& config, const char* pass, const Simulation& sim,
+	std::vector<double> milliseconds, double cells, double bytes) {
+
+	BenchResult result;
+	result.config = config;
+	result.pass = pass;
+	result.width = sim.fieldWidth();
+	result.height = sim.fieldHeight();
+	result.dyeWidth = sim.pictureWidth();
+	result.dyeHeight = sim.pictureHeight();
+	result.samples = (int)milliseconds.size();
+
+	std::sort(milliseconds.begin(), milliseconds.end());
+	double sum = 0.0;
+	for (double value : milliseconds) {
+		sum += value;
+	}
+	size_t count = milliseconds.size();
+	result.medianMs = count % 2 == 1 ? milliseconds[count / 2] :
+		0.5 * (milliseconds[count / 2 - 1] + milliseconds[count / 2]);
+	result.p99Ms = milliseconds[(size_t)std::ceil(0.99 * count) - 1];	// nearest rank
+	result.meanMs = sum / count;
+
+	result.cellsPerSecond = result.medianMs > 0.0 ? cells / (result.medianMs / 1000.0) : 0.0;
+	result.bytes = bytes;
+	return result;
+}
+
+
+static void printResult(const BenchResult& result) {
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-9s %5dx%-5d %4d it  %-10s %9.3f ms  p99 %9.3f ms  %10.1f Mcells/s",
+		result.config.solver.c_str(), result.width, result.height, result.config.iterations, result.pass.c_str(),
+		result.medianMs, result.p99Ms, result.cellsPerSecond / 1e6);
+	std::cout << line;
+	if (result.bytes >= 0.0 && result.medianMs > 0.0) {
+		std::snprintf(line, sizeof(line), "  %7.2f GB/s", result.bytes / (result.medianMs / 1000.0) / 1e9);
+		std::cout << line;
+	}
+	std::cout << std::endl;
+}
+
+
+static std::string jsonString(const std::string& text) {
+	std::string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			quoted += '\\';
+			quoted += c;
+		}
+		else if ((unsigned char)c < 0x20) {
+			char escape[8];
+			std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+			quoted += escape;
+		}
+		else {
+			quoted += c;
+		}
+	}
+	return quoted + "\"";
+}
+
+
+static bool writeJson(const std::string& path, const std::string& label, const std::string& backend,
+	int samples, int splats, bool sparse, bool fuse, const FieldFormats& formats, const std::vector<BenchResult>& results) {
+
+	std::ofstream file(path);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+
+	file << "{\n";
+	file << "  \"label\": " << jsonString(label) << ",\n";
+	file << "  \"renderer\": " << jsonString(renderer != NULL ? renderer : "") << ",\n";
+	file << "  \"version\": " << jsonString(version != NULL ? version : "") << ",\n";
+	file << "  \"backend\": " << jsonString(backend) << ",\n";
+	file << "  \"samples\": " << samples << ",\n";
+	file << "  \"splats\": " << splats << ",\n";
+	file << "  \"sparse\": " << (sparse ? "true" : "false") << ",\n";
+	file << "  \"fuse\": " << (fuse ? "true" : "false") << ",\n";
+	file << "  \"formats\": {\"velocity\": " << jsonString(PingPongField::formatName(formats.velocity))
+		<< ", \"pressure\": " << jsonString(PingPongField::formatName(formats.pressure))
+		<< ", \"picture\": " << jsonString(PingPongField::formatName(formats.picture)) << "},\n";
+	file << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		const BenchResult& result = results[i];
+		char numbers[320];
+		std::snprintf(numbers, sizeof(numbers),
+			"\"grid\": [%d, %d], \"dye\": [%d, %d], \"iterations\": %d, \"median_ms\": %.6f, "
+			"\"p99_ms\": %.6f, \"mean_ms\": %.6f, \"cells_per_second\": %.1f",
+			result.width, result.height, result.dyeWidth, result.dyeHeight, result.config.iterations,
+			result.medianMs, result.p99Ms, result.meanMs, result.cellsPerSecond);
+
+		file << "    {\"solver\": " << jsonString(result.config.solver) << ", \"pass\": " << jsonString(result.pass)
+			<< ", " << numbers << ", \"bytes_per_second\": ";
+		if (result.bytes >= 0.0 && result.medianMs > 0.0) {
+			file << std::llround(result.bytes / (result.medianMs / 1000.0));
+		}
+		else {
+			file << "null";
+		}
+		file << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	file << "  ]\n";
+	file << "}\n";
+	return (bool)file;
+}
+
+
+int main(int argc, char** argv) {
+	std::vector<int> sizes = { 128, 256, 512, 1024, 2048, 4096 };
+	std::vector<int> iterationCounts = { 20, 40, 80 };
+	std::vector<std::string> solvers = { "jacobi" };
+	int dyeResolution = 0;				// 0 matches the grid
+	int samples = 20;
+	int warmup = 3;
+	int splats = 1;
+	bool sparse = false;
+	bool compute = false;
+	bool fuse = true;
+	FieldFormats formats;
+	std::string context = "native";
+	std::string jsonPath = "fluid_bench.json";
+	std::string label;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+			sizes = parseList(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterationCounts = parseList(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--solvers") == 0 && i + 1 < argc) {
+			solvers = parseNames(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--dye") == 0 && i + 1 < argc) {
+			dyeResolution = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+			samples = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+			warmup = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--splats") == 0 && i + 1 < argc) {
+			splats = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--sparse") == 0) {
+			sparse = true;
+		}
+		else if (std::strcmp(argv[i], "--compute") == 0) {
+			compute = true;
+		}
+		else if (std::strcmp(argv[i], "--no-fuse") == 0) {
+			fuse = false;
+		}
+		else if (std::strcmp(argv[i], "--velocity-format") == 0 && i + 1 < argc) {
+			if (!formats.set("velocity", argv[++i])) {
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--pressure-format") == 0 && i + 1 < argc) {
+			if (!formats.set("pressure", argv[++i])) {
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--picture-format") == 0 && i + 1 < argc) {
+			if (!formats.set("picture", argv[++i])) {
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--context") == 0 && i + 1 < argc) {
+			context = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+			jsonPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+			label = argv[++i];
+		}
+		else {
+			std::cout << "Unknown argument " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	if (sizes.empty() || iterationCounts.empty() || solvers.empty() || samples <= 0 || warmup < 0 || splats < 0) {
+		std::cout << "Nothing to run" << std::endl;
+		return 1;
+	}
+	for (int size : sizes) {
+		if (size <= 0) {
+			std::cout << "Invalid grid size " << size << std::endl;
+			return 1;
+		}
+	}
+	for (const std::string& solver : solvers) {
+		if (solver != "jacobi" && solver != "sor" && solver != "multigrid" && solver != "direct") {
+			std::cout << "Unknown solver " << solver << std::endl;
+			return 1;
+		}
+	}
+
+	// Simulation's own window hints only add the version and profile, so
+	// these carry over into its window
+	glfwInit();
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	if (context == "egl") {
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+	}
+	else if (context == "osmesa") {
+#ifdef GLFW_OSMESA_CONTEXT_API
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#else
+		std::cout << "This GLFW has no OSMesa support, it needs 3.3 or newer" << std::endl;
+		return 1;
+#endif
+	}
+	else if (context != "native") {
+		std::cout << "Unknown context " << context << std::endl;
+		return 1;
+	}
+
+	Simulation sim(sizes[0], dyeResolution > 0 ? dyeResolution : sizes[0], "", formats);
+	sim.sparseTiles = sparse;
+	sim.fusePasses = fuse;
+	if (compute) {
+		if (!ComputeSolver::supported()) {
+			std::cout << "Compute shaders need OpenGL 4.3" << std::endl;
+			return 1;
+		}
+		sim.solverBackend = SolverBackend::COMPUTE;
+	}
+
+	// the same emitters every run, placed by a fixed lcg
+	unsigned int seed = 12345;
+	auto random = [&seed]() {
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / 16777216.0f;
+	};
+	for (int i = 0; i < splats; i++) {
+		Splat splat;
+		splat.x = 1.8f * random() - 0.9f;
+		splat.y = 1.8f * random() - 0.9f;
+		splat.valueX = 2.0f * random() - 1.0f;
+		splat.valueY = 2.0f * random() - 1.0f;
+		sim.forceSplats.push_back(splat);
+	}
+
+	GLint timestampBits = 0;
+	glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &timestampBits);
+	bool timestamps = timestampBits > 0;
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	std::cout << "FluidBench on " << (renderer != NULL ? renderer : "unknown renderer") << ", "
+		<< samples << " samples after " << warmup << " warmup runs, "
+		<< (timestamps ? "gpu timestamps" : "cpu time with glFinish") << std::endl;
+
+	std::vector<BenchResult> results;
+	for (const std::string& solver : solvers) {
+		sim.pressureSolver = solver == "sor" ? PressureSolver::RED_BLACK_SOR :
+			solver == "multigrid" ? PressureSolver::MULTIGRID :
+			solver == "direct" ? PressureSolver::DIRECT : PressureSolver::JACOBI;
+		sim.diffusionSolver = solver == "sor" ? DiffusionSolver::RED_BLACK_SOR : DiffusionSolver::JACOBI;
+
+		for (int size : sizes) {
+			while (glGetError() != GL_NO_ERROR) {}
+			sim.setResolution(size, dyeResolution > 0 ? dyeResolution : size);
+			if (glGetError() == GL_OUT_OF_MEMORY) {
+				std::cout << "Out of memory for a " << size << " grid, skipping it" << std::endl;
+				continue;
+			}
+
+			double cells = (double)sim.fieldWidth() * sim.fieldHeight();
+			double dyeCells = (double)sim.pictureWidth() * sim.pictureHeight();
+			double borderCells = 2.0 * (sim.fieldWidth() + sim.fieldHeight()) - 4.0;
+
+			// a quad is EXTENT radii to each side of the centre, in window coordinates
+			double splatCells = 0.0;
+			for (const Splat& splat : sim.forceSplats) {
+				double side = SplatBatch::EXTENT * splat.radius;
+				splatCells += std::min(side * side, 1.0) * cells;
+			}
+
+			for (int iterations : iterationCounts) {
+				sim.diffusionIterations = iterations;
+				sim.pressureIterations = iterations;
+				BenchConfig config = { solver, size, iterations };
+
+				double stepBytes = 0.0;
+				for (int p = 0; p < PASS_COUNT; p++) {
+					double bytes = passBytes(PASSES[p], solver, iterations, cells, dyeCells, splatCells, borderCells, formats, fuse);
+					stepBytes = bytes < 0.0 || stepBytes < 0.0 ? -1.0 : stepBytes + bytes;
+				}
+
+				results.push_back(summarize(config, "step", sim,
+					timeSamples([&] { sim.step(); }, warmup, samples, timestamps), cells, stepBytes));
+				printResult(results.back());
+
+				for (int p = 0; p < PASS_COUNT; p++) {
+					SimulationPass pass = PASSES[p];
+					// the cells the pass touches, like passBytes()
+					double passCells = pass == SimulationPass::NEW_IMAGE ? dyeCells :
+						pass == SimulationPass::BOUNDARY ? borderCells :
+						pass == SimulationPass::FORCE ? splatCells : cells;
+					results.push_back(summarize(config, PASS_NAMES[p], sim,
+						timeSamples([&] { sim.runPass(pass); }, warmup, samples, timestamps),
+						passCells, passBytes(pass, solver, iterations, cells, dyeCells, splatCells, borderCells, formats, fuse)));
+					printResult(results.back());
+				}
+			}
+		}
+	}
+
+	if (!writeJson(jsonPath, label, compute ? "compute" : "fragment", samples, splats, sparse, fuse, formats, results)) {
+		std::cout << "Unable to write " << jsonPath << std::endl;
+		return 1;
+	}
+	std::cout << "Wrote " << results.size() << " results to " << jsonPath << std::endl;
+	return 0;
+}
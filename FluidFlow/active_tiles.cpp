@@ -0,0 +1,198 @@
+#include "active_tiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+ActiveTiles::ActiveTiles() {}
+
+
+void ActiveTiles::loadShaders() {
+	activityShader = Shader("shaders/fluid/tile_activity.vert", "shaders/fluid/tile_activity.frag");
+}
+
+
+void ActiveTiles::create(unsigned int quadVAO) {
+	this->quadVAO = quadVAO;
+	glGenVertexArrays(1, &tileVAO);
+
+	activityShader.use();
+	activityShader.setInt("velocityTexture", 0);
+	activityShader.setInt("pictureTexture", 1);
+	activityShader.setInt("previousMask", 2);
+	activityShader.setInt("hold", HOLD);
+	activityThresholds = activityShader.uniform("thresholds");
+	activityEverything = activityShader.uniform("everything");
+	glUseProgram(0);
+
+	for (Readback& readback : readbacks) {
+		glGenBuffers(1, &readback.buffer);
+	}
+}
+
+
+void ActiveTiles::resize(int gridWidth, int gridHeight) {
+	this->gridWidth = gridWidth;
+	this->gridHeight = gridHeight;
+
+	dropReadbacks();
+	mask.destroy();
+	mask.create((gridWidth + TILE - 1) / TILE, (gridHeight + TILE - 1) / TILE);
+	activity.resize((size_t)mask.width * mask.height);
+
+	for (Readback& readback : readbacks) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, activity.size() * sizeof(float), NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	invalidate();
+}
+
+
+void ActiveTiles::invalidate() {
+	// the picture is written once a step, so it takes two for both of its sides
+	fullUpdates = 2;
+}
+
+
+void ActiveTiles::update(unsigned int velocityTexture, unsigned int pictureTexture, float dt) {
+	glBindFramebuffer(GL_FRAMEBUFFER, mask.writeFramebuffer());
+	glViewport(0, 0, mask.width, mask.height);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, pictureTexture);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, mask.readTexture());
+
+	// the shader compares speeds in cells per step
+	activityShader.use();
+	activityShader.setVec2(activityThresholds, velocityThreshold / dt, dyeThreshold);
+	activityShader.setBool(activityEverything, fullUpdates > 0);
+
+	glBindVertexArray(quadVAO);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+
+	collectReadbacks();
+	startReadback();
+
+	mask.swap();
+	fullUpdates = std::max(fullUpdates - 1, 0);
+}
+
+
+void ActiveTiles::startReadback() {
+	// the oldest is dropped when the gpu is that far behind
+	if (readbacksInFlight == READBACK_RING) {
+		Readback& oldest = readbacks[readbackHead];
+		glDeleteSync(oldest.fence);
+		oldest.fence = 0;
+		readbacksInFlight--;
+	}
+
+	Readback& readback = readbacks[readbackHead];
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, mask.writeFramebuffer());
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, mask.width, mask.height, GL_RED, GL_FLOAT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readbackHead = (readbackHead + 1) % READBACK_RING;
+	readbacksInFlight++;
+}
+
+
+void ActiveTiles::collectReadbacks() {
+	bool collected = false;
+	while (readbacksInFlight > 0) {
+		Readback& readback = readbacks[(readbackHead - readbacksInFlight + READBACK_RING) % READBACK_RING];
+
+		GLenum status = glClientWaitSync(readback.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			break;
+		}
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+		readbacksInFlight--;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, activity.size() * sizeof(float), GL_MAP_READ_BIT);
+		if (mapped != NULL) {
+			std::memcpy(activity.data(), mapped, activity.size() * sizeof(float));
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			collected = true;
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	if (!collected) {
+		return;
+	}
+
+	// same neighbourhood as active_tiles.vert
+	int drawn = 0;
+	for (int y = 0; y < mask.height; y++) {
+		for (int x = 0; x < mask.width; x++) {
+			bool moving = false;
+			for (int j = std::max(y - 1, 0); j <= std::min(y + 1, mask.height - 1) && !moving; j++) {
+				for (int i = std::max(x - 1, 0); i <= std::min(x + 1, mask.width - 1) && !moving; i++) {
+					moving = activity[(size_t)j * mask.width + i] > 0.0f;
+				}
+			}
+			drawn += moving ? 1 : 0;
+		}
+	}
+	drawnFraction = (float)drawn / activity.size();
+}
+
+
+void ActiveTiles::dropReadbacks() {
+	for (Readback& readback : readbacks) {
+		if (readback.fence != 0) {
+			glDeleteSync(readback.fence);
+			readback.fence = 0;
+		}
+	}
+	readbacksInFlight = 0;
+	drawnFraction = 1.0f;
+}
+
+
+void ActiveTiles::mark(float x0, float y0, float x1, float y1) {
+	int tileX0 = std::max((int)std::floor((0.5f * x0 + 0.5f) * gridWidth / TILE), 0);
+	int tileY0 = std::max((int)std::floor((0.5f * y0 + 0.5f) * gridHeight / TILE), 0);
+	int tileX1 = std::min((int)std::ceil((0.5f * x1 + 0.5f) * gridWidth / TILE), mask.width);
+	int tileY1 = std::min((int)std::ceil((0.5f * y1 + 0.5f) * gridHeight / TILE), mask.height);
+	if (tileX1 <= tileX0 || tileY1 <= tileY0) {
+		return;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, mask.readFramebuffer());
+	glEnable(GL_SCISSOR_TEST);
+	glScissor(tileX0, tileY0, tileX1 - tileX0, tileY1 - tileY0);
+	glClearColor((float)HOLD, (float)HOLD, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+}
+
+
+void ActiveTiles::configure(const Shader& tileShader, bool picture) {
+	tileShader.use();
+	tileShader.setInt("tileMask", MASK_UNIT);
+	tileShader.setBool("pictureTiles", picture);
+}
+
+
+void ActiveTiles::draw() {
+	glActiveTexture(GL_TEXTURE0 + MASK_UNIT);
+	glBindTexture(GL_TEXTURE_2D, mask.readTexture());
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(tileVAO);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, mask.width * mask.height);
+	glBindVertexArray(0);
+}
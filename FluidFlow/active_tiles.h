@@ -0,0 +1,105 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "field.h"
+#include "shader.h"
+
+// which TILE x TILE blocks of the grid are moving, so that passes can draw
+// those and leave the settled rest of the domain untouched. update() reduces
+// the velocity and the picture to one mask texel per tile, and a pass drawn
+// through draw() with a program built on active_tiles.vert gets one quad per
+// tile, collapsed when the tile and its 8 neighbours are all settled.
+//
+// skipped tiles keep whatever both sides of a field held, so a tile stays
+// active for HOLD updates after it settles, which gives both sides its
+// final value before the passes leave it alone.
+//
+// the mask is also read back a few steps late, and when most tiles are
+// drawn anyway tiled() turns false and the passes go back to one quad, which
+// is cheaper than the same area in tiles
+class ActiveTiles {
+public:
+	// grid texels along a tile side, same as TILE in the shaders
+	static const int TILE = 16;
+	// updates a tile stays active after it was last seen moving
+	static const int HOLD = 3;
+	// texture unit of the mask while drawing
+	static const int MASK_UNIT = 4;
+
+	// a tile moves when some velocity covers more than this many cells a step
+	float velocityThreshold = 0.001f;
+	// the picture of a tile is uneven when a colour spans more than this
+	float dyeThreshold = 0.002f;
+	// tiled() is false above this fraction of drawn tiles
+	float fullFraction = 0.6f;
+
+	ActiveTiles();
+
+	// starts building the programs, before create()
+	void loadShaders();
+
+	// sets up the programs, the mask comes with resize()
+	void create(unsigned int quadVAO);
+
+	// reallocates the mask for a new grid size, with every tile active
+	void resize(int gridWidth, int gridHeight);
+
+	// makes every tile active for the next HOLD updates, after fields were
+	// written outside the passes that keep both sides in step
+	void invalidate();
+
+	// rebuilds the mask from the read sides of the velocity and the picture.
+	// changes the viewport
+	void update(unsigned int velocityTexture, unsigned int pictureTexture, float dt);
+
+	// makes the tiles under a rectangle in window coordinates active for this step
+	void mark(float x0, float y0, float x1, float y1);
+
+	// sets the mask sampler of a program built on active_tiles.vert. picture
+	// programs also skip the tiles whose picture is even
+	static void configure(const Shader& tileShader, bool picture);
+
+	// draws the active tiles with the program in use, into a target with the
+	// grid's aspect
+	void draw();
+
+	// if drawing the tiles pays off, by the latest mask that was read back.
+	// false until one is
+	bool tiled() const { return drawnFraction < fullFraction; }
+	float drawnTiles() const { return drawnFraction; }
+
+	int tilesX() const { return mask.width; }
+	int tilesY() const { return mask.height; }
+
+private:
+	Shader activityShader;
+	Shader::Uniform activityThresholds;
+	Shader::Uniform activityEverything;
+
+	PingPongField mask;
+	int gridWidth = 0;
+	int gridHeight = 0;
+	int fullUpdates = 0;				// left of invalidate()
+
+	unsigned int quadVAO = 0;
+	unsigned int tileVAO = 0;			// no attributes, the tiles come from gl_InstanceID
+
+	// the velocity activity of recent masks on its way back, oldest first
+	static const int READBACK_RING = 3;
+	struct Readback {
+		unsigned int buffer = 0;
+		GLsync fence = 0;
+	};
+	Readback readbacks[READBACK_RING];
+	int readbackHead = 0;
+	int readbacksInFlight = 0;
+	std::vector<float> activity;
+	float drawnFraction = 1.0f;
+
+	void startReadback();
+	void collectReadbacks();			// the ones that are done, without waiting
+	void dropReadbacks();
+};
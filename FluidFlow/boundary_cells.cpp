@@ -0,0 +1,157 @@
+#include "boundary_cells.h"
+
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+
+
+BoundaryCells::BoundaryCells() {}
+
+
+void BoundaryCells::create() {
+	glGenVertexArrays(1, &cellVAO);
+	glGenBuffers(1, &cellBuffer);
+
+	glBindVertexArray(cellVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, cellBuffer);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Cell), (void*)offsetof(Cell, x));
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Cell), (void*)offsetof(Cell, neighbours));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	glBindVertexArray(0);
+}
+
+
+// skips whitespace and # comments between the fields of a pgm header
+static bool pgmField(std::istream& file, int& value) {
+	while (true) {
+		int next = file.peek();
+		if (next == '#') {
+			std::string comment;
+			std::getline(file, comment);
+		}
+		else if (next == ' ' || next == '\t' || next == '\r' || next == '\n') {
+			file.get();
+		}
+		else {
+			break;
+		}
+	}
+	return (bool)(file >> value);
+}
+
+
+bool BoundaryCells::loadObstacles(const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cout << "Unable to open obstacles " << path << std::endl;
+		return false;
+	}
+
+	char magic[2] = {};
+	file.read(magic, 2);
+	int width = 0;
+	int height = 0;
+	int maxValue = 0;
+	if (magic[0] != 'P' || magic[1] != '5' || !pgmField(file, width) || !pgmField(file, height) ||
+		!pgmField(file, maxValue) || width <= 0 || height <= 0 || maxValue <= 0 || maxValue > 255) {
+		std::cout << "Obstacles " << path << " are not an 8 bit binary pgm" << std::endl;
+		return false;
+	}
+	// one whitespace character ends the header
+	file.get();
+
+	std::vector<unsigned char> pixels((size_t)width * height);
+	if (!file.read((char*)pixels.data(), pixels.size())) {
+		std::cout << "Obstacles " << path << " end early" << std::endl;
+		return false;
+	}
+
+	for (unsigned char& pixel : pixels) {
+		pixel = 2 * pixel > maxValue ? 1 : 0;
+	}
+	image.swap(pixels);
+	imageWidth = width;
+	imageHeight = height;
+	return true;
+}
+
+
+void BoundaryCells::resize(int gridWidth, int gridHeight) {
+	std::vector<Cell> cells;
+	cells.reserve(2 * (size_t)(gridWidth + gridHeight));
+
+	// the corners go with the columns
+	for (int y = 0; y < gridHeight; y++) {
+		cells.push_back({ 0.0f, (float)y, { 0.0f, 1.0f, 0.0f, 0.0f } });
+		cells.push_back({ (float)(gridWidth - 1), (float)y, { 1.0f, 0.0f, 0.0f, 0.0f } });
+	}
+	for (int x = 1; x < gridWidth - 1; x++) {
+		cells.push_back({ (float)x, (float)(gridHeight - 1), { 0.0f, 0.0f, 1.0f, 0.0f } });
+		cells.push_back({ (float)x, 0.0f, { 0.0f, 0.0f, 0.0f, 1.0f } });
+	}
+	borderCells = (int)cells.size();
+
+	obstacleCells = 0;
+	if (hasObstacles()) {
+		// nearest texel of the image, whose top row comes first
+		std::vector<unsigned char> solid((size_t)gridWidth * gridHeight);
+		for (int y = 0; y < gridHeight; y++) {
+			int imageY = imageHeight - 1 - (int)((y + 0.5) * imageHeight / gridHeight);
+			for (int x = 0; x < gridWidth; x++) {
+				int imageX = (int)((x + 0.5) * imageWidth / gridWidth);
+				solid[(size_t)y * gridWidth + x] = image[(size_t)imageY * imageWidth + imageX];
+			}
+		}
+
+		// the border already holds the cells on it, and its cells are not fluid
+		auto fluid = [&](int x, int y) {
+			return x > 0 && y > 0 && x < gridWidth - 1 && y < gridHeight - 1 && solid[(size_t)y * gridWidth + x] == 0;
+		};
+		for (int y = 1; y < gridHeight - 1; y++) {
+			for (int x = 1; x < gridWidth - 1; x++) {
+				if (solid[(size_t)y * gridWidth + x] == 0) {
+					continue;
+				}
+				Cell cell = { (float)x, (float)y, {
+					fluid(x - 1, y) ? 1.0f : 0.0f, fluid(x + 1, y) ? 1.0f : 0.0f,
+					fluid(x, y - 1) ? 1.0f : 0.0f, fluid(x, y + 1) ? 1.0f : 0.0f } };
+				if (cell.neighbours[0] + cell.neighbours[1] + cell.neighbours[2] + cell.neighbours[3] > 0.0f) {
+					cells.push_back(cell);
+				}
+			}
+		}
+		obstacleCells = (int)cells.size() - borderCells;
+
+		for (unsigned char& texel : solid) {
+			texel *= 255;
+		}
+		if (maskTexture == 0) {
+			glGenTextures(1, &maskTexture);
+		}
+		glBindTexture(GL_TEXTURE_2D, maskTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, gridWidth, gridHeight, 0, GL_RED, GL_UNSIGNED_BYTE, solid.data());
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, cellBuffer);
+	glBufferData(GL_ARRAY_BUFFER, cells.size() * sizeof(Cell), cells.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+void BoundaryCells::draw(Cells cells) const {
+	int first = cells == Cells::OBSTACLES ? borderCells : 0;
+	int count = (cells != Cells::OBSTACLES ? borderCells : 0) + (cells != Cells::BORDER ? obstacleCells : 0);
+	if (count > 0) {
+		glDrawArrays(GL_POINTS, first, count);
+	}
+}
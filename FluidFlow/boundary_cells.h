@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// the cells the boundary conditions write, drawn as points so that they cost
+// as much as the boundaries are long instead of a pass over the whole grid.
+// the border of the domain comes first, the left and right columns with the
+// corners, then the top and bottom rows. after it come the obstacle cells.
+//
+// obstacles come from a mask image stretched over the grid. only the solid
+// cells next to a fluid cell inside the border are listed, so an obstacle
+// costs as much as its perimeter. every listed cell takes the average of its
+// fluid neighbours, which the programs on boundary_cells.vert get as weights
+class BoundaryCells {
+public:
+	// texture unit of the obstacle mask while the passes that respect it draw
+	static const int OBSTACLE_UNIT = 3;
+
+	enum class Cells {
+		BORDER,
+		OBSTACLES,
+		ALL
+	};
+
+	BoundaryCells();
+
+	// allocates the vertex buffer, the cells come with resize()
+	void create();
+
+	// reads the obstacles from a binary pgm, pixels brighter than half are
+	// solid. prints why and returns false when it can't. resize() stretches
+	// them over the grid
+	bool loadObstacles(const std::string& path);
+
+	// lists the cells of a grid of this size
+	void resize(int gridWidth, int gridHeight);
+
+	bool hasObstacles() const { return !image.empty(); }
+
+	// GL_R8, 1 in the solid cells. 0 without obstacles
+	unsigned int obstacleTexture() const { return maskTexture; }
+
+	// with no attributes of its own, the program on boundary_cells.vert reads
+	// the cells from it
+	unsigned int vertexArray() const { return cellVAO; }
+
+	// draws cells as points with the program and vertexArray() bound
+	void draw(Cells cells) const;
+
+	int borderCount() const { return borderCells; }
+	int obstacleCount() const { return obstacleCells; }
+
+private:
+	// one point, same layout as the attributes of boundary_cells.vert
+	struct Cell {
+		float x;
+		float y;
+		float neighbours[4];			// weights of the left, right, bottom and top neighbour
+	};
+
+	// the mask as loaded, top row first like in the file
+	std::vector<unsigned char> image;
+	int imageWidth = 0;
+	int imageHeight = 0;
+
+	unsigned int cellVAO = 0;
+	unsigned int cellBuffer = 0;
+	int borderCells = 0;
+	int obstacleCells = 0;
+	unsigned int maskTexture = 0;
+};
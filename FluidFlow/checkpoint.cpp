@@ -0,0 +1,330 @@
+#include "checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "lz_block.h"
+
+
+size_t checkpointTexelSize(GLenum format, GLenum type) {
+	size_t channels = 0;
+	switch (format) {
+	case GL_RED: channels = 1; break;
+	case GL_RG: channels = 2; break;
+	case GL_RGB: channels = 3; break;
+	case GL_RGBA: channels = 4; break;
+	}
+
+	switch (type) {
+	case GL_UNSIGNED_BYTE: return channels;
+	case GL_HALF_FLOAT: return channels * 2;
+	case GL_FLOAT: return channels * 4;
+	}
+	return 0;
+}
+
+
+// bytes of one channel, the element width the texels are shuffled by
+static size_t channelSize(GLenum type) {
+	return type == GL_HALF_FLOAT ? 2 : type == GL_FLOAT ? 4 : 1;
+}
+
+
+CheckpointWriter::CheckpointWriter() {}
+
+
+CheckpointWriter::~CheckpointWriter() {
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+
+bool CheckpointWriter::save(const std::string& path, const CheckpointHeader& header, const std::vector<Source>& fields) {
+	if (busy()) {
+		std::cout << "Still writing the previous checkpoint, not saving " << path << std::endl;
+		return false;
+	}
+	if (fields.size() > CHECKPOINT_MAX_BLOCKS) {
+		std::cout << "A checkpoint holds at most " << CHECKPOINT_MAX_BLOCKS << " fields" << std::endl;
+		return false;
+	}
+	if (worker.joinable()) {
+		worker.join();
+	}
+
+	this->path = path;
+	this->header = header;
+	started = std::chrono::steady_clock::now();
+
+	for (size_t i = pending.size(); i > fields.size(); i--) {
+		glDeleteBuffers(1, &pending.back().buffer);
+		pending.pop_back();
+	}
+	pending.resize(fields.size());
+
+	for (size_t i = 0; i < fields.size(); i++) {
+		const Source& source = fields[i];
+		Pending& target = pending[i];
+
+		size_t size = (size_t)source.source->width * source.source->height * checkpointTexelSize(source.format, source.type);
+
+		std::memset(&target.block, 0, sizeof(target.block));
+		target.block.field = (uint32_t)source.field;
+		target.block.width = source.source->width;
+		target.block.height = source.source->height;
+		target.block.format = source.format;
+		target.block.type = source.type;
+		target.block.rawSize = size;
+
+		if (target.buffer == 0) {
+			glGenBuffers(1, &target.buffer);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, target.buffer);
+		if (target.bufferSize != size) {
+			glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+			target.bufferSize = size;
+		}
+
+		// with a pack buffer bound the read only queues a copy on the gpu
+		glBindFramebuffer(GL_FRAMEBUFFER, source.source->readFramebuffer());
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, source.source->width, source.source->height, source.format, source.type, 0);
+	}
+
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	return true;
+}
+
+
+void CheckpointWriter::update() {
+	if (fence == 0) {
+		return;
+	}
+
+	// a zero timeout only asks, flushing makes sure the fence gets there
+	GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+		return;
+	}
+	glDeleteSync(fence);
+	fence = 0;
+
+	for (Pending& block : pending) {
+		block.texels.resize(block.bufferSize);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, block.buffer);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, block.bufferSize, GL_MAP_READ_BIT);
+		if (mapped != NULL) {
+			std::memcpy(block.texels.data(), mapped, block.bufferSize);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	writing = true;
+	worker = std::thread(&CheckpointWriter::write, this);
+}
+
+
+void CheckpointWriter::finish() {
+	while (fence != 0) {
+		glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+		update();
+	}
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
+
+
+void CheckpointWriter::write() {
+	std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.version = CHECKPOINT_VERSION;
+	header.blockCount = (uint32_t)pending.size();
+
+	// compressed blocks replace their texels, so offsets are known up front
+	uint64_t offset = CHECKPOINT_ALIGNMENT;
+	for (Pending& block : pending) {
+		block.block.compression = (uint32_t)CheckpointCompression::NONE;
+		block.block.storedSize = block.block.rawSize;
+
+		if (compress) {
+			size_t size = block.texels.size();
+			std::vector<unsigned char> shuffled(size);
+			LzBlock::shuffle(block.texels.data(), size, shuffled.data(), channelSize(block.block.type));
+
+			std::vector<unsigned char> compressed(LzBlock::bound(size));
+			size_t compressedSize = LzBlock::compress(shuffled.data(), size, compressed.data(), compressed.size());
+
+			// blocks that do not get smaller stay raw and load without a copy
+			if (compressedSize > 0 && compressedSize < size) {
+				compressed.resize(compressedSize);
+				block.texels.swap(compressed);
+				block.block.compression = (uint32_t)CheckpointCompression::LZ;
+				block.block.storedSize = compressedSize;
+			}
+		}
+
+		block.block.offset = offset;
+		offset += (block.block.storedSize + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+	}
+
+	std::memset(header.blocks, 0, sizeof(header.blocks));
+	for (size_t i = 0; i < pending.size(); i++) {
+		header.blocks[i] = pending[i].block;
+	}
+
+	// into a temporary file first, a crash while writing keeps the old one
+	std::string temporaryPath = path + ".tmp";
+	FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+	if (file == NULL) {
+		std::cout << "Unable to open " << temporaryPath << " for writing" << std::endl;
+		writing = false;
+		return;
+	}
+
+	std::vector<unsigned char> padding(CHECKPOINT_ALIGNMENT, 0);
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+		std::fwrite(padding.data(), 1, CHECKPOINT_ALIGNMENT - sizeof(header), file) == CHECKPOINT_ALIGNMENT - sizeof(header);
+
+	for (Pending& block : pending) {
+		size_t size = (size_t)block.block.storedSize;
+		size_t tail = (size_t)((CHECKPOINT_ALIGNMENT - size % CHECKPOINT_ALIGNMENT) % CHECKPOINT_ALIGNMENT);
+		written = written && std::fwrite(block.texels.data(), 1, size, file) == size;
+		written = written && std::fwrite(padding.data(), 1, tail, file) == tail;
+	}
+	written = std::fclose(file) == 0 && written;
+
+	if (!written) {
+		std::cout << "Failed to write checkpoint " << temporaryPath << std::endl;
+		std::remove(temporaryPath.c_str());
+		writing = false;
+		return;
+	}
+
+	// rename does not replace an existing file on windows
+	std::remove(path.c_str());
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::cout << "Unable to move " << temporaryPath << " to " << path << std::endl;
+		writing = false;
+		return;
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+	std::cout << "Saved step " << header.step << " to " << path << ", " << offset / (1024.0 * 1024.0)
+		<< " MB in " << milliseconds << " ms" << std::endl;
+	writing = false;
+}
+
+
+bool CheckpointReader::open(const std::string& path) {
+	if (!file.open(path)) {
+		std::cout << "Unable to open checkpoint " << path << std::endl;
+		return false;
+	}
+
+	const CheckpointHeader& header = this->header();
+	if (file.size() < CHECKPOINT_ALIGNMENT ||
+		std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0) {
+		std::cout << path << " is not a checkpoint" << std::endl;
+		close();
+		return false;
+	}
+	if (header.version != CHECKPOINT_VERSION) {
+		std::cout << path << " is checkpoint version " << header.version << ", expected "
+			<< CHECKPOINT_VERSION << std::endl;
+		close();
+		return false;
+	}
+	if (header.blockCount > CHECKPOINT_MAX_BLOCKS) {
+		std::cout << path << " has " << header.blockCount << " blocks, at most "
+			<< CHECKPOINT_MAX_BLOCKS << " are allowed" << std::endl;
+		close();
+		return false;
+	}
+
+	for (uint32_t i = 0; i < header.blockCount; i++) {
+		const CheckpointBlock& block = header.blocks[i];
+		size_t texelSize = checkpointTexelSize(block.format, block.type);
+
+		bool valid = texelSize > 0 && block.width > 0 && block.height > 0 &&
+			block.rawSize == (uint64_t)block.width * block.height * texelSize &&
+			block.offset % CHECKPOINT_ALIGNMENT == 0 &&
+			block.offset <= file.size() && block.storedSize <= file.size() - block.offset &&
+			(block.compression == (uint32_t)CheckpointCompression::NONE ? block.storedSize == block.rawSize :
+				block.compression == (uint32_t)CheckpointCompression::LZ);
+		if (!valid) {
+			std::cout << "Block " << i << " of checkpoint " << path << " is damaged" << std::endl;
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void CheckpointReader::close() {
+	file.close();
+	scratch.clear();
+	scratch.shrink_to_fit();
+}
+
+
+const CheckpointBlock* CheckpointReader::block(CheckpointField field) const {
+	const CheckpointHeader& header = this->header();
+	for (uint32_t i = 0; i < header.blockCount; i++) {
+		if (header.blocks[i].field == (uint32_t)field) {
+			return &header.blocks[i];
+		}
+	}
+	return NULL;
+}
+
+
+bool CheckpointReader::upload(const CheckpointBlock& block, unsigned int texture) {
+	const unsigned char* stored = file.data() + block.offset;
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	bool uploaded = true;
+	if (block.compression == (uint32_t)CheckpointCompression::NONE) {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, block.width, block.height, block.format, block.type, stored);
+	}
+	else {
+		// decompressed next to the mapping, then unshuffled straight into
+		// driver memory
+		size_t size = (size_t)block.rawSize;
+		scratch.resize(size);
+		uploaded = LzBlock::decompress(stored, (size_t)block.storedSize, scratch.data(), size);
+
+		unsigned int buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+		void* mapped = uploaded ? glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT) : NULL;
+		if (mapped != NULL) {
+			LzBlock::unshuffle(scratch.data(), size, (unsigned char*)mapped, channelSize(block.type));
+			uploaded = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+		}
+		else {
+			uploaded = false;
+		}
+
+		if (uploaded) {
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, block.width, block.height, block.format, block.type, 0);
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &buffer);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return uploaded;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "field.h"
+#include "mapped_file.h"
+
+// snapshot of the simulation state in one file. a fixed size header holds
+// the step counter, the parameters and a table of blocks, one per field.
+// blocks start at multiples of CHECKPOINT_ALIGNMENT so an uncompressed block
+// can be handed from a memory mapping to glTexSubImage2D as it is. all
+// numbers are little endian
+const char CHECKPOINT_MAGIC[8] = { 'F', 'L', 'U', 'I', 'D', 'C', 'K', 'P' };
+const uint32_t CHECKPOINT_VERSION = 1;
+const uint32_t CHECKPOINT_ALIGNMENT = 4096;
+const uint32_t CHECKPOINT_MAX_BLOCKS = 8;
+
+enum class CheckpointField : uint32_t {
+	VELOCITY = 1,
+	PRESSURE = 2,
+	PICTURE = 3
+};
+
+enum class CheckpointCompression : uint32_t {
+	NONE = 0,
+	LZ = 1					// LzBlock of the texels byte shuffled by channel size
+};
+
+struct CheckpointBlock {
+	uint32_t field;				// CheckpointField
+	uint32_t compression;		// CheckpointCompression
+	int32_t width;
+	int32_t height;
+	uint32_t format;			// gl pixel format and type of the texels
+	uint32_t type;
+	uint64_t offset;			// from the start of the file
+	uint64_t storedSize;		// bytes in the file
+	uint64_t rawSize;			// bytes of texels
+};
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t blockCount;
+	uint64_t step;				// steps simulated so far
+
+	float millisecondsPerFrame;
+	float viscosity;
+	int32_t diffusionIterations;
+	int32_t pressureIterations;
+	int32_t gridResolution;
+	int32_t dyeResolution;
+	int32_t gridWidth;
+	int32_t gridHeight;
+	int32_t dyeWidth;
+	int32_t dyeHeight;
+
+	CheckpointBlock blocks[CHECKPOINT_MAX_BLOCKS];
+};
+
+static_assert(sizeof(CheckpointBlock) == 48, "checkpoint block layout changed");
+static_assert(sizeof(CheckpointHeader) <= CHECKPOINT_ALIGNMENT, "checkpoint header does not fit its page");
+
+
+// writes checkpoints without stalling the frame loop. save() queues reads of
+// the fields into pixel pack buffers and returns, update() picks the texels
+// up once a fence says the copies are done, and a worker thread compresses
+// and writes the file
+class CheckpointWriter {
+public:
+	// compress the blocks with LzBlock. smaller files, but a load has to
+	// decompress instead of uploading straight from the mapping
+	bool compress = false;
+
+	CheckpointWriter();
+	~CheckpointWriter();
+
+	CheckpointWriter(const CheckpointWriter&) = delete;
+	CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+	// one field to save, the read side of source stored as format/type
+	struct Source {
+		CheckpointField field;
+		const PingPongField* source;
+		GLenum format;
+		GLenum type;
+	};
+
+	// starts reading back the fields and writes them with header to path.
+	// false while the previous save is still running
+	bool save(const std::string& path, const CheckpointHeader& header, const std::vector<Source>& fields);
+
+	// call once a frame, hands finished readbacks to the worker thread
+	void update();
+
+	// blocks until the save in flight is on disk, before the context goes away
+	void finish();
+
+	bool busy() const { return fence != 0 || writing; }
+
+private:
+	struct Pending {
+		CheckpointBlock block;
+		unsigned int buffer = 0;			// pixel pack buffer, kept between saves
+		size_t bufferSize = 0;
+		std::vector<unsigned char> texels;
+	};
+
+	std::vector<Pending> pending;
+
+	std::string path;
+	CheckpointHeader header;
+	GLsync fence = 0;
+	std::chrono::steady_clock::time_point started;
+
+	std::thread worker;
+	std::atomic<bool> writing{ false };
+
+	void write();						// runs on the worker thread
+};
+
+
+// reads checkpoints through a memory mapping of the file
+class CheckpointReader {
+public:
+	// maps path and checks the header and the block table
+	bool open(const std::string& path);
+	void close();
+
+	const CheckpointHeader& header() const { return *reinterpret_cast<const CheckpointHeader*>(file.data()); }
+
+	// the block of field, or NULL if the checkpoint has none
+	const CheckpointBlock* block(CheckpointField field) const;
+
+	// uploads block into texture, which has to be at least as large. raw
+	// blocks go straight from the mapping, compressed ones are decompressed
+	// into a pixel unpack buffer first
+	bool upload(const CheckpointBlock& block, unsigned int texture);
+
+private:
+	MappedFile file;
+	std::vector<unsigned char> scratch;
+};
+
+
+// bytes per texel of a pixel format and type, 0 for unsupported ones
+size_t checkpointTexelSize(GLenum format, GLenum type);
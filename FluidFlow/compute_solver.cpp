@@ -0,0 +1,98 @@
+#include "compute_solver.h"
+
+#include <algorithm>
+#include <string>
+
+
+ComputeSolver::ComputeSolver() {}
+
+
+bool ComputeSolver::supported() {
+	return GLAD_GL_VERSION_4_3 || (GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_image_load_store);
+}
+
+
+void ComputeSolver::loadShaders(GLenum velocityFormat, GLenum pressureFormat) {
+	this->velocityFormat = velocityFormat;
+
+	std::string velocityName = PingPongField::formatName(velocityFormat);
+	std::string pressureName = PingPongField::formatName(pressureFormat);
+
+	jacobiShaders[0] = Shader("shaders/fluid/tiled_jacobi.comp",
+		"#define FIELD_FORMAT " + velocityName + "\n#define RHS_FORMAT " + velocityName + "\n");
+	jacobiShaders[1] = Shader("shaders/fluid/tiled_jacobi.comp",
+		"#define FIELD_FORMAT " + pressureName + "\n#define RHS_FORMAT r32f\n");
+	divergenceShader = Shader("shaders/fluid/divergence.comp",
+		"#define VELOCITY_FORMAT " + velocityName + "\n#define DIVERGENCE_FORMAT r32f\n");
+}
+
+
+void ComputeSolver::create() {
+	for (int i = 0; i < 2; i++) {
+		jacobiPressure[i] = jacobiShaders[i].uniform("pressure");
+		jacobiSteps[i] = jacobiShaders[i].uniform("steps");
+	}
+}
+
+
+void ComputeSolver::diffuse(PingPongField& velocity, unsigned int rhsTexture, int iterations) {
+	// the right hand side is also the initial guess
+	glBindImageTexture(0, rhsTexture, 0, GL_FALSE, 0, GL_READ_ONLY, velocityFormat);
+	glBindImageTexture(1, rhsTexture, 0, GL_FALSE, 0, GL_READ_ONLY, velocityFormat);
+	glBindImageTexture(2, velocity.writeTexture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, velocity.format);
+
+	int steps = std::min(std::max(stepsPerDispatch, 1), HALO);
+	steps = std::min(steps, iterations);
+
+	jacobiShaders[0].use();
+	jacobiShaders[0].setBool(jacobiPressure[0], false);
+	jacobiShaders[0].setInt(jacobiSteps[0], steps);
+	dispatch(velocity.width, velocity.height);
+	velocity.swap();
+
+	iterate(velocity, rhsTexture, iterations - steps, false);
+}
+
+
+void ComputeSolver::divergence(unsigned int velocityTexture, unsigned int divergenceTexture, int width, int height) {
+	glBindImageTexture(0, velocityTexture, 0, GL_FALSE, 0, GL_READ_ONLY, velocityFormat);
+	glBindImageTexture(2, divergenceTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+	divergenceShader.use();
+	dispatch(width, height);
+}
+
+
+void ComputeSolver::solvePressure(PingPongField& pressure, unsigned int divergenceTexture, int iterations) {
+	iterate(pressure, divergenceTexture, iterations, true);
+}
+
+
+void ComputeSolver::iterate(PingPongField& field, unsigned int rhsTexture, int iterations, bool pressure) {
+	const Shader& jacobiShader = jacobiShaders[pressure ? 1 : 0];
+	jacobiShader.use();
+	jacobiShader.setBool(jacobiPressure[pressure ? 1 : 0], pressure);
+
+	glBindImageTexture(1, rhsTexture, 0, GL_FALSE, 0, GL_READ_ONLY, pressure ? GL_R32F : velocityFormat);
+
+	while (iterations > 0) {
+		int steps = std::min(std::min(std::max(stepsPerDispatch, 1), HALO), iterations);
+		jacobiShader.setInt(jacobiSteps[pressure ? 1 : 0], steps);
+
+		glBindImageTexture(0, field.readTexture(), 0, GL_FALSE, 0, GL_READ_ONLY, field.format);
+		glBindImageTexture(2, field.writeTexture(), 0, GL_FALSE, 0, GL_WRITE_ONLY, field.format);
+		dispatch(field.width, field.height);
+		field.swap();
+
+		iterations -= steps;
+	}
+}
+
+
+void ComputeSolver::dispatch(int width, int height) {
+	glDispatchCompute((width + TILE - 1) / TILE, (height + TILE - 1) / TILE, 1);
+
+	// the next dispatch loads what this one stored, and the passes after the
+	// solve sample it as a texture
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "field.h"
+#include "shader.h"
+
+// GL 4.3 compute version of the diffusion and pressure jacobi solves. every
+// dispatch runs up to HALO iterations out of shared memory (see
+// tiled_jacobi.comp), so a 40 iteration solve is 10 dispatches instead of 40
+// draws, and each cell is read from and written to the texture once per
+// dispatch instead of once per iteration
+class ComputeSolver {
+public:
+	// halo of tiled_jacobi.comp, the most iterations one dispatch can do
+	static const int HALO = 4;
+	static const int TILE = 16;
+
+	// iterations per dispatch, 1 to HALO
+	int stepsPerDispatch = HALO;
+
+	ComputeSolver();
+
+	// true if the context can run compute shaders with image load/store
+	static bool supported();
+
+	// starts building the programs for fields of these internal formats,
+	// before create(). the diffusion's right hand side has the velocity's
+	// format, the divergence is GL_R32F
+	void loadShaders(GLenum velocityFormat, GLenum pressureFormat);
+
+	// sets up the programs
+	void create();
+
+	// iterations jacobi sweeps of diffusion.frag. the right hand side is the
+	// velocity before the solve, held in rhsTexture, and the result is left
+	// in velocity's read side
+	void diffuse(PingPongField& velocity, unsigned int rhsTexture, int iterations);
+
+	// the divergence of velocityTexture into divergenceTexture, both
+	// width x height
+	void divergence(unsigned int velocityTexture, unsigned int divergenceTexture, int width, int height);
+
+	// iterations jacobi sweeps of pressure.frag against the divergence in
+	// divergenceTexture
+	void solvePressure(PingPongField& pressure, unsigned int divergenceTexture, int iterations);
+
+private:
+	// image formats are fixed in the programs, so each field has its own
+	GLenum velocityFormat = GL_RGBA16F;
+
+	Shader jacobiShaders[2];			// diffusion, pressure
+	Shader divergenceShader;
+
+	Shader::Uniform jacobiPressure[2];
+	Shader::Uniform jacobiSteps[2];
+
+	// runs iterations over field, sampling the right hand side from rhsTexture
+	void iterate(PingPongField& field, unsigned int rhsTexture, int iterations, bool pressure);
+	void dispatch(int width, int height);
+};
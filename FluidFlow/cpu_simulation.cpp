@@ -0,0 +1,309 @@
+#include "cpu_simulation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+
+size_t CpuSimulation::planeStride(int width, int height) {
+	size_t floatsPerLine = AlignedAllocator<float>::ALIGNMENT / sizeof(float);
+	return ((size_t)width * height + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+}
+
+
+CpuSimulation::CpuSimulation(int width, int height, unsigned int threadCount)
+	: width(width), height(height), rowBegin(0), rowEnd(height), pool(threadCount),
+	kernels(&FluidKernels::best()) {
+
+	storage.resize(PLANES * planeStride(width, height));
+	setPlanes(storage.data());
+}
+
+
+CpuSimulation::CpuSimulation(int width, int height, float* planes, int rowBegin, int rowEnd,
+	const std::function<void()>& sync, unsigned int threadCount)
+	: width(width), height(height), rowBegin(rowBegin), rowEnd(rowEnd), sync(sync), pool(threadCount),
+	kernels(&FluidKernels::best()) {
+
+	setPlanes(planes);
+}
+
+
+void CpuSimulation::setPlanes(float* planes) {
+	size_t stride = planeStride(width, height);
+	float** named[] = { &velocityX, &velocityY, &pressure, &pictureR, &pictureG, &pictureB,
+		&scratchX, &scratchY, &scratchZ, &iterateX, &iterateY, &divergence };
+
+	// the first write to a page decides which memory node it lives on, so
+	// each worker clears its own rows
+	for (int i = 0; i < PLANES; i++) {
+		*named[i] = planes + i * stride;
+		std::fill(*named[i] + index(0, rowBegin), *named[i] + index(0, rowEnd), 0.0f);
+	}
+
+	drawInitialPicture();
+	drawInitialVelField();
+	synchronize();
+}
+
+
+void CpuSimulation::step() {
+	advection();
+	diffusion();
+	forceApplication();
+	pressureSolve();
+	projectToDivergenceFree();
+	boundaryConditions();
+
+	newImage();
+}
+
+
+void CpuSimulation::useKernels(KernelIsa isa) {
+	kernels = &FluidKernels::get(isa);
+}
+
+
+void CpuSimulation::setForce(float xPos, float yPos, float magnitudeX, float magnitudeY) {
+	forceXPos = xPos;
+	forceYPos = yPos;
+	forceMagnitudeX = magnitudeX;
+	forceMagnitudeY = magnitudeY;
+}
+
+
+void CpuSimulation::advection() {
+	// advection.frag moves texCoords by v / (fps * width), which is v / fps texels
+	float scale = 1.0f / millisecondsPerFrame;
+	const float* sources[] = { velocityX, velocityY };
+	float* targets[] = { scratchX, scratchY };
+
+	forEachTile([&](int x0, int y0, int x1, int y1) {
+		kernels->advect(velocityX, velocityY, scale, sources, targets, 2,
+			width, height, x0, y0, x1, y1);
+	});
+	synchronize();
+
+	std::swap(velocityX, scratchX);
+	std::swap(velocityY, scratchY);
+}
+
+
+void CpuSimulation::diffusion() {
+	// jacobi iterations of the implicit viscous step in diffusion.frag, with
+	// the velocity from before the solve kept as the right hand side
+	float coeff = 1.0f / (viscosity * (1.0f / millisecondsPerFrame));
+	float inverseDiagonal = 1.0f / (4.0f + coeff);
+
+	float** sourceX = &velocityX;
+	float** sourceY = &velocityY;
+	float** targetX = &iterateX;
+	float** targetY = &iterateY;
+
+	for (int iteration = 0; iteration < diffusionIterations; iteration++) {
+		const float* inX = *sourceX;
+		const float* inY = *sourceY;
+		float* outX = *targetX;
+		float* outY = *targetY;
+
+		forEachTile([&](int x0, int y0, int x1, int y1) {
+			kernels->jacobi(inX, velocityX, outX, coeff, inverseDiagonal,
+				width, height, x0, y0, x1, y1);
+			kernels->jacobi(inY, velocityY, outY, coeff, inverseDiagonal,
+				width, height, x0, y0, x1, y1);
+		});
+		synchronize();
+
+		// the first iteration reads the right hand side, afterwards alternate
+		// between the two iterate planes
+		sourceX = targetX;
+		sourceY = targetY;
+		targetX = (targetX == &iterateX) ? &scratchX : &iterateX;
+		targetY = (targetY == &iterateY) ? &scratchY : &iterateY;
+	}
+
+	if (diffusionIterations > 0) {
+		std::swap(velocityX, *sourceX);
+		std::swap(velocityY, *sourceY);
+	}
+}
+
+
+void CpuSimulation::forceApplication() {
+	if (forceMagnitudeX == 0.0f && forceMagnitudeY == 0.0f) {
+		return;
+	}
+
+	forEachTile([&](int x0, int y0, int x1, int y1) {
+		for (int y = y0; y < y1; y++) {
+			// window coordinates of the texel centre, where the gpu fields sample too
+			float distY = 2.0f * (y + 0.5f) / height - 1.0f - forceYPos;
+			for (int x = x0; x < x1; x++) {
+				float distX = 2.0f * (x + 0.5f) / width - 1.0f - forceXPos;
+				float coeff = std::exp(-1.0f * (distX * distX + distY * distY) / 0.001f);
+
+				int i = index(x, y);
+				velocityX[i] += coeff * forceMagnitudeX;
+				velocityY[i] += coeff * forceMagnitudeY;
+			}
+		}
+	});
+	synchronize();
+}
+
+
+void CpuSimulation::pressureSolve() {
+	// velocity does not change during the solve so the divergence is only
+	// computed once instead of every iteration like pressure.frag does. the
+	// iterations only read it at their own cell, so no worker waits for it
+	forEachTile([&](int x0, int y0, int x1, int y1) {
+		kernels->divergence(velocityX, velocityY, divergence,
+			width, height, x0, y0, x1, y1);
+	});
+
+	// jacobi iterations, warm started from the previous step's pressure
+	for (int iteration = 0; iteration < pressureIterations; iteration++) {
+		forEachTile([&](int x0, int y0, int x1, int y1) {
+			kernels->jacobi(pressure, divergence, scratchZ, -1.0f, 0.25f,
+				width, height, x0, y0, x1, y1);
+		});
+		synchronize();
+
+		std::swap(pressure, scratchZ);
+	}
+}
+
+
+void CpuSimulation::projectToDivergenceFree() {
+	// only reads pressure and writes each velocity cell once, so runs in place
+	forEachTile([&](int x0, int y0, int x1, int y1) {
+		kernels->project(pressure, velocityX, velocityY,
+			width, height, x0, y0, x1, y1);
+	});
+	synchronize();
+}
+
+
+void CpuSimulation::boundaryConditions() {
+	// boundary.frag mirrors the one cell wide border of the domain: velocity
+	// is reflected and pressure copied from the neighbouring interior cell.
+	// only touches the perimeter so it runs on the calling thread, of the
+	// first worker in a split run
+	if (rowBegin == 0) {
+		kernels->boundary(velocityX, -1.0f, width, height);
+		kernels->boundary(velocityY, -1.0f, width, height);
+		kernels->boundary(pressure, 1.0f, width, height);
+	}
+	synchronize();
+}
+
+
+void CpuSimulation::newImage() {
+	float scale = 1.0f / millisecondsPerFrame;
+	const float* sources[] = { pictureR, pictureG, pictureB };
+	float* targets[] = { scratchX, scratchY, scratchZ };
+
+	forEachTile([&](int x0, int y0, int x1, int y1) {
+		kernels->advect(velocityX, velocityY, scale, sources, targets, 3,
+			width, height, x0, y0, x1, y1);
+	});
+	// the next step's advection writes into the old picture
+	synchronize();
+
+	std::swap(pictureR, scratchX);
+	std::swap(pictureG, scratchY);
+	std::swap(pictureB, scratchZ);
+}
+
+
+void CpuSimulation::drawInitialVelField() {
+	// same field as initial_vfield.frag, evaluated at the texel centres
+	float mult = 2.0f;
+	float mag = 0.45f;
+
+	for (int y = rowBegin; y < rowEnd; y++) {
+		float locY = 2.0f * (y + 0.5f) / height - 1.0f;
+		for (int x = 0; x < width; x++) {
+			float locX = 2.0f * (x + 0.5f) / width - 1.0f;
+			int i = index(x, y);
+
+			if (std::abs(locX * width / 1000.0f) > 1.0f) {
+				velocityX[i] = 0.0f;
+				velocityY[i] = 0.0f;
+			}
+			else {
+				velocityX[i] = mag * 1000.0f * std::sin(mult * 3.1415f * locY * height / 1000.0f);
+				velocityY[i] = mag * 1000.0f * std::sin(mult * 3.1415f * locX * width / 1000.0f);
+			}
+		}
+	}
+}
+
+
+void CpuSimulation::drawInitialPicture() {
+	// white triangle on black, same vertices as Simulation::sceneData()
+	float offsetX = 0.5f * 1000.0f / width;
+	float offsetY = 0.5f * 1000.0f / height;
+
+	for (int y = rowBegin; y < rowEnd; y++) {
+		float locY = 2.0f * (y + 0.5f) / height - 1.0f;
+		for (int x = 0; x < width; x++) {
+			float locX = 2.0f * (x + 0.5f) / width - 1.0f;
+
+			// inside when above the base and below both slanted edges
+			float t = (locY + offsetY) / (2.0f * offsetY);
+			bool inside = t >= 0.0f && t <= 1.0f && std::abs(locX) <= offsetX * (1.0f - t);
+
+			int i = index(x, y);
+			float value = inside ? 1.0f : 0.0f;
+			pictureR[i] = value;
+			pictureG[i] = value;
+			pictureB[i] = value;
+		}
+	}
+}
+
+
+bool CpuSimulation::writePicture(const std::string& path) const {
+	return writePicture(path, width, height, pictureR, pictureG, pictureB);
+}
+
+
+bool CpuSimulation::writePicture(const std::string& path, int width, int height,
+	const float* red, const float* green, const float* blue) {
+
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		std::cout << "Unable to open " << path << " for writing" << std::endl;
+		return false;
+	}
+
+	std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+	std::vector<unsigned char> row((size_t)width * 3);
+	for (int y = height - 1; y >= 0; y--) {
+		for (int x = 0; x < width; x++) {
+			size_t i = (size_t)y * width + x;
+			row[3 * x] = (unsigned char)(255.0f * std::min(std::max(red[i], 0.0f), 1.0f));
+			row[3 * x + 1] = (unsigned char)(255.0f * std::min(std::max(green[i], 0.0f), 1.0f));
+			row[3 * x + 2] = (unsigned char)(255.0f * std::min(std::max(blue[i], 0.0f), 1.0f));
+		}
+		std::fwrite(row.data(), 1, row.size(), file);
+	}
+
+	std::fclose(file);
+	return true;
+}
+
+
+void CpuSimulation::forEachTile(const std::function<void(int, int, int, int)>& pass) {
+	int tilesX = (width + tileSize - 1) / tileSize;
+	int tilesY = (rowEnd - rowBegin + tileSize - 1) / tileSize;
+
+	pool.parallelFor(tilesX * tilesY, [&](int tile) {
+		int x0 = (tile % tilesX) * tileSize;
+		int y0 = rowBegin + (tile / tilesX) * tileSize;
+		pass(x0, y0, std::min(x0 + tileSize, width), std::min(y0 + tileSize, rowEnd));
+	});
+}
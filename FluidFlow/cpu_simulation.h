@@ -0,0 +1,132 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "fluid_kernels.h"
+#include "thread_pool.h"
+
+// headless cpu version of Simulation. runs the same passes as the shaders in
+// shaders/fluid on structure of arrays float planes, split into tiles that
+// are handed to a work stealing thread pool. the passes are the FluidKernels
+// for the widest instruction set the cpu supports.
+//
+// a worker of a split run, see split_run.h, works on planes shared with the
+// other workers and only computes the rows of its strip. every pass that
+// reads what another strip wrote waits for the others in sync() first
+class CpuSimulation {
+public:
+	// same meaning as Simulation::millisecondsPerFrame
+	float millisecondsPerFrame = 1000.0f / 3.0f;
+	float viscosity = 1.0f / 1000000.0f;
+
+	int diffusionIterations = 40;
+	int pressureIterations = 40;
+
+	// side length of the square tiles the grid is split into. 64x64 floats is
+	// 16KB per plane, so the planes touched by one pass fit in L2
+	int tileSize = 64;
+
+	// the fields and the scratch planes, one after the other
+	static const int PLANES = 12;
+
+	// floats from the start of one plane to the next, a whole number of cache lines
+	static size_t planeStride(int width, int height);
+
+	// threadCount of 0 uses every hardware thread
+	CpuSimulation(int width, int height, unsigned int threadCount = 0);
+
+	// a worker of a split run. planes holds PLANES planes planeStride() apart,
+	// shared with the other workers, and this one computes rows
+	// [rowBegin, rowEnd) of them. sync returns once every worker called it
+	CpuSimulation(int width, int height, float* planes, int rowBegin, int rowEnd,
+		const std::function<void()>& sync, unsigned int threadCount = 0);
+
+	// one step of the same pass sequence as Simulation::run()
+	void step();
+
+	// switches to the kernels for isa, or the widest supported one below it
+	void useKernels(KernelIsa isa);
+	const char* kernelName() const { return kernels->name; }
+
+	// external force for the next step, same parameters as the mouse splat of Simulation
+	void setForce(float xPos, float yPos, float magnitudeX, float magnitudeY);
+
+	// writes the picture as a binary ppm
+	bool writePicture(const std::string& path) const;
+	static bool writePicture(const std::string& path, int width, int height,
+		const float* red, const float* green, const float* blue);
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	unsigned int threadCount() const { return pool.size(); }
+
+	const float* getVelocityX() const { return velocityX; }
+	const float* getVelocityY() const { return velocityY; }
+	const float* getPressure() const { return pressure; }
+	const float* getPicture(int channel) const { return channel == 0 ? pictureR : channel == 1 ? pictureG : pictureB; }
+
+private:
+	int width;
+	int height;
+
+	// the rows this computes, all of them unless it is a worker of a split run
+	int rowBegin;
+	int rowEnd;
+	std::function<void()> sync;
+
+	ThreadPool pool;
+	const FluidKernels* kernels;
+
+	// the planes of a run on its own, empty for a worker
+	AlignedPlane storage;
+
+	// structure of arrays fields, row 0 is the bottom row like in the textures
+	float* velocityX;
+	float* velocityY;
+	float* pressure;
+	float* pictureR;
+	float* pictureG;
+	float* pictureB;
+
+	// scratch planes the passes write into before swapping with the fields
+	float* scratchX;
+	float* scratchY;
+	float* scratchZ;
+	float* iterateX;		// second jacobi iterate for the diffusion solve
+	float* iterateY;
+	float* divergence;
+
+	// points the planes at planes, clears the rows of this one's strip and
+	// draws the initial fields there
+	void setPlanes(float* planes);
+
+	// current external force
+	float forceXPos = 0.0f;
+	float forceYPos = 0.0f;
+	float forceMagnitudeX = 0.0f;
+	float forceMagnitudeY = 0.0f;
+
+	void drawInitialPicture();			// initial picture
+	void drawInitialVelField();			// initial velocity field
+
+	// terms of Navier Stokes eqn
+	void advection();
+	void diffusion();
+	void forceApplication();
+	void pressureSolve();
+	void projectToDivergenceFree();
+	void boundaryConditions();
+
+	// compute new image using current image and vel field
+	void newImage();
+
+	// waits for the other workers of a split run, nothing on its own
+	void synchronize() { if (sync) sync(); }
+
+	// runs pass(x0, y0, x1, y1) over every tile of the strip in parallel
+	void forEachTile(const std::function<void(int, int, int, int)>& pass);
+
+	int index(int x, int y) const { return y * width + x; }
+};
@@ -0,0 +1,207 @@
+#include "dct_solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+DctSolver::DctSolver(unsigned int threadCount) : threadCount(threadCount) {}
+
+
+void DctSolver::solve(int width, int height, const float* divergence, float* pressure) {
+	if (!pool) {
+		pool = std::make_unique<ThreadPool>(threadCount);
+	}
+	if (rows.n != width) {
+		createPlan(rows, width);
+	}
+	if (columns.n != height) {
+		createPlan(columns, height);
+	}
+
+	std::copy(divergence, divergence + (size_t)width * height, pressure);
+
+	transformRows(pressure, width, height, false);
+	transformColumns(pressure, width, height, false);
+
+	pool->parallelFor(height, [&](int y) {
+		float* row = pressure + (size_t)y * width;
+		for (int x = 0; x < width; x++) {
+			float eigenvalue = rows.eigenvalues[x] + columns.eigenvalues[y];
+			row[x] = eigenvalue != 0.0f ? row[x] / eigenvalue : 0.0f;
+		}
+	});
+
+	transformColumns(pressure, width, height, true);
+	transformRows(pressure, width, height, true);
+}
+
+
+double DctSolver::residual(int width, int height, const float* divergence, const float* pressure) {
+	auto at = [&](const float* plane, int x, int y) {
+		x = std::min(std::max(x, 0), width - 1);
+		y = std::min(std::max(y, 0), height - 1);
+		return (double)plane[(size_t)y * width + x];
+	};
+
+	size_t cells = (size_t)width * height;
+	std::vector<double> r(cells);
+	double meanR = 0.0;
+	double meanD = 0.0;
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			double laplacian = at(pressure, x - 1, y) + at(pressure, x + 1, y) +
+				at(pressure, x, y - 1) + at(pressure, x, y + 1) - 4.0 * at(pressure, x, y);
+			size_t i = (size_t)y * width + x;
+			r[i] = laplacian - divergence[i];
+			meanR += r[i];
+			meanD += divergence[i];
+		}
+	}
+	meanR /= cells;
+	meanD /= cells;
+
+	double sumR = 0.0;
+	double sumD = 0.0;
+	for (size_t i = 0; i < cells; i++) {
+		sumR += (r[i] - meanR) * (r[i] - meanR);
+		sumD += (divergence[i] - meanD) * (divergence[i] - meanD);
+	}
+	return sumD > 0.0 ? std::sqrt(sumR / sumD) : 0.0;
+}
+
+
+void DctSolver::createPlan(Plan& plan, int n) {
+	const double pi = 3.14159265358979323846;
+
+	plan.n = n;
+	plan.fft = Fft(n);
+
+	plan.rotationRe.resize(n);
+	plan.rotationIm.resize(n);
+	plan.eigenvalues.resize(n);
+	for (int k = 0; k < n; k++) {
+		plan.rotationRe[k] = (float)std::cos(pi * k / (2.0 * n));
+		plan.rotationIm[k] = (float)-std::sin(pi * k / (2.0 * n));
+		plan.eigenvalues[k] = (float)(2.0 * std::cos(pi * k / n) - 2.0);
+	}
+}
+
+
+void DctSolver::transformRows(float* data, int width, int height, bool inverse) {
+	const int lanes = Fft::LANES;
+	int batches = (height + lanes - 1) / lanes;
+
+	pool->parallelFor(batches, [&](int batch) {
+		std::vector<float> x((size_t)width * lanes, 0.0f);
+		std::vector<float> re((size_t)width * lanes);
+		std::vector<float> im((size_t)width * lanes);
+
+		// lane b is row y0 + b, missing rows of the last batch stay zero
+		int y0 = batch * lanes;
+		int count = std::min(lanes, height - y0);
+		for (int b = 0; b < count; b++) {
+			const float* row = data + (size_t)(y0 + b) * width;
+			for (int i = 0; i < width; i++) {
+				x[(size_t)i * lanes + b] = row[i];
+			}
+		}
+
+		if (inverse) {
+			inverseDct(rows, x.data(), re.data(), im.data());
+		}
+		else {
+			dct(rows, x.data(), re.data(), im.data());
+		}
+
+		for (int b = 0; b < count; b++) {
+			float* row = data + (size_t)(y0 + b) * width;
+			for (int i = 0; i < width; i++) {
+				row[i] = x[(size_t)i * lanes + b];
+			}
+		}
+	});
+}
+
+
+void DctSolver::transformColumns(float* data, int width, int height, bool inverse) {
+	const int lanes = Fft::LANES;
+	int batches = (width + lanes - 1) / lanes;
+
+	pool->parallelFor(batches, [&](int batch) {
+		std::vector<float> x((size_t)height * lanes, 0.0f);
+		std::vector<float> re((size_t)height * lanes);
+		std::vector<float> im((size_t)height * lanes);
+
+		// lane b is column x0 + b, so each row of the batch is one contiguous copy
+		int x0 = batch * lanes;
+		int count = std::min(lanes, width - x0);
+		for (int i = 0; i < height; i++) {
+			std::copy(data + (size_t)i * width + x0, data + (size_t)i * width + x0 + count, &x[(size_t)i * lanes]);
+		}
+
+		if (inverse) {
+			inverseDct(columns, x.data(), re.data(), im.data());
+		}
+		else {
+			dct(columns, x.data(), re.data(), im.data());
+		}
+
+		for (int i = 0; i < height; i++) {
+			std::copy(&x[(size_t)i * lanes], &x[(size_t)i * lanes] + count, data + (size_t)i * width + x0);
+		}
+	});
+}
+
+
+void DctSolver::dct(const Plan& plan, float* x, float* re, float* im) {
+	// makhoul: even samples forwards, odd samples backwards, one complex fft
+	// and a rotation of every coefficient
+	const int lanes = Fft::LANES;
+	int n = plan.n;
+
+	for (int i = 0; i < n; i++) {
+		int source = i < (n + 1) / 2 ? 2 * i : 2 * (n - 1 - i) + 1;
+		for (int b = 0; b < lanes; b++) {
+			re[(size_t)i * lanes + b] = x[(size_t)source * lanes + b];
+			im[(size_t)i * lanes + b] = 0.0f;
+		}
+	}
+
+	plan.fft.forward(re, im);
+
+	for (int k = 0; k < n; k++) {
+		float c = plan.rotationRe[k];
+		float s = plan.rotationIm[k];
+		for (int b = 0; b < lanes; b++) {
+			size_t i = (size_t)k * lanes + b;
+			x[i] = 2.0f * (re[i] * c - im[i] * s);
+		}
+	}
+}
+
+
+void DctSolver::inverseDct(const Plan& plan, float* x, float* re, float* im) {
+	const int lanes = Fft::LANES;
+	int n = plan.n;
+
+	// undo the rotation, X[k] - i X[n - k] times exp(i pi k / 2n) / 2
+	for (int k = 0; k < n; k++) {
+		float c = plan.rotationRe[k];
+		float s = -plan.rotationIm[k];
+		for (int b = 0; b < lanes; b++) {
+			float a = x[(size_t)k * lanes + b];
+			float mirror = k > 0 ? x[(size_t)(n - k) * lanes + b] : 0.0f;
+			re[(size_t)k * lanes + b] = 0.5f * (a * c + mirror * s);
+			im[(size_t)k * lanes + b] = 0.5f * (a * s - mirror * c);
+		}
+	}
+
+	plan.fft.inverse(re, im);
+
+	for (int i = 0; i < n; i++) {
+		int target = i < (n + 1) / 2 ? 2 * i : 2 * (n - 1 - i) + 1;
+		for (int b = 0; b < lanes; b++) {
+			x[(size_t)target * lanes + b] = re[(size_t)i * lanes + b];
+		}
+	}
+}
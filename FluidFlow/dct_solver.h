@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "fft.h"
+#include "thread_pool.h"
+
+// direct solver for the pressure equation of pressure.frag on the cpu. with
+// the clamp to edge (neumann) border, the 5 point laplacian is diagonal in
+// the basis of 2d DCT-II, so the solve is a DCT of the divergence, one
+// division per coefficient and an inverse DCT. the DCTs run through Fft on
+// Fft::LANES rows or columns at a time, batches are spread over a thread pool
+class DctSolver {
+public:
+	// threadCount of 0 uses every hardware thread
+	explicit DctSolver(unsigned int threadCount = 0);
+
+	// solves laplacian(pressure) = divergence on a width x height grid, both
+	// row major with row 0 at the bottom. the mean of the divergence has no
+	// solution with neumann borders and is dropped, the pressure has zero mean
+	void solve(int width, int height, const float* divergence, float* pressure);
+
+	// |laplacian(pressure) - divergence| / |divergence|, both without their
+	// mean, for comparing solutions
+	static double residual(int width, int height, const float* divergence, const float* pressure);
+
+private:
+	// transforms of one length, for rows or for columns
+	struct Plan {
+		int n = 0;
+		Fft fft;
+		std::vector<float> rotationRe;		// exp(-i pi k / 2n), DCT-II from the fft
+		std::vector<float> rotationIm;
+		std::vector<float> eigenvalues;		// of the 1d laplacian, 2 cos(pi k / n) - 2
+	};
+
+	unsigned int threadCount;
+	std::unique_ptr<ThreadPool> pool;
+
+	Plan rows;
+	Plan columns;
+
+	static void createPlan(Plan& plan, int n);
+
+	// in place DCT-II (or its inverse) of every row or every column of data
+	void transformRows(float* data, int width, int height, bool inverse);
+	void transformColumns(float* data, int width, int height, bool inverse);
+
+	// on Fft::LANES signals interleaved like Fft's, using re and im as scratch
+	static void dct(const Plan& plan, float* x, float* re, float* im);
+	static void inverseDct(const Plan& plan, float* x, float* re, float* im);
+};
@@ -0,0 +1,228 @@
+#include "fft.h"
+
+#include <cmath>
+#include <cstring>
+
+
+Fft::Fft() {}
+
+
+Fft::Fft(int n) : n(n) {
+	const double pi = 3.14159265358979323846;
+
+	int rest = n;
+	for (int radix : { 4, 2, 3, 5, 7, 11, 13 }) {
+		while (rest % radix == 0) {
+			factors.push_back(radix);
+			rest /= radix;
+		}
+	}
+
+	if (rest == 1) {
+		twiddleRe.resize(n);
+		twiddleIm.resize(n);
+		for (int t = 0; t < n; t++) {
+			twiddleRe[t] = (float)std::cos(2.0 * pi * t / n);
+			twiddleIm[t] = (float)-std::sin(2.0 * pi * t / n);
+		}
+		return;
+	}
+
+	// a large prime factor, x is convolved with a chirp instead
+	factors.clear();
+
+	int length = 1;
+	while (length < 2 * n - 1) {
+		length *= 2;
+	}
+	convolution = std::make_shared<Fft>(length);
+
+	chirpRe.resize(n);
+	chirpIm.resize(n);
+	for (int k = 0; k < n; k++) {
+		// k^2 mod 2n keeps the angle accurate for large k
+		long long square = (long long)k * k % (2LL * n);
+		chirpRe[k] = (float)std::cos(pi * square / n);
+		chirpIm[k] = (float)-std::sin(pi * square / n);
+	}
+
+	// the filter is the same for every lane, so it is transformed in lane 0
+	// and only that lane is kept
+	std::vector<float> re((size_t)length * LANES, 0.0f);
+	std::vector<float> im((size_t)length * LANES, 0.0f);
+	for (int k = 0; k < n; k++) {
+		re[(size_t)k * LANES] = chirpRe[k];
+		im[(size_t)k * LANES] = -chirpIm[k];
+		if (k > 0) {
+			re[(size_t)(length - k) * LANES] = chirpRe[k];
+			im[(size_t)(length - k) * LANES] = -chirpIm[k];
+		}
+	}
+	convolution->forward(re.data(), im.data());
+
+	filterRe.resize(length);
+	filterIm.resize(length);
+	for (int k = 0; k < length; k++) {
+		filterRe[k] = re[(size_t)k * LANES];
+		filterIm[k] = im[(size_t)k * LANES];
+	}
+}
+
+
+void Fft::forward(float* re, float* im) const {
+	if (n <= 1) {
+		return;
+	}
+	if (convolution) {
+		bluestein(re, im);
+	}
+	else {
+		mixedRadix(re, im);
+	}
+}
+
+
+void Fft::inverse(float* re, float* im) const {
+	// ifft(x) = conj(fft(conj(x))) / n
+	size_t count = (size_t)n * LANES;
+	for (size_t i = 0; i < count; i++) {
+		im[i] = -im[i];
+	}
+
+	forward(re, im);
+
+	float scale = 1.0f / n;
+	for (size_t i = 0; i < count; i++) {
+		re[i] *= scale;
+		im[i] *= -scale;
+	}
+}
+
+
+void Fft::mixedRadix(float* re, float* im) const {
+	std::vector<float> outRe((size_t)n * LANES);
+	std::vector<float> outIm((size_t)n * LANES);
+
+	transform(re, im, outRe.data(), outIm.data(), n, 1, 0);
+
+	std::memcpy(re, outRe.data(), outRe.size() * sizeof(float));
+	std::memcpy(im, outIm.data(), outIm.size() * sizeof(float));
+}
+
+
+void Fft::transform(const float* inRe, const float* inIm, float* outRe, float* outIm,
+	int length, int stride, int factor) const {
+
+	if (length == 1) {
+		for (int b = 0; b < LANES; b++) {
+			outRe[b] = inRe[b];
+			outIm[b] = inIm[b];
+		}
+		return;
+	}
+
+	// decimation in time: radix interleaved sub sequences of length / radix,
+	// each transformed into its own contiguous block of out
+	int radix = factors[factor];
+	int subLength = length / radix;
+	for (int q = 0; q < radix; q++) {
+		size_t inOffset = (size_t)q * stride * LANES;
+		size_t outOffset = (size_t)q * subLength * LANES;
+		transform(inRe + inOffset, inIm + inOffset, outRe + outOffset, outIm + outOffset,
+			subLength, stride * radix, factor + 1);
+	}
+
+	butterfly(outRe, outIm, length, radix);
+}
+
+
+void Fft::butterfly(float* re, float* im, int length, int radix) const {
+	int subLength = length / radix;
+	int twiddleStride = n / length;
+
+	float scratchRe[13][LANES];
+	float scratchIm[13][LANES];
+
+	for (int u = 0; u < subLength; u++) {
+		for (int q = 0; q < radix; q++) {
+			const float* sourceRe = re + (size_t)(u + q * subLength) * LANES;
+			const float* sourceIm = im + (size_t)(u + q * subLength) * LANES;
+			for (int b = 0; b < LANES; b++) {
+				scratchRe[q][b] = sourceRe[b];
+				scratchIm[q][b] = sourceIm[b];
+			}
+		}
+
+		// output k = u + j * subLength is sum over q of block q times
+		// exp(-2 pi i q k / length)
+		for (int j = 0; j < radix; j++) {
+			int k = u + j * subLength;
+			float* targetRe = re + (size_t)k * LANES;
+			float* targetIm = im + (size_t)k * LANES;
+
+			float accRe[LANES];
+			float accIm[LANES];
+			for (int b = 0; b < LANES; b++) {
+				accRe[b] = scratchRe[0][b];
+				accIm[b] = scratchIm[0][b];
+			}
+
+			int t = 0;
+			for (int q = 1; q < radix; q++) {
+				t += twiddleStride * k;
+				t %= n;
+				float wRe = twiddleRe[t];
+				float wIm = twiddleIm[t];
+				for (int b = 0; b < LANES; b++) {
+					accRe[b] += scratchRe[q][b] * wRe - scratchIm[q][b] * wIm;
+					accIm[b] += scratchRe[q][b] * wIm + scratchIm[q][b] * wRe;
+				}
+			}
+
+			for (int b = 0; b < LANES; b++) {
+				targetRe[b] = accRe[b];
+				targetIm[b] = accIm[b];
+			}
+		}
+	}
+}
+
+
+void Fft::bluestein(float* re, float* im) const {
+	int length = convolution->size();
+	std::vector<float> aRe((size_t)length * LANES, 0.0f);
+	std::vector<float> aIm((size_t)length * LANES, 0.0f);
+
+	for (int k = 0; k < n; k++) {
+		float wRe = chirpRe[k];
+		float wIm = chirpIm[k];
+		for (int b = 0; b < LANES; b++) {
+			size_t i = (size_t)k * LANES + b;
+			aRe[i] = re[i] * wRe - im[i] * wIm;
+			aIm[i] = re[i] * wIm + im[i] * wRe;
+		}
+	}
+
+	convolution->forward(aRe.data(), aIm.data());
+	for (int k = 0; k < length; k++) {
+		float wRe = filterRe[k];
+		float wIm = filterIm[k];
+		for (int b = 0; b < LANES; b++) {
+			size_t i = (size_t)k * LANES + b;
+			float r = aRe[i] * wRe - aIm[i] * wIm;
+			aIm[i] = aRe[i] * wIm + aIm[i] * wRe;
+			aRe[i] = r;
+		}
+	}
+	convolution->inverse(aRe.data(), aIm.data());
+
+	for (int k = 0; k < n; k++) {
+		float wRe = chirpRe[k];
+		float wIm = chirpIm[k];
+		for (int b = 0; b < LANES; b++) {
+			size_t i = (size_t)k * LANES + b;
+			re[i] = aRe[i] * wRe - aIm[i] * wIm;
+			im[i] = aRe[i] * wIm + aIm[i] * wRe;
+		}
+	}
+}
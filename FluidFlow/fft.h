@@ -0,0 +1,48 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+// complex fft of any length, run on LANES independent signals at once. the
+// signals are interleaved, element i of lane b is at [i * LANES + b], so the
+// innermost loops run over contiguous lanes and vectorize. lengths made of
+// the factors 2, 3, 4, 5, 7, 11 and 13 use mixed radix cooley tukey, other
+// lengths go through bluestein's algorithm on a power of two length
+class Fft {
+public:
+	static const int LANES = 8;
+
+	Fft();
+	explicit Fft(int n);
+
+	int size() const { return n; }
+
+	// in place transforms of re/im, each n * LANES floats. inverse includes
+	// the 1 / n, so inverse(forward(x)) == x
+	void forward(float* re, float* im) const;
+	void inverse(float* re, float* im) const;
+
+private:
+	int n = 0;
+	std::vector<int> factors;			// radices, outermost first
+
+	// exp(-2 pi i t / n)
+	std::vector<float> twiddleRe;
+	std::vector<float> twiddleIm;
+
+	// bluestein, used when n has a prime factor above 13
+	std::shared_ptr<Fft> convolution;	// power of two length >= 2n - 1
+	std::vector<float> chirpRe;			// exp(-pi i k^2 / n)
+	std::vector<float> chirpIm;
+	std::vector<float> filterRe;		// transformed conjugate chirp
+	std::vector<float> filterIm;
+
+	void mixedRadix(float* re, float* im) const;
+	void bluestein(float* re, float* im) const;
+
+	// out of place recursion of mixedRadix. in is read with a stride of
+	// stride elements, out is written contiguously
+	void transform(const float* inRe, const float* inIm, float* outRe, float* outIm,
+		int length, int stride, int factor) const;
+	void butterfly(float* re, float* im, int length, int radix) const;
+};
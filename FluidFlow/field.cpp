@@ -0,0 +1,136 @@
+#include "field.h"
+
+#include <iostream>
+
+// everything known about the field formats
+struct FieldFormat {
+	GLenum internalFormat;
+	const char* name;
+	int channels;
+	GLenum format;
+	GLenum type;
+	size_t bytes;
+};
+
+static const FieldFormat FIELD_FORMATS[] = {
+	{ GL_R16F, "r16f", 1, GL_RED, GL_HALF_FLOAT, 2 },
+	{ GL_R32F, "r32f", 1, GL_RED, GL_FLOAT, 4 },
+	{ GL_RG16F, "rg16f", 2, GL_RG, GL_HALF_FLOAT, 4 },
+	{ GL_RG32F, "rg32f", 2, GL_RG, GL_FLOAT, 8 },
+	{ GL_RGBA8, "rgba8", 4, GL_RGBA, GL_UNSIGNED_BYTE, 4 },
+	{ GL_RGBA16F, "rgba16f", 4, GL_RGBA, GL_HALF_FLOAT, 8 },
+	{ GL_RGBA32F, "rgba32f", 4, GL_RGBA, GL_FLOAT, 16 }
+};
+
+
+static const FieldFormat* findFormat(GLenum internalFormat) {
+	for (const FieldFormat& format : FIELD_FORMATS) {
+		if (format.internalFormat == internalFormat) {
+			return &format;
+		}
+	}
+	return NULL;
+}
+
+
+PingPongField::PingPongField() {}
+
+
+void PingPongField::create(int width, int height, GLenum internalFormat) {
+	this->width = width;
+	this->height = height;
+	format = internalFormat;
+	front = 0;
+
+	createTarget(framebuffers[0], textures[0], width, height, internalFormat);
+	createTarget(framebuffers[1], textures[1], width, height, internalFormat);
+}
+
+
+void PingPongField::destroy() {
+	if (width == 0) {
+		return;
+	}
+	glDeleteFramebuffers(2, framebuffers);
+	glDeleteTextures(2, textures);
+	width = 0;
+	height = 0;
+}
+
+
+void PingPongField::exchangeRead(unsigned int& framebuffer, unsigned int& texture) {
+	unsigned int readFramebuffer = framebuffers[front];
+	unsigned int readTexture = textures[front];
+
+	framebuffers[front] = framebuffer;
+	textures[front] = texture;
+
+	framebuffer = readFramebuffer;
+	texture = readTexture;
+}
+
+
+void PingPongField::createTarget(unsigned int& framebuffer, unsigned int& texture,
+	int width, int height, GLenum internalFormat) {
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	GLenum format = GL_RGBA, type = GL_FLOAT;
+	pixelFormat(internalFormat, format, type);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+}
+
+
+bool PingPongField::pixelFormat(GLenum internalFormat, GLenum& format, GLenum& type) {
+	const FieldFormat* found = findFormat(internalFormat);
+	if (found == NULL) {
+		return false;
+	}
+	format = found->format;
+	type = found->type;
+	return true;
+}
+
+
+int PingPongField::channels(GLenum internalFormat) {
+	const FieldFormat* found = findFormat(internalFormat);
+	return found != NULL ? found->channels : 0;
+}
+
+
+size_t PingPongField::texelBytes(GLenum internalFormat) {
+	const FieldFormat* found = findFormat(internalFormat);
+	return found != NULL ? found->bytes : 0;
+}
+
+
+const char* PingPongField::formatName(GLenum internalFormat) {
+	const FieldFormat* found = findFormat(internalFormat);
+	return found != NULL ? found->name : "";
+}
+
+
+GLenum PingPongField::parseFormat(const std::string& name) {
+	for (const FieldFormat& format : FIELD_FORMATS) {
+		if (name == format.name) {
+			return format.internalFormat;
+		}
+	}
+	return GL_NONE;
+}
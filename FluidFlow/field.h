@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <string>
+
+// a simulation field stored as two framebuffer/texture pairs of the same size.
+// passes sample readTexture() and render into writeFramebuffer(), then call
+// swap() so the result becomes the read side without copying anything
+class PingPongField {
+public:
+	int width = 0;
+	int height = 0;
+	GLenum format = GL_RGBA16F;		// internal format of both textures
+
+	PingPongField();
+
+	// allocates both targets, nothing else may be called before this
+	void create(int width, int height, GLenum internalFormat = GL_RGBA16F);
+
+	// video memory of both textures
+	size_t bytes() const { return 2 * (size_t)width * height * texelBytes(format); }
+
+	// deletes both targets, if they were created
+	void destroy();
+
+	unsigned int readTexture() const { return textures[front]; }
+	unsigned int readFramebuffer() const { return framebuffers[front]; }
+	unsigned int writeTexture() const { return textures[1 - front]; }
+	unsigned int writeFramebuffer() const { return framebuffers[1 - front]; }
+
+	// makes the last written target the read side
+	void swap() { front = 1 - front; }
+
+	// swaps the read target with an external framebuffer/texture pair of the
+	// same size and format, for solves that need a third texture
+	void exchangeRead(unsigned int& framebuffer, unsigned int& texture);
+
+	// allocates a single framebuffer/texture pair with the same sampling state
+	static void createTarget(unsigned int& framebuffer, unsigned int& texture,
+		int width, int height, GLenum internalFormat = GL_RGBA16F);
+
+	// the field formats: GL_R16F, GL_R32F, GL_RG16F, GL_RG32F, GL_RGBA8,
+	// GL_RGBA16F and GL_RGBA32F. all are colour renderable and can be bound as
+	// images. the helpers below return 0, "" or false for any other format
+
+	// pixel format and type that read and write a texel without conversion
+	static bool pixelFormat(GLenum internalFormat, GLenum& format, GLenum& type);
+	// channels of a texel
+	static int channels(GLenum internalFormat);
+	// bytes of a texel
+	static size_t texelBytes(GLenum internalFormat);
+	// lower case name, as in GLSL image layouts and on the command line
+	static const char* formatName(GLenum internalFormat);
+	// the format called name, GL_NONE for unknown names
+	static GLenum parseFormat(const std::string& name);
+
+private:
+	unsigned int framebuffers[2];
+	unsigned int textures[2];
+	int front = 0;
+};
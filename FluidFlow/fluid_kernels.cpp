@@ -0,0 +1,242 @@
+#include "fluid_kernels.h"
+
+#include <algorithm>
+
+#if defined(FLUID_KERNELS_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+static void advectScalar(const float* velocityX, const float* velocityY, float scale,
+	const float* const* sources, float* const* targets, int count,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	for (int y = y0; y < y1; y++) {
+		for (int x = x0; x < x1; x++) {
+			size_t i = (size_t)y * width + x;
+
+			// GL_LINEAR with GL_CLAMP_TO_EDGE, in texels with 0 at the first centre
+			float sourceX = x - scale * velocityX[i];
+			float sourceY = y - scale * velocityY[i];
+			sourceX = std::min(std::max(sourceX, 0.0f), (float)(width - 1));
+			sourceY = std::min(std::max(sourceY, 0.0f), (float)(height - 1));
+
+			int left = (int)sourceX;
+			int bottom = (int)sourceY;
+			int right = std::min(left + 1, width - 1);
+			int top = std::min(bottom + 1, height - 1);
+
+			float fx = sourceX - (float)left;
+			float fy = sourceY - (float)bottom;
+
+			size_t bottomRow = (size_t)bottom * width;
+			size_t topRow = (size_t)top * width;
+			for (int c = 0; c < count; c++) {
+				const float* source = sources[c];
+				float lower = source[bottomRow + left] + fx * (source[bottomRow + right] - source[bottomRow + left]);
+				float upper = source[topRow + left] + fx * (source[topRow + right] - source[topRow + left]);
+				targets[c][i] = lower + fy * (upper - lower);
+			}
+		}
+	}
+}
+
+
+static void jacobiScalar(const float* in, const float* rhs, float* out, float alpha, float inverseDiagonal,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	for (int y = y0; y < y1; y++) {
+		const float* row = in + (size_t)y * width;
+		const float* below = in + (size_t)std::max(y - 1, 0) * width;
+		const float* above = in + (size_t)std::min(y + 1, height - 1) * width;
+		const float* b = rhs + (size_t)y * width;
+		float* target = out + (size_t)y * width;
+
+		for (int x = x0; x < x1; x++) {
+			float sum = row[std::max(x - 1, 0)] + row[std::min(x + 1, width - 1)] + below[x] + above[x];
+			target[x] = (sum + alpha * b[x]) * inverseDiagonal;
+		}
+	}
+}
+
+
+static void divergenceScalar(const float* velocityX, const float* velocityY, float* out,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	for (int y = y0; y < y1; y++) {
+		const float* u = velocityX + (size_t)y * width;
+		const float* below = velocityY + (size_t)std::max(y - 1, 0) * width;
+		const float* above = velocityY + (size_t)std::min(y + 1, height - 1) * width;
+		float* target = out + (size_t)y * width;
+
+		for (int x = x0; x < x1; x++) {
+			float xTerm = (u[std::min(x + 1, width - 1)] - u[std::max(x - 1, 0)]) * 0.5f;
+			float yTerm = (above[x] - below[x]) * 0.5f;
+			target[x] = xTerm + yTerm;
+		}
+	}
+}
+
+
+static void projectScalar(const float* pressure, float* velocityX, float* velocityY,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	for (int y = y0; y < y1; y++) {
+		const float* p = pressure + (size_t)y * width;
+		const float* below = pressure + (size_t)std::max(y - 1, 0) * width;
+		const float* above = pressure + (size_t)std::min(y + 1, height - 1) * width;
+		float* u = velocityX + (size_t)y * width;
+		float* v = velocityY + (size_t)y * width;
+
+		for (int x = x0; x < x1; x++) {
+			u[x] -= (p[std::min(x + 1, width - 1)] - p[std::max(x - 1, 0)]) * 0.5f;
+			v[x] -= (above[x] - below[x]) * 0.5f;
+		}
+	}
+}
+
+
+static void boundaryScalar(float* plane, float scale, int width, int height) {
+	if (width < 3 || height < 3) {
+		// the borders overlap, so read every source before writing like the
+		// shader does. same precedence as boundary.frag: left, right, top, bottom
+		std::vector<float> values((size_t)width * height);
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				int sourceX = x;
+				int sourceY = y;
+				if (x == 0) {
+					sourceX = std::min(1, width - 1);
+				}
+				else if (x == width - 1) {
+					sourceX = std::max(width - 2, 0);
+				}
+				else if (y == height - 1) {
+					sourceY = std::max(height - 2, 0);
+				}
+				else if (y == 0) {
+					sourceY = std::min(1, height - 1);
+				}
+				values[(size_t)y * width + x] = scale * plane[(size_t)sourceY * width + sourceX];
+			}
+		}
+		std::copy(values.begin(), values.end(), plane);
+		return;
+	}
+
+	// the columns first, including the corners. they read columns 1 and
+	// width - 2, whose top and bottom texels are not written yet
+	for (int y = 0; y < height; y++) {
+		float* row = plane + (size_t)y * width;
+		row[0] = scale * row[1];
+		row[width - 1] = scale * row[width - 2];
+	}
+
+	float* bottom = plane;
+	float* top = plane + (size_t)(height - 1) * width;
+	const float* aboveBottom = plane + (size_t)width;
+	const float* belowTop = plane + (size_t)(height - 2) * width;
+	for (int x = 1; x < width - 1; x++) {
+		top[x] = scale * belowTop[x];
+		bottom[x] = scale * aboveBottom[x];
+	}
+}
+
+
+const FluidKernels FluidKernels::scalar = {
+	KernelIsa::SCALAR, "scalar",
+	advectScalar, jacobiScalar, divergenceScalar, projectScalar, boundaryScalar
+};
+
+#if !defined(FLUID_KERNELS_X86)
+const FluidKernels FluidKernels::avx2 = {
+	KernelIsa::SCALAR, "scalar",
+	advectScalar, jacobiScalar, divergenceScalar, projectScalar, boundaryScalar
+};
+
+const FluidKernels FluidKernels::avx512 = {
+	KernelIsa::SCALAR, "scalar",
+	advectScalar, jacobiScalar, divergenceScalar, projectScalar, boundaryScalar
+};
+#endif
+
+
+#if defined(FLUID_KERNELS_X86)
+static void cpuid(int leaf, int subleaf, unsigned int registers[4]) {
+#if defined(_MSC_VER)
+	int values[4];
+	__cpuidex(values, leaf, subleaf);
+	for (int i = 0; i < 4; i++) {
+		registers[i] = (unsigned int)values[i];
+	}
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+
+// register state the os saves on a context switch, XCR0
+static unsigned long long enabledState() {
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int low, high;
+	__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return ((unsigned long long)high << 32) | low;
+#endif
+}
+#endif
+
+
+KernelIsa FluidKernels::detect() {
+#if defined(FLUID_KERNELS_X86)
+	unsigned int registers[4];
+	cpuid(0, 0, registers);
+	if (registers[0] < 7) {
+		return KernelIsa::SCALAR;
+	}
+
+	// avx needs the os to save the ymm registers, announced through OSXSAVE
+	cpuid(1, 0, registers);
+	bool osxsave = (registers[2] & (1u << 27)) != 0;
+	bool avx = (registers[2] & (1u << 28)) != 0;
+	if (!osxsave || !avx) {
+		return KernelIsa::SCALAR;
+	}
+
+	unsigned long long state = enabledState();
+	bool ymm = (state & 0x6) == 0x6;			// sse and avx state
+	bool zmm = (state & 0xe6) == 0xe6;			// plus opmask and both zmm halves
+
+	cpuid(7, 0, registers);
+	bool avx2 = (registers[1] & (1u << 5)) != 0;
+	bool avx512f = (registers[1] & (1u << 16)) != 0;
+
+	// every level includes the one below, get() hands out the avx2 kernels
+	// for anything above scalar
+	if (!avx2 || !ymm) {
+		return KernelIsa::SCALAR;
+	}
+	if (avx512f && zmm) {
+		return KernelIsa::AVX512;
+	}
+	return KernelIsa::AVX2;
+#endif
+	return KernelIsa::SCALAR;
+}
+
+
+const FluidKernels& FluidKernels::get(KernelIsa isa) {
+	KernelIsa supported = detect();
+	if (isa == KernelIsa::AVX512 && supported == KernelIsa::AVX512) {
+		return avx512;
+	}
+	if (isa != KernelIsa::SCALAR && supported != KernelIsa::SCALAR) {
+		return avx2;
+	}
+	return scalar;
+}
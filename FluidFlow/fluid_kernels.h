@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FLUID_KERNELS_X86
+#endif
+
+// instruction set a FluidKernels table is written for
+enum class KernelIsa {
+	SCALAR,
+	AVX2,
+	AVX512
+};
+
+// std::vector allocator handing out cache line aligned storage, so the first
+// texel of a plane starts a 64 byte line and a full AVX-512 register
+template <typename T>
+struct AlignedAllocator {
+	using value_type = T;
+	static const std::size_t ALIGNMENT = 64;
+
+	AlignedAllocator() {}
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	// over allocates and keeps the pointer operator new returned just in
+	// front of the aligned block
+	T* allocate(std::size_t count) {
+		char* block = static_cast<char*>(::operator new(count * sizeof(T) + ALIGNMENT + sizeof(void*)));
+		std::uintptr_t start = reinterpret_cast<std::uintptr_t>(block + sizeof(void*));
+		char* aligned = block + sizeof(void*) + (ALIGNMENT - start % ALIGNMENT) % ALIGNMENT;
+		reinterpret_cast<void**>(aligned)[-1] = block;
+		return reinterpret_cast<T*>(aligned);
+	}
+	void deallocate(T* pointer, std::size_t) {
+		::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U>&) const { return true; }
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U>&) const { return false; }
+};
+
+// one float per texel, row major with row 0 at the bottom like the textures
+using AlignedPlane = std::vector<float, AlignedAllocator<float>>;
+
+// cpu versions of the stencils in shaders/fluid, each written once in plain
+// c++ and once with AVX2 and AVX-512 intrinsics. the intrinsic versions are
+// compiled without any global /arch or -m flags and only ever called after
+// cpuid says the cpu and the os support them, so one binary runs everywhere.
+// every kernel works on the texels [x0, x1) x [y0, y1) of width x height
+// planes and borders clamp like GL_CLAMP_TO_EDGE, so a caller can split the
+// grid into tiles. the vector versions do the same float operations in the
+// same order as the scalar ones, so all versions agree bit for bit
+struct FluidKernels {
+	KernelIsa isa;
+	const char* name;
+
+	// advection.frag: backtraces every texel by scale * velocity texels and
+	// samples each of the count sources there with GL_LINEAR filtering. the
+	// vector versions fetch the four bilinear taps by loading the rows around
+	// the backtraced points and permuting registers instead of gathering,
+	// texels whose taps do not fit in those rows fall back to scalar loads
+	void (*advect)(const float* velocityX, const float* velocityY, float scale,
+		const float* const* sources, float* const* targets, int count,
+		int width, int height, int x0, int y0, int x1, int y1);
+
+	// diffusion.frag and pressure.frag: one jacobi iteration
+	// out = (sum of the 4 neighbours of in + alpha * rhs) * inverseDiagonal
+	void (*jacobi)(const float* in, const float* rhs, float* out, float alpha, float inverseDiagonal,
+		int width, int height, int x0, int y0, int x1, int y1);
+
+	// the central difference divergence pressure.frag recomputes every iteration
+	void (*divergence)(const float* velocityX, const float* velocityY, float* out,
+		int width, int height, int x0, int y0, int x1, int y1);
+
+	// projection.frag: subtracts the central difference gradient of pressure,
+	// in place since every velocity texel is only read by itself
+	void (*project)(const float* pressure, float* velocityX, float* velocityY,
+		int width, int height, int x0, int y0, int x1, int y1);
+
+	// boundary.frag: overwrites the one texel wide border of the whole plane
+	// with scale times its inner neighbour, -1 reflects velocity and 1 copies
+	// pressure. only touches the perimeter, so it has no tile arguments
+	void (*boundary)(float* plane, float scale, int width, int height);
+
+	static const FluidKernels scalar;
+	static const FluidKernels avx2;
+	static const FluidKernels avx512;
+
+	// widest instruction set supported by both the cpu and the os
+	static KernelIsa detect();
+
+	// the table for isa, or for the widest supported one below it. on other
+	// architectures avx2 and avx512 hold the scalar kernels
+	static const FluidKernels& get(KernelIsa isa);
+	static const FluidKernels& best() { return get(detect()); }
+};
@@ -0,0 +1,269 @@
+#include "fluid_kernels.h"
+
+#if defined(FLUID_KERNELS_X86)
+
+#include <algorithm>
+#include <immintrin.h>
+
+// msvc accepts the intrinsics anywhere, gcc and clang only in functions
+// compiled for the instruction set. gcc would also fuse the multiplies and
+// adds into fma instructions, which round differently from the scalar kernels
+#if defined(__clang__)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(__GNUC__)
+#define AVX2_TARGET __attribute__((target("avx2"), optimize("fp-contract=off")))
+#else
+#define AVX2_TARGET
+#endif
+
+
+AVX2_TARGET static int horizontalMin(__m256i value) {
+	__m128i m = _mm_min_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = _mm_min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(m);
+}
+
+
+// lanes of the 16 floats at row[0, 16) picked by index, without a gather
+AVX2_TARGET static __m256 select16(__m256 low, __m256 high, __m256i index) {
+	const __m256i seven = _mm256_set1_epi32(7);
+	__m256 fromLow = _mm256_permutevar8x32_ps(low, index);
+	__m256 fromHigh = _mm256_permutevar8x32_ps(high, index);
+	return _mm256_blendv_ps(fromLow, fromHigh, _mm256_castsi256_ps(_mm256_cmpgt_epi32(index, seven)));
+}
+
+
+AVX2_TARGET static void advectAvx2(const float* velocityX, const float* velocityY, float scale,
+	const float* const* sources, float* const* targets, int count,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	// the taps of 8 texels are fetched from a 16 texel wide window
+	if (width < 16) {
+		FluidKernels::scalar.advect(velocityX, velocityY, scale, sources, targets, count,
+			width, height, x0, y0, x1, y1);
+		return;
+	}
+
+	const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	const __m256 scaleVector = _mm256_set1_ps(scale);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 maxX = _mm256_set1_ps((float)(width - 1));
+	const __m256 maxY = _mm256_set1_ps((float)(height - 1));
+	const __m256i lastX = _mm256_set1_epi32(width - 1);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i fifteen = _mm256_set1_epi32(15);
+
+	for (int y = y0; y < y1; y++) {
+		const float* u = velocityX + (size_t)y * width;
+		const float* v = velocityY + (size_t)y * width;
+		const __m256 row = _mm256_set1_ps((float)y);
+
+		int x = x0;
+		for (; x + 8 <= x1; x += 8) {
+			__m256 sourceX = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps((float)x), lanes),
+				_mm256_mul_ps(scaleVector, _mm256_loadu_ps(u + x)));
+			__m256 sourceY = _mm256_sub_ps(row, _mm256_mul_ps(scaleVector, _mm256_loadu_ps(v + x)));
+			sourceX = _mm256_min_ps(_mm256_max_ps(sourceX, zero), maxX);
+			sourceY = _mm256_min_ps(_mm256_max_ps(sourceY, zero), maxY);
+
+			__m256i left = _mm256_cvttps_epi32(sourceX);
+			__m256i bottom = _mm256_cvttps_epi32(sourceY);
+			__m256 fx = _mm256_sub_ps(sourceX, _mm256_cvtepi32_ps(left));
+			__m256 fy = _mm256_sub_ps(sourceY, _mm256_cvtepi32_ps(bottom));
+
+			// all taps have to lie in the window starting at base of the rows
+			// lowest, lowest + 1 and lowest + 2, which holds whenever the
+			// backtrace of neighbouring texels differs by less than a few texels
+			int base = std::min(horizontalMin(left), width - 16);
+			int lowest = horizontalMin(bottom);
+			__m256i leftIndex = _mm256_sub_epi32(left, _mm256_set1_epi32(base));
+			__m256i rightIndex = _mm256_sub_epi32(_mm256_min_epi32(_mm256_add_epi32(left, one), lastX),
+				_mm256_set1_epi32(base));
+			__m256i rowOffset = _mm256_sub_epi32(bottom, _mm256_set1_epi32(lowest));
+
+			__m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(rightIndex, fifteen), _mm256_cmpgt_epi32(rowOffset, one));
+			if (!_mm256_testz_si256(outside, outside)) {
+				FluidKernels::scalar.advect(velocityX, velocityY, scale, sources, targets, count,
+					width, height, x, y, x + 8, y + 1);
+				continue;
+			}
+
+			// lanes whose bottom tap is in the middle row
+			__m256 shifted = _mm256_castsi256_ps(_mm256_cmpeq_epi32(rowOffset, one));
+
+			size_t row0 = (size_t)lowest * width + base;
+			size_t row1 = (size_t)std::min(lowest + 1, height - 1) * width + base;
+			size_t row2 = (size_t)std::min(lowest + 2, height - 1) * width + base;
+			size_t i = (size_t)y * width + x;
+
+			for (int c = 0; c < count; c++) {
+				const float* source = sources[c];
+				__m256 low0 = _mm256_loadu_ps(source + row0);
+				__m256 high0 = _mm256_loadu_ps(source + row0 + 8);
+				__m256 low1 = _mm256_loadu_ps(source + row1);
+				__m256 high1 = _mm256_loadu_ps(source + row1 + 8);
+				__m256 low2 = _mm256_loadu_ps(source + row2);
+				__m256 high2 = _mm256_loadu_ps(source + row2 + 8);
+
+				__m256 left1 = select16(low1, high1, leftIndex);
+				__m256 right1 = select16(low1, high1, rightIndex);
+				__m256 bottomLeft = _mm256_blendv_ps(select16(low0, high0, leftIndex), left1, shifted);
+				__m256 bottomRight = _mm256_blendv_ps(select16(low0, high0, rightIndex), right1, shifted);
+				__m256 topLeft = _mm256_blendv_ps(left1, select16(low2, high2, leftIndex), shifted);
+				__m256 topRight = _mm256_blendv_ps(right1, select16(low2, high2, rightIndex), shifted);
+
+				__m256 lower = _mm256_add_ps(bottomLeft, _mm256_mul_ps(fx, _mm256_sub_ps(bottomRight, bottomLeft)));
+				__m256 upper = _mm256_add_ps(topLeft, _mm256_mul_ps(fx, _mm256_sub_ps(topRight, topLeft)));
+				_mm256_storeu_ps(targets[c] + i, _mm256_add_ps(lower, _mm256_mul_ps(fy, _mm256_sub_ps(upper, lower))));
+			}
+		}
+
+		if (x < x1) {
+			FluidKernels::scalar.advect(velocityX, velocityY, scale, sources, targets, count,
+				width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX2_TARGET static void jacobiAvx2(const float* in, const float* rhs, float* out, float alpha, float inverseDiagonal,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	const __m256 alphaVector = _mm256_set1_ps(alpha);
+	const __m256 inverseVector = _mm256_set1_ps(inverseDiagonal);
+
+	// the first and last column clamp, they go through the scalar kernel
+	int start = std::max(x0, 1);
+	int stop = std::min(x1, width - 1);
+
+	for (int y = y0; y < y1; y++) {
+		const float* row = in + (size_t)y * width;
+		const float* below = in + (size_t)std::max(y - 1, 0) * width;
+		const float* above = in + (size_t)std::min(y + 1, height - 1) * width;
+		const float* b = rhs + (size_t)y * width;
+		float* target = out + (size_t)y * width;
+
+		int x = std::min(start, x1);
+		if (x0 < x) {
+			FluidKernels::scalar.jacobi(in, rhs, out, alpha, inverseDiagonal, width, height, x0, y, x, y + 1);
+		}
+
+		for (; x + 8 <= stop; x += 8) {
+			__m256 sum = _mm256_add_ps(_mm256_loadu_ps(row + x - 1), _mm256_loadu_ps(row + x + 1));
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(below + x));
+			sum = _mm256_add_ps(sum, _mm256_loadu_ps(above + x));
+			__m256 value = _mm256_add_ps(sum, _mm256_mul_ps(alphaVector, _mm256_loadu_ps(b + x)));
+			_mm256_storeu_ps(target + x, _mm256_mul_ps(value, inverseVector));
+		}
+
+		if (x < x1) {
+			FluidKernels::scalar.jacobi(in, rhs, out, alpha, inverseDiagonal, width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX2_TARGET static void divergenceAvx2(const float* velocityX, const float* velocityY, float* out,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	int start = std::max(x0, 1);
+	int stop = std::min(x1, width - 1);
+
+	for (int y = y0; y < y1; y++) {
+		const float* u = velocityX + (size_t)y * width;
+		const float* below = velocityY + (size_t)std::max(y - 1, 0) * width;
+		const float* above = velocityY + (size_t)std::min(y + 1, height - 1) * width;
+		float* target = out + (size_t)y * width;
+
+		int x = std::min(start, x1);
+		if (x0 < x) {
+			FluidKernels::scalar.divergence(velocityX, velocityY, out, width, height, x0, y, x, y + 1);
+		}
+
+		for (; x + 8 <= stop; x += 8) {
+			__m256 xTerm = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(u + x + 1), _mm256_loadu_ps(u + x - 1)), half);
+			__m256 yTerm = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(above + x), _mm256_loadu_ps(below + x)), half);
+			_mm256_storeu_ps(target + x, _mm256_add_ps(xTerm, yTerm));
+		}
+
+		if (x < x1) {
+			FluidKernels::scalar.divergence(velocityX, velocityY, out, width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX2_TARGET static void projectAvx2(const float* pressure, float* velocityX, float* velocityY,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	const __m256 half = _mm256_set1_ps(0.5f);
+
+	int start = std::max(x0, 1);
+	int stop = std::min(x1, width - 1);
+
+	for (int y = y0; y < y1; y++) {
+		const float* p = pressure + (size_t)y * width;
+		const float* below = pressure + (size_t)std::max(y - 1, 0) * width;
+		const float* above = pressure + (size_t)std::min(y + 1, height - 1) * width;
+		float* u = velocityX + (size_t)y * width;
+		float* v = velocityY + (size_t)y * width;
+
+		int x = std::min(start, x1);
+		if (x0 < x) {
+			FluidKernels::scalar.project(pressure, velocityX, velocityY, width, height, x0, y, x, y + 1);
+		}
+
+		for (; x + 8 <= stop; x += 8) {
+			__m256 gradientX = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(p + x + 1), _mm256_loadu_ps(p + x - 1)), half);
+			__m256 gradientY = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(above + x), _mm256_loadu_ps(below + x)), half);
+			_mm256_storeu_ps(u + x, _mm256_sub_ps(_mm256_loadu_ps(u + x), gradientX));
+			_mm256_storeu_ps(v + x, _mm256_sub_ps(_mm256_loadu_ps(v + x), gradientY));
+		}
+
+		if (x < x1) {
+			FluidKernels::scalar.project(pressure, velocityX, velocityY, width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX2_TARGET static void boundaryAvx2(float* plane, float scale, int width, int height) {
+	if (width < 3 || height < 3) {
+		FluidKernels::scalar.boundary(plane, scale, width, height);
+		return;
+	}
+
+	// columns first like the scalar kernel, only the rows are contiguous
+	for (int y = 0; y < height; y++) {
+		float* row = plane + (size_t)y * width;
+		row[0] = scale * row[1];
+		row[width - 1] = scale * row[width - 2];
+	}
+
+	const __m256 scaleVector = _mm256_set1_ps(scale);
+	float* bottom = plane;
+	float* top = plane + (size_t)(height - 1) * width;
+	const float* aboveBottom = plane + (size_t)width;
+	const float* belowTop = plane + (size_t)(height - 2) * width;
+
+	int x = 1;
+	for (; x + 8 <= width - 1; x += 8) {
+		_mm256_storeu_ps(top + x, _mm256_mul_ps(scaleVector, _mm256_loadu_ps(belowTop + x)));
+		_mm256_storeu_ps(bottom + x, _mm256_mul_ps(scaleVector, _mm256_loadu_ps(aboveBottom + x)));
+	}
+	for (; x < width - 1; x++) {
+		top[x] = scale * belowTop[x];
+		bottom[x] = scale * aboveBottom[x];
+	}
+}
+
+
+const FluidKernels FluidKernels::avx2 = {
+	KernelIsa::AVX2, "avx2",
+	advectAvx2, jacobiAvx2, divergenceAvx2, projectAvx2, boundaryAvx2
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include "fluid_kernels.h"
+
+#if defined(FLUID_KERNELS_X86)
+
+#include <algorithm>
+#include <immintrin.h>
+
+// see fluid_kernels_avx2.cpp
+#if defined(__clang__)
+#define AVX512_TARGET __attribute__((target("avx512f")))
+#elif defined(__GNUC__)
+#define AVX512_TARGET __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define AVX512_TARGET
+#endif
+
+
+AVX512_TARGET static void advectAvx512(const float* velocityX, const float* velocityY, float scale,
+	const float* const* sources, float* const* targets, int count,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	// the taps of 16 texels are fetched from a 32 texel wide window, which
+	// one two source permute picks from directly
+	if (width < 32) {
+		FluidKernels::scalar.advect(velocityX, velocityY, scale, sources, targets, count,
+			width, height, x0, y0, x1, y1);
+		return;
+	}
+
+	const __m512 lanes = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f,
+		8.0f, 9.0f, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f);
+	const __m512 scaleVector = _mm512_set1_ps(scale);
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 maxX = _mm512_set1_ps((float)(width - 1));
+	const __m512 maxY = _mm512_set1_ps((float)(height - 1));
+	const __m512i lastX = _mm512_set1_epi32(width - 1);
+	const __m512i one = _mm512_set1_epi32(1);
+	const __m512i thirtyOne = _mm512_set1_epi32(31);
+
+	for (int y = y0; y < y1; y++) {
+		const float* u = velocityX + (size_t)y * width;
+		const float* v = velocityY + (size_t)y * width;
+		const __m512 row = _mm512_set1_ps((float)y);
+
+		int x = x0;
+		for (; x + 16 <= x1; x += 16) {
+			__m512 sourceX = _mm512_sub_ps(_mm512_add_ps(_mm512_set1_ps((float)x), lanes),
+				_mm512_mul_ps(scaleVector, _mm512_loadu_ps(u + x)));
+			__m512 sourceY = _mm512_sub_ps(row, _mm512_mul_ps(scaleVector, _mm512_loadu_ps(v + x)));
+			sourceX = _mm512_min_ps(_mm512_max_ps(sourceX, zero), maxX);
+			sourceY = _mm512_min_ps(_mm512_max_ps(sourceY, zero), maxY);
+
+			__m512i left = _mm512_cvttps_epi32(sourceX);
+			__m512i bottom = _mm512_cvttps_epi32(sourceY);
+			__m512 fx = _mm512_sub_ps(sourceX, _mm512_cvtepi32_ps(left));
+			__m512 fy = _mm512_sub_ps(sourceY, _mm512_cvtepi32_ps(bottom));
+
+			// same window of three rows as the avx2 kernel, twice as wide
+			int base = std::min(_mm512_reduce_min_epi32(left), width - 32);
+			int lowest = _mm512_reduce_min_epi32(bottom);
+			__m512i leftIndex = _mm512_sub_epi32(left, _mm512_set1_epi32(base));
+			__m512i rightIndex = _mm512_sub_epi32(_mm512_min_epi32(_mm512_add_epi32(left, one), lastX),
+				_mm512_set1_epi32(base));
+			__m512i rowOffset = _mm512_sub_epi32(bottom, _mm512_set1_epi32(lowest));
+
+			__mmask16 outside = _mm512_cmpgt_epi32_mask(rightIndex, thirtyOne) | _mm512_cmpgt_epi32_mask(rowOffset, one);
+			if (outside != 0) {
+				FluidKernels::scalar.advect(velocityX, velocityY, scale, sources, targets, count,
+					width, height, x, y, x + 16, y + 1);
+				continue;
+			}
+
+			__mmask16 shifted = _mm512_cmpeq_epi32_mask(rowOffset, one);
+
+			size_t row0 = (size_t)lowest * width + base;
+			size_t row1 = (size_t)std::min(lowest + 1, height - 1) * width + base;
+			size_t row2 = (size_t)std::min(lowest + 2, height - 1) * width + base;
+			size_t i = (size_t)y * width + x;
+
+			for (int c = 0; c < count; c++) {
+				const float* source = sources[c];
+				__m512 low0 = _mm512_loadu_ps(source + row0);
+				__m512 high0 = _mm512_loadu_ps(source + row0 + 16);
+				__m512 low1 = _mm512_loadu_ps(source + row1);
+				__m512 high1 = _mm512_loadu_ps(source + row1 + 16);
+				__m512 low2 = _mm512_loadu_ps(source + row2);
+				__m512 high2 = _mm512_loadu_ps(source + row2 + 16);
+
+				__m512 left1 = _mm512_permutex2var_ps(low1, leftIndex, high1);
+				__m512 right1 = _mm512_permutex2var_ps(low1, rightIndex, high1);
+				__m512 bottomLeft = _mm512_mask_blend_ps(shifted, _mm512_permutex2var_ps(low0, leftIndex, high0), left1);
+				__m512 bottomRight = _mm512_mask_blend_ps(shifted, _mm512_permutex2var_ps(low0, rightIndex, high0), right1);
+				__m512 topLeft = _mm512_mask_blend_ps(shifted, left1, _mm512_permutex2var_ps(low2, leftIndex, high2));
+				__m512 topRight = _mm512_mask_blend_ps(shifted, right1, _mm512_permutex2var_ps(low2, rightIndex, high2));
+
+				__m512 lower = _mm512_add_ps(bottomLeft, _mm512_mul_ps(fx, _mm512_sub_ps(bottomRight, bottomLeft)));
+				__m512 upper = _mm512_add_ps(topLeft, _mm512_mul_ps(fx, _mm512_sub_ps(topRight, topLeft)));
+				_mm512_storeu_ps(targets[c] + i, _mm512_add_ps(lower, _mm512_mul_ps(fy, _mm512_sub_ps(upper, lower))));
+			}
+		}
+
+		if (x < x1) {
+			FluidKernels::avx2.advect(velocityX, velocityY, scale, sources, targets, count,
+				width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX512_TARGET static void jacobiAvx512(const float* in, const float* rhs, float* out, float alpha, float inverseDiagonal,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	const __m512 alphaVector = _mm512_set1_ps(alpha);
+	const __m512 inverseVector = _mm512_set1_ps(inverseDiagonal);
+
+	int start = std::max(x0, 1);
+	int stop = std::min(x1, width - 1);
+
+	for (int y = y0; y < y1; y++) {
+		const float* row = in + (size_t)y * width;
+		const float* below = in + (size_t)std::max(y - 1, 0) * width;
+		const float* above = in + (size_t)std::min(y + 1, height - 1) * width;
+		const float* b = rhs + (size_t)y * width;
+		float* target = out + (size_t)y * width;
+
+		int x = std::min(start, x1);
+		if (x0 < x) {
+			FluidKernels::scalar.jacobi(in, rhs, out, alpha, inverseDiagonal, width, height, x0, y, x, y + 1);
+		}
+
+		// the remainder is masked instead of falling back to scalar code
+		for (; x < stop; x += 16) {
+			__mmask16 mask = stop - x >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (stop - x)) - 1);
+			__m512 sum = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, row + x - 1), _mm512_maskz_loadu_ps(mask, row + x + 1));
+			sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(mask, below + x));
+			sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(mask, above + x));
+			__m512 value = _mm512_add_ps(sum, _mm512_mul_ps(alphaVector, _mm512_maskz_loadu_ps(mask, b + x)));
+			_mm512_mask_storeu_ps(target + x, mask, _mm512_mul_ps(value, inverseVector));
+		}
+
+		x = std::max(std::min(start, x1), stop);
+		if (x < x1) {
+			FluidKernels::scalar.jacobi(in, rhs, out, alpha, inverseDiagonal, width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX512_TARGET static void divergenceAvx512(const float* velocityX, const float* velocityY, float* out,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	const __m512 half = _mm512_set1_ps(0.5f);
+
+	int start = std::max(x0, 1);
+	int stop = std::min(x1, width - 1);
+
+	for (int y = y0; y < y1; y++) {
+		const float* u = velocityX + (size_t)y * width;
+		const float* below = velocityY + (size_t)std::max(y - 1, 0) * width;
+		const float* above = velocityY + (size_t)std::min(y + 1, height - 1) * width;
+		float* target = out + (size_t)y * width;
+
+		int x = std::min(start, x1);
+		if (x0 < x) {
+			FluidKernels::scalar.divergence(velocityX, velocityY, out, width, height, x0, y, x, y + 1);
+		}
+
+		for (; x < stop; x += 16) {
+			__mmask16 mask = stop - x >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (stop - x)) - 1);
+			__m512 xTerm = _mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, u + x + 1),
+				_mm512_maskz_loadu_ps(mask, u + x - 1)), half);
+			__m512 yTerm = _mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, above + x),
+				_mm512_maskz_loadu_ps(mask, below + x)), half);
+			_mm512_mask_storeu_ps(target + x, mask, _mm512_add_ps(xTerm, yTerm));
+		}
+
+		x = std::max(std::min(start, x1), stop);
+		if (x < x1) {
+			FluidKernels::scalar.divergence(velocityX, velocityY, out, width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX512_TARGET static void projectAvx512(const float* pressure, float* velocityX, float* velocityY,
+	int width, int height, int x0, int y0, int x1, int y1) {
+
+	const __m512 half = _mm512_set1_ps(0.5f);
+
+	int start = std::max(x0, 1);
+	int stop = std::min(x1, width - 1);
+
+	for (int y = y0; y < y1; y++) {
+		const float* p = pressure + (size_t)y * width;
+		const float* below = pressure + (size_t)std::max(y - 1, 0) * width;
+		const float* above = pressure + (size_t)std::min(y + 1, height - 1) * width;
+		float* u = velocityX + (size_t)y * width;
+		float* v = velocityY + (size_t)y * width;
+
+		int x = std::min(start, x1);
+		if (x0 < x) {
+			FluidKernels::scalar.project(pressure, velocityX, velocityY, width, height, x0, y, x, y + 1);
+		}
+
+		for (; x < stop; x += 16) {
+			__mmask16 mask = stop - x >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (stop - x)) - 1);
+			__m512 gradientX = _mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, p + x + 1),
+				_mm512_maskz_loadu_ps(mask, p + x - 1)), half);
+			__m512 gradientY = _mm512_mul_ps(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask, above + x),
+				_mm512_maskz_loadu_ps(mask, below + x)), half);
+			_mm512_mask_storeu_ps(u + x, mask, _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, u + x), gradientX));
+			_mm512_mask_storeu_ps(v + x, mask, _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, v + x), gradientY));
+		}
+
+		x = std::max(std::min(start, x1), stop);
+		if (x < x1) {
+			FluidKernels::scalar.project(pressure, velocityX, velocityY, width, height, x, y, x1, y + 1);
+		}
+	}
+}
+
+
+AVX512_TARGET static void boundaryAvx512(float* plane, float scale, int width, int height) {
+	if (width < 3 || height < 3) {
+		FluidKernels::scalar.boundary(plane, scale, width, height);
+		return;
+	}
+
+	for (int y = 0; y < height; y++) {
+		float* row = plane + (size_t)y * width;
+		row[0] = scale * row[1];
+		row[width - 1] = scale * row[width - 2];
+	}
+
+	const __m512 scaleVector = _mm512_set1_ps(scale);
+	float* bottom = plane;
+	float* top = plane + (size_t)(height - 1) * width;
+	const float* aboveBottom = plane + (size_t)width;
+	const float* belowTop = plane + (size_t)(height - 2) * width;
+
+	for (int x = 1; x < width - 1; x += 16) {
+		int left = width - 1 - x;
+		__mmask16 mask = left >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << left) - 1);
+		_mm512_mask_storeu_ps(top + x, mask, _mm512_mul_ps(scaleVector, _mm512_maskz_loadu_ps(mask, belowTop + x)));
+		_mm512_mask_storeu_ps(bottom + x, mask, _mm512_mul_ps(scaleVector, _mm512_maskz_loadu_ps(mask, aboveBottom + x)));
+	}
+}
+
+
+const FluidKernels FluidKernels::avx512 = {
+	KernelIsa::AVX512, "avx512",
+	advectAvx512, jacobiAvx512, divergenceAvx512, projectAvx512, boundaryAvx512
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "frame_exporter.h"
+
+#include <cstring>
+#include <iostream>
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+
+FrameExporter::~FrameExporter() {
+	if (writer.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		writer.join();
+	}
+}
+
+
+bool FrameExporter::start(const std::string& path, int width, int height) {
+	if (path.size() > 1 && path[0] == '|') {
+#ifdef _WIN32
+		output = _popen(path.c_str() + 1, "wb");
+#else
+		// a closed pipe should fail the write instead of ending the program
+		signal(SIGPIPE, SIG_IGN);
+		output = popen(path.c_str() + 1, "w");
+#endif
+		pipe = true;
+	}
+	else {
+		output = std::fopen(path.c_str(), "wb");
+		pipe = false;
+	}
+	if (output == NULL) {
+		std::cout << "Unable to open " << path << " for the frame export" << std::endl;
+		return false;
+	}
+
+	if (format == ExportFormat::Y4M) {
+		std::fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, frameRate);
+	}
+
+	this->width = width;
+	this->height = height;
+	frameSize = (size_t)width * height * 3;
+
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	ring.resize(ringSize < 1 ? 1 : ringSize);
+	for (Slot& slot : ring) {
+		glGenBuffers(1, &slot.buffer);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	head = 0;
+	inFlight = 0;
+
+	// every frame buffer is allocated up front, the writer hands them back
+	freeFrames.assign(queueDepth < 1 ? 1 : queueDepth, std::vector<unsigned char>(frameSize));
+	stopping = false;
+	failed = false;
+	frames = 0;
+	dropped = 0;
+	writer = std::thread(&FrameExporter::write, this);
+
+	std::cout << "Exporting " << width << "x" << height << (format == ExportFormat::Y4M ? " y4m" : " rgb24")
+		<< " frames to " << path << std::endl;
+	return true;
+}
+
+
+void FrameExporter::capture(const PingPongField& picture) {
+	if (output == NULL) {
+		return;
+	}
+	collect(false);
+
+	// the gpu is more than the whole ring behind, waiting would stall the frame
+	if (inFlight == (int)ring.size()) {
+		if (dropFrames) {
+			dropped++;
+			return;
+		}
+		collect(true);
+	}
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, picture.readFramebuffer());
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glBlitFramebuffer(0, 0, picture.width, picture.height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+	Slot& slot = ring[head];
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	head = (head + 1) % ring.size();
+	inFlight++;
+}
+
+
+void FrameExporter::collect(bool wait) {
+	while (inFlight > 0) {
+		Slot& slot = ring[(head - inFlight + ring.size()) % ring.size()];
+
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			if (wait && status == GL_TIMEOUT_EXPIRED) {
+				continue;
+			}
+			return;
+		}
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		inFlight--;
+
+		std::vector<unsigned char> frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!dropFrames) {
+				freed.wait(lock, [this] { return !freeFrames.empty(); });
+			}
+			if (!freeFrames.empty()) {
+				frame.swap(freeFrames.back());
+				freeFrames.pop_back();
+			}
+		}
+		// every buffer is queued or being written, the writer is behind
+		if (frame.empty()) {
+			dropped++;
+			continue;
+		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+		if (mapped != NULL) {
+			std::memcpy(frame.data(), mapped, frameSize);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (mapped != NULL) {
+				queue.push_back(std::move(frame));
+			}
+			else {
+				freeFrames.push_back(std::move(frame));
+				dropped++;
+			}
+		}
+		wake.notify_one();
+	}
+}
+
+
+void FrameExporter::finish() {
+	if (output == NULL) {
+		return;
+	}
+
+	collect(true);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	writer.join();
+
+#ifdef _WIN32
+	int closed = pipe ? _pclose(output) : std::fclose(output);
+#else
+	int closed = pipe ? pclose(output) : std::fclose(output);
+#endif
+	output = NULL;
+	if (closed != 0 && !failed) {
+		std::cout << "Frame export did not finish cleanly" << std::endl;
+	}
+
+	for (Slot& slot : ring) {
+		glDeleteBuffers(1, &slot.buffer);
+	}
+	ring.clear();
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteTextures(1, &texture);
+	freeFrames.clear();
+
+	std::cout << "Exported " << frames << " frames, dropped " << dropped << std::endl;
+}
+
+
+void FrameExporter::write() {
+	std::vector<unsigned char> converted(frameSize);
+
+	for (;;) {
+		std::vector<unsigned char> frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !queue.empty(); });
+			if (queue.empty()) {
+				return;
+			}
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+
+		if (!failed) {
+			if (writeFrame(frame, converted)) {
+				frames++;
+			}
+			else {
+				std::cout << "Writing the exported frames failed, stopping the export" << std::endl;
+				failed = true;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			freeFrames.push_back(std::move(frame));
+		}
+		freed.notify_one();
+	}
+}
+
+
+bool FrameExporter::writeFrame(const std::vector<unsigned char>& frame, std::vector<unsigned char>& converted) {
+	size_t row = (size_t)width * 3;
+	size_t pixels = (size_t)width * height;
+
+	// gl rows start at the bottom, video rows at the top
+	if (format == ExportFormat::RGB) {
+		for (int y = 0; y < height; y++) {
+			std::memcpy(&converted[y * row], &frame[(height - 1 - y) * row], row);
+		}
+		return std::fwrite(converted.data(), 1, frameSize, output) == frameSize;
+	}
+
+	// studio range bt.601, the y4m default, one plane after the other
+	unsigned char* luma = converted.data();
+	unsigned char* blue = luma + pixels;
+	unsigned char* red = blue + pixels;
+	for (int y = 0; y < height; y++) {
+		const unsigned char* source = &frame[(height - 1 - y) * row];
+		size_t target = (size_t)y * width;
+		for (int x = 0; x < width; x++) {
+			int r = source[3 * x];
+			int g = source[3 * x + 1];
+			int b = source[3 * x + 2];
+			luma[target + x] = (unsigned char)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			blue[target + x] = (unsigned char)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			red[target + x] = (unsigned char)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		}
+	}
+	return std::fwrite("FRAME\n", 1, 6, output) == 6 &&
+		std::fwrite(converted.data(), 1, frameSize, output) == frameSize;
+}
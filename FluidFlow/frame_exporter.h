@@ -0,0 +1,100 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "field.h"
+
+// how FrameExporter writes the frames
+enum class ExportFormat {
+	RGB,					// bare rgb24 frames, top row first
+	Y4M						// yuv4mpeg2 with 4:4:4 bt.601 frames
+};
+
+// streams the shown pictures to a file or a pipe. capture() blits the
+// picture into an 8 bit target and queues a read into the next pixel pack
+// buffer of a ring, a fence per buffer tells when the copy is done. buffers
+// are mapped only once their fence has signalled, so with ringSize buffers
+// the readback runs up to ringSize frames behind. a writer thread converts
+// and writes the frames.
+//
+// when the ring or the writer's queue is full, dropFrames decides: by
+// default the frame is dropped and counted, so the frame loop never waits
+// for the output. without it, capture() waits for the gpu's fences and for
+// the writer to give a buffer back, and every frame is written. scenario
+// replays export that way
+class FrameExporter {
+public:
+	ExportFormat format = ExportFormat::Y4M;
+	int frameRate = 60;					// written into the y4m header
+	int ringSize = 3;					// pixel pack buffers in flight
+	int queueDepth = 8;					// frames waiting for the writer
+	// false waits for the gpu and the writer instead of dropping, for runs
+	// that have to keep every frame
+	bool dropFrames = true;
+
+	FrameExporter() {}
+	~FrameExporter();
+
+	FrameExporter(const FrameExporter&) = delete;
+	FrameExporter& operator=(const FrameExporter&) = delete;
+
+	// opens path for width x height frames. a path starting with | runs the
+	// rest as a command and writes to its input, e.g.
+	// "|ffmpeg -i - -c:v libx264 out.mp4"
+	bool start(const std::string& path, int width, int height);
+
+	// queues a readback of the picture, scaled to the export size
+	void capture(const PingPongField& picture);
+
+	// writes the frames still in flight and closes the output
+	void finish();
+
+	bool active() const { return output != NULL; }
+
+	int frames = 0;						// written
+	int dropped = 0;					// not written because the ring or writer was full
+
+private:
+	struct Slot {
+		unsigned int buffer = 0;
+		GLsync fence = 0;
+	};
+
+	std::vector<Slot> ring;
+	int head = 0;						// next slot to read into
+	int inFlight = 0;					// slots with a read queued, oldest at head - inFlight
+
+	int width = 0;
+	int height = 0;
+	size_t frameSize = 0;
+
+	// 8 bit copy of the picture at the export size
+	unsigned int framebuffer = 0;
+	unsigned int texture = 0;
+
+	FILE* output = NULL;
+	bool pipe = false;
+
+	// frames handed to the writer, and buffers it has finished with
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable freed;		// the writer gave a buffer back
+	std::deque<std::vector<unsigned char>> queue;
+	std::vector<std::vector<unsigned char>> freeFrames;
+	bool stopping = false;
+	bool failed = false;
+
+	// moves finished readbacks to the writer, waiting for them when wait is set
+	void collect(bool wait);
+	void write();						// runs on the writer thread
+	bool writeFrame(const std::vector<unsigned char>& frame, std::vector<unsigned char>& converted);
+};
@@ -0,0 +1,34 @@
+#include "input_queue.h"
+
+
+InputQueue::InputQueue() : pushIndex(0), popIndex(0), droppedEvents(0) {}
+
+
+bool InputQueue::push(const InputEvent& event) {
+	unsigned int index = pushIndex.load(std::memory_order_relaxed);
+	if (index - popIndex.load(std::memory_order_acquire) == CAPACITY) {
+		droppedEvents.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	events[index % CAPACITY] = event;
+	pushIndex.store(index + 1, std::memory_order_release);
+	return true;
+}
+
+
+bool InputQueue::peek(InputEvent& event) const {
+	unsigned int index = popIndex.load(std::memory_order_relaxed);
+	if (index == pushIndex.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	event = events[index % CAPACITY];
+	return true;
+}
+
+
+void InputQueue::pop() {
+	// the slot is free for the producer once the index has moved past it
+	popIndex.store(popIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
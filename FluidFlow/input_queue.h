@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+
+// what a GLFW callback saw of the mouse, the cursor in screen coordinates
+// of the window with y pointing down
+struct InputEvent {
+	enum class Type {
+		MOVE,
+		PRESS,
+		RELEASE
+	};
+
+	Type type = Type::MOVE;
+	double time = 0.0;					// glfwGetTime() when it arrived
+	float x = 0.0f;
+	float y = 0.0f;
+};
+
+// hands the input events from the GLFW callbacks to the steps in the order
+// they came. one thread pushes and one pops, without locking: each end only
+// writes its own index, and an event is published by the release store of
+// the push index after it was written. a full queue drops what is pushed
+// and counts it, the callbacks never wait for the steps
+class InputQueue {
+public:
+	static const unsigned int CAPACITY = 1024;
+
+	InputQueue();
+
+	// from the producer, false when the queue is full and event was dropped
+	bool push(const InputEvent& event);
+
+	// from the consumer, the oldest event without removing it, false when
+	// there is none
+	bool peek(InputEvent& event) const;
+
+	// from the consumer, removes the event peek() returned
+	void pop();
+
+	// events push() dropped since the start
+	unsigned int dropped() const { return droppedEvents.load(std::memory_order_relaxed); }
+
+private:
+	InputEvent events[CAPACITY];
+
+	// both count up and wrap, the slot is the index modulo CAPACITY
+	std::atomic<unsigned int> pushIndex;
+	std::atomic<unsigned int> popIndex;
+	std::atomic<unsigned int> droppedEvents;
+};
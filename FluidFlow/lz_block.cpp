@@ -0,0 +1,237 @@
+#include "lz_block.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// limits of the LZ4 block format, a decoder relies on them
+static const size_t MIN_MATCH = 4;
+static const size_t LAST_LITERALS = 5;		// the block always ends with 5 literals
+static const size_t MATCH_LIMIT = 12;		// no match starts in the last 12 bytes
+static const size_t MAX_OFFSET = 65535;
+
+static const int HASH_BITS = 16;
+
+
+static uint32_t read32(const unsigned char* p) {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+
+static uint32_t hash(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+// a literal count or match length of 15 and more continues in extra bytes
+// of 255 each, ended by one below 255
+static bool writeLength(unsigned char*& out, const unsigned char* end, size_t length) {
+	for (; length >= 255; length -= 255) {
+		if (out >= end) {
+			return false;
+		}
+		*out++ = 255;
+	}
+	if (out >= end) {
+		return false;
+	}
+	*out++ = (unsigned char)length;
+	return true;
+}
+
+
+static bool readLength(const unsigned char*& in, const unsigned char* end, size_t& length) {
+	unsigned char extra;
+	do {
+		if (in >= end) {
+			return false;
+		}
+		extra = *in++;
+		length += extra;
+	} while (extra == 255);
+	return true;
+}
+
+
+// one sequence: literals followed by a match, or only literals at the end
+// of the block when matchLength is 0
+static bool writeSequence(unsigned char*& out, const unsigned char* end,
+	const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength) {
+
+	if (out >= end) {
+		return false;
+	}
+	unsigned char* token = out++;
+	unsigned char literalNibble = (unsigned char)(literalCount >= 15 ? 15 : literalCount);
+	if (literalCount >= 15 && !writeLength(out, end, literalCount - 15)) {
+		return false;
+	}
+	if ((size_t)(end - out) < literalCount) {
+		return false;
+	}
+	std::memcpy(out, literals, literalCount);
+	out += literalCount;
+
+	if (matchLength == 0) {
+		*token = (unsigned char)(literalNibble << 4);
+		return true;
+	}
+
+	if (end - out < 2) {
+		return false;
+	}
+	*out++ = (unsigned char)(offset & 255);
+	*out++ = (unsigned char)(offset >> 8);
+
+	size_t length = matchLength - MIN_MATCH;
+	unsigned char matchNibble = (unsigned char)(length >= 15 ? 15 : length);
+	if (length >= 15 && !writeLength(out, end, length - 15)) {
+		return false;
+	}
+	*token = (unsigned char)((literalNibble << 4) | matchNibble);
+	return true;
+}
+
+
+size_t LzBlock::bound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+
+size_t LzBlock::compress(const unsigned char* source, size_t size, unsigned char* target, size_t capacity) {
+	unsigned char* out = target;
+	const unsigned char* end = target + capacity;
+	size_t anchor = 0;		// first byte not written yet
+
+	// shorter blocks are all literals
+	if (size > MATCH_LIMIT) {
+		std::vector<uint32_t> table((size_t)1 << HASH_BITS, 0);
+		size_t limit = size - MATCH_LIMIT;
+		size_t matchEndLimit = size - LAST_LITERALS;
+
+		size_t i = 0;
+		while (i <= limit) {
+			uint32_t sequence = read32(source + i);
+			uint32_t slot = hash(sequence);
+			size_t candidate = table[slot];
+			table[slot] = (uint32_t)i;
+
+			if (candidate >= i || i - candidate > MAX_OFFSET || read32(source + candidate) != sequence) {
+				// skip faster through data that does not compress
+				i += 1 + ((i - anchor) >> 6);
+				continue;
+			}
+
+			size_t matchEnd = i + MIN_MATCH;
+			while (matchEnd < matchEndLimit && source[matchEnd] == source[matchEnd - (i - candidate)]) {
+				matchEnd++;
+			}
+
+			// the match may also extend back over literals
+			size_t start = i;
+			while (start > anchor && candidate > 0 && source[start - 1] == source[candidate - 1]) {
+				start--;
+				candidate--;
+			}
+
+			if (!writeSequence(out, end, source + anchor, start - anchor, start - candidate, matchEnd - start)) {
+				return 0;
+			}
+			anchor = matchEnd;
+			i = matchEnd;
+		}
+	}
+
+	if (!writeSequence(out, end, source + anchor, size - anchor, 0, 0)) {
+		return 0;
+	}
+	return (size_t)(out - target);
+}
+
+
+bool LzBlock::decompress(const unsigned char* source, size_t size, unsigned char* target, size_t rawSize) {
+	const unsigned char* in = source;
+	const unsigned char* inEnd = source + size;
+	unsigned char* out = target;
+	unsigned char* outEnd = target + rawSize;
+
+	while (in < inEnd) {
+		unsigned char token = *in++;
+
+		size_t literalCount = token >> 4;
+		if (literalCount == 15 && !readLength(in, inEnd, literalCount)) {
+			return false;
+		}
+		if (literalCount > (size_t)(inEnd - in) || literalCount > (size_t)(outEnd - out)) {
+			return false;
+		}
+		std::memcpy(out, in, literalCount);
+		in += literalCount;
+		out += literalCount;
+
+		// the last sequence has no match
+		if (in == inEnd) {
+			break;
+		}
+
+		if (inEnd - in < 2) {
+			return false;
+		}
+		size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+		in += 2;
+		if (offset == 0 || offset > (size_t)(out - target)) {
+			return false;
+		}
+
+		size_t length = token & 15;
+		if (length == 15 && !readLength(in, inEnd, length)) {
+			return false;
+		}
+		length += MIN_MATCH;
+		if (length > (size_t)(outEnd - out)) {
+			return false;
+		}
+
+		// overlapping matches repeat the last offset bytes, so they have to
+		// be copied front to back one byte at a time
+		const unsigned char* match = out - offset;
+		if (offset >= length) {
+			std::memcpy(out, match, length);
+		}
+		else {
+			for (size_t k = 0; k < length; k++) {
+				out[k] = match[k];
+			}
+		}
+		out += length;
+	}
+
+	return out == outEnd;
+}
+
+
+void LzBlock::shuffle(const unsigned char* source, size_t size, unsigned char* target, size_t width) {
+	size_t count = size / width;
+	for (size_t b = 0; b < width; b++) {
+		unsigned char* plane = target + b * count;
+		for (size_t i = 0; i < count; i++) {
+			plane[i] = source[i * width + b];
+		}
+	}
+	// a partial element at the end stays as it is
+	std::memcpy(target + count * width, source + count * width, size - count * width);
+}
+
+
+void LzBlock::unshuffle(const unsigned char* source, size_t size, unsigned char* target, size_t width) {
+	size_t count = size / width;
+	for (size_t b = 0; b < width; b++) {
+		const unsigned char* plane = source + b * count;
+		for (size_t i = 0; i < count; i++) {
+			target[i * width + b] = plane[i];
+		}
+	}
+	std::memcpy(target + count * width, source + count * width, size - count * width);
+}
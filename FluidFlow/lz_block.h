@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
+// byte oriented lz77 compression in the LZ4 block format: a token byte with
+// the literal count and match length in its two nibbles, the literals, and a
+// 16 bit little endian offset back into the output. greedy matching through
+// a hash table of 4 byte sequences, which is fast enough to run on every
+// checkpoint. no frame, checksum or dictionary, the caller keeps the sizes
+class LzBlock {
+public:
+	// largest compressed size of size bytes, for sizing the output
+	static size_t bound(size_t size);
+
+	// compresses source into target, which has room for capacity bytes.
+	// returns the compressed size, or 0 when it does not fit
+	static size_t compress(const unsigned char* source, size_t size, unsigned char* target, size_t capacity);
+
+	// decompresses exactly rawSize bytes into target. false when source is
+	// not a valid block or does not decompress to rawSize bytes
+	static bool decompress(const unsigned char* source, size_t size, unsigned char* target, size_t rawSize);
+
+	// byte shuffle of elements of width bytes: all first bytes, then all
+	// second bytes and so on. groups the exponent bytes of floats, which
+	// makes them compress far better
+	static void shuffle(const unsigned char* source, size_t size, unsigned char* target, size_t width);
+	static void unshuffle(const unsigned char* source, size_t size, unsigned char* target, size_t width);
+};
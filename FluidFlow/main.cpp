@@ -1,8 +1,317 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "cpu_simulation.h"
+#include "program_cache.h"
 #include "simulation.h"
+#include "split_run.h"
+
+
+// runs the cpu solver without creating a window or gl context
+// usage: FluidFlow --headless [--size width height] [--steps n] [--threads n]
+//     [--kernels scalar|avx2|avx512] [--output picture.ppm] [--processes n]
+int runHeadless(int argc, char** argv) {
+	int width = 1000;
+	int height = 1000;
+	int steps = 100;
+	unsigned int threads = 0;
+	int processes = 1;
+	KernelIsa isa = FluidKernels::detect();
+	std::string output;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+			width = std::atoi(argv[++i]);
+			height = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+			steps = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = (unsigned int)std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--kernels") == 0 && i + 1 < argc) {
+			i++;
+			if (std::strcmp(argv[i], "scalar") == 0) {
+				isa = KernelIsa::SCALAR;
+			}
+			else if (std::strcmp(argv[i], "avx2") == 0) {
+				isa = KernelIsa::AVX2;
+			}
+			else if (std::strcmp(argv[i], "avx512") == 0) {
+				isa = KernelIsa::AVX512;
+			}
+			else {
+				std::cout << "Unknown kernels " << argv[i] << ", expected scalar, avx2 or avx512" << std::endl;
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+			processes = std::atoi(argv[++i]);
+		}
+	}
+
+	if (width <= 0 || height <= 0) {
+		std::cout << "Invalid grid size " << width << "x" << height << std::endl;
+		return 1;
+	}
+
+	// --threads is per process then
+	if (processes > 1) {
+		SplitRun split;
+		split.processes = processes;
+		split.threadsPerProcess = threads;
+		split.isa = isa;
+		return split.run(width, height, steps, output) ? 0 : 1;
+	}
+
+	CpuSimulation sim(width, height, threads);
+	sim.useKernels(isa);
+	std::cout << "Running " << steps << " steps on a " << width << "x" << height
+		<< " grid with " << sim.threadCount() << " threads and " << sim.kernelName() << " kernels" << std::endl;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; i++) {
+		sim.step();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << seconds * 1000.0 / (steps > 0 ? steps : 1) << " ms per step, "
+		<< (seconds > 0.0 ? (double)width * height * steps / seconds / 1.0e6 : 0.0) << " Mcells/s" << std::endl;
+
+	if (!output.empty()) {
+		sim.writePicture(output);
+	}
+	return 0;
+}
+
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--headless") == 0) {
+			return runHeadless(argc, argv);
+		}
+	}
+
+	// --grid and --dye set the cells along the shorter window side of the
+	// velocity/pressure grid and of the picture. --restart continues from a
+	// checkpoint file. --scenario replays a scenario file instead of taking
+	// input, its resolution wins over --grid and --dye, and --timings writes
+	// every step's time. --no-shader-cache compiles every shader instead of
+	// loading the programs saved by an earlier start. --velocity-format,
+	// --pressure-format and --picture-format pick the texture formats of the
+	// fields, and --field-budget lowers the resolutions until the fields fit
+	// in that many MB
+	FieldFormats formats;
+	int gridResolution = 256;
+	int dyeResolution = 1024;
+	std::string restartPath;
+	std::string scenarioPath;
+	std::string timingsPath;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+			gridResolution = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--dye") == 0 && i + 1 < argc) {
+			dyeResolution = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--restart") == 0 && i + 1 < argc) {
+			restartPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+			scenarioPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--timings") == 0 && i + 1 < argc) {
+			timingsPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--no-shader-cache") == 0) {
+			ProgramCache::directory = "";
+		}
+		else if (std::strcmp(argv[i], "--velocity-format") == 0 && i + 1 < argc) {
+			if (!formats.set("velocity", argv[++i])) {
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--pressure-format") == 0 && i + 1 < argc) {
+			if (!formats.set("pressure", argv[++i])) {
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--picture-format") == 0 && i + 1 < argc) {
+			if (!formats.set("picture", argv[++i])) {
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--field-budget") == 0 && i + 1 < argc) {
+			formats.budget = (size_t)(std::atof(argv[++i]) * 1024.0 * 1024.0);
+		}
+	}
+
+	Scenario scenario;
+	if (!scenarioPath.empty()) {
+		if (!scenario.load(scenarioPath)) {
+			return 1;
+		}
+		if (scenario.gridResolution > 0) {
+			gridResolution = scenario.gridResolution;
+			dyeResolution = scenario.dyeResolution;
+		}
+	}
+	if (gridResolution <= 0 || dyeResolution <= 0) {
+		std::cout << "Invalid grid resolution " << gridResolution << " or dye resolution " << dyeResolution << std::endl;
+		return 1;
+	}
+
+	Simulation sim(gridResolution, dyeResolution, restartPath, formats);
 
+	// --sor, --sor-pressure and --sor-diffusion switch solves to red black
+	// SOR with --omega over relaxation of the pressure.
+	// --direct solves the pressure exactly on the cpu, --compare-direct also
+	// prints how far the jacobi solve is from it.
+	// --compute runs the diffusion and pressure solves as compute dispatches.
+	// --tolerance stops the jacobi and SOR pressure solves once the residual
+	// over the divergence is under it, checked every --check-every
+	// iterations, stops multigrid's v cycles the same way, checked after
+	// each, and leaves out the diffusion sweeps below it.
+	// --no-fuse draws the velocity boundary as a pass of its own again.
+	// --obstacles keeps the fluid out of the bright pixels of a binary pgm
+	// stretched over the window.
+	// --no-vsync and --fps pace the display thread, --steps-per-second and
+	// --max-substeps set the fixed simulation step.
+	// --stroke-spacing sets the grid cells between the impulses along a
+	// mouse stroke.
+	// --profile prints stage timings on exit, --overlay also draws them on
+	// screen, --trace and --csv write every frame's timings to a file.
+	// --checkpoint sets the file F5 saves to, --checkpoint-every also saves
+	// every n steps and --compress-checkpoint compresses the fields.
+	// --export streams the shown frames, or every step of a scenario, to a
+	// file, or to a command when it starts with |, as --export-format y4m or
+	// rgb at --export-fps.
+	// --sparse only draws the passes over the tiles that move, and tiles
+	// slower than --sparse-threshold cells a step count as settled
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--multigrid") == 0) {
+			sim.pressureSolver = PressureSolver::MULTIGRID;
+		}
+		else if (std::strcmp(argv[i], "--sor") == 0) {
+			sim.pressureSolver = PressureSolver::RED_BLACK_SOR;
+			sim.diffusionSolver = DiffusionSolver::RED_BLACK_SOR;
+		}
+		else if (std::strcmp(argv[i], "--sor-pressure") == 0) {
+			sim.pressureSolver = PressureSolver::RED_BLACK_SOR;
+		}
+		else if (std::strcmp(argv[i], "--sor-diffusion") == 0) {
+			sim.diffusionSolver = DiffusionSolver::RED_BLACK_SOR;
+		}
+		else if (std::strcmp(argv[i], "--omega") == 0 && i + 1 < argc) {
+			sim.redBlackSolver.pressureOmega = (float)std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--direct") == 0) {
+			sim.pressureSolver = PressureSolver::DIRECT;
+		}
+		else if (std::strcmp(argv[i], "--compare-direct") == 0) {
+			sim.pressureSolver = PressureSolver::DIRECT;
+			sim.compareDirect = true;
+		}
+		else if (std::strcmp(argv[i], "--compute") == 0) {
+			sim.solverBackend = SolverBackend::COMPUTE;
+		}
+		else if (std::strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+			sim.residualCheck.tolerance = (float)std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--check-every") == 0 && i + 1 < argc) {
+			sim.residualCheck.interval = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--no-fuse") == 0) {
+			sim.fusePasses = false;
+		}
+		else if (std::strcmp(argv[i], "--obstacles") == 0 && i + 1 < argc) {
+			if (!sim.loadObstacles(argv[++i])) {
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--no-vsync") == 0) {
+			sim.vsync = false;
+		}
+		else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+			sim.targetFps = (float)std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--steps-per-second") == 0 && i + 1 < argc) {
+			sim.stepsPerSecond = (float)std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--max-substeps") == 0 && i + 1 < argc) {
+			sim.maxSubsteps = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--stroke-spacing") == 0 && i + 1 < argc) {
+			sim.strokeSpacing = (float)std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--profile") == 0) {
+			sim.profiler.enabled = true;
+		}
+		else if (std::strcmp(argv[i], "--overlay") == 0) {
+			sim.profiler.enabled = true;
+			sim.profiler.overlay = true;
+		}
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+			sim.profiler.enabled = true;
+			sim.profiler.tracePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+			sim.profiler.enabled = true;
+			sim.profiler.csvPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) {
+			sim.checkpointPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc) {
+			sim.checkpointInterval = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--compress-checkpoint") == 0) {
+			sim.checkpointWriter.compress = true;
+		}
+		else if (std::strcmp(argv[i], "--sparse") == 0) {
+			sim.sparseTiles = true;
+		}
+		else if (std::strcmp(argv[i], "--sparse-threshold") == 0 && i + 1 < argc) {
+			sim.sparseTiles = true;
+			sim.activeTiles.velocityThreshold = (float)std::atof(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+			sim.exportPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--export-format") == 0 && i + 1 < argc) {
+			i++;
+			if (std::strcmp(argv[i], "rgb") == 0) {
+				sim.frameExporter.format = ExportFormat::RGB;
+			}
+			else if (std::strcmp(argv[i], "y4m") == 0) {
+				sim.frameExporter.format = ExportFormat::Y4M;
+			}
+			else {
+				std::cout << "Unknown export format " << argv[i] << ", expected y4m or rgb" << std::endl;
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--export-fps") == 0 && i + 1 < argc) {
+			sim.frameExporter.frameRate = std::atoi(argv[++i]);
+			if (sim.frameExporter.frameRate <= 0) {
+				std::cout << "--export-fps needs a positive whole number of frames" << std::endl;
+				return 1;
+			}
+		}
+	}
 
-int main() {
-	Simulation sim = Simulation();
-	sim.run();
+	if (!scenarioPath.empty()) {
+		sim.runScenario(scenario, timingsPath);
+	}
+	else {
+		sim.run();
+	}
 	return 0;
 }
\ No newline at end of file
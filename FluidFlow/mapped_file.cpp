@@ -0,0 +1,98 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile() {}
+
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	HANDLE view = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (view == NULL) {
+		CloseHandle(handle);
+		return false;
+	}
+
+	bytes = (const unsigned char*)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+	if (bytes == NULL) {
+		CloseHandle(view);
+		CloseHandle(handle);
+		return false;
+	}
+
+	file = handle;
+	mapping = view;
+	length = (size_t)fileSize.QuadPart;
+#else
+	int descriptor = ::open(path.c_str(), O_RDONLY);
+	if (descriptor < 0) {
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+		::close(descriptor);
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// the mapping keeps the file alive on its own
+	::close(descriptor);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	// the whole file is about to be read, start reading it ahead
+	madvise(view, (size_t)status.st_size, MADV_WILLNEED);
+
+	bytes = (const unsigned char*)view;
+	length = (size_t)status.st_size;
+#endif
+	return true;
+}
+
+
+void MappedFile::close() {
+	if (bytes == nullptr) {
+		return;
+	}
+
+#ifdef _WIN32
+	UnmapViewOfFile(bytes);
+	CloseHandle((HANDLE)mapping);
+	CloseHandle((HANDLE)file);
+	file = nullptr;
+	mapping = nullptr;
+#else
+	munmap((void*)bytes, length);
+#endif
+	bytes = nullptr;
+	length = 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// read only memory mapping of a whole file. pages are only read from disk
+// when they are touched, so opening a large file costs next to nothing
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// maps path, unmapping any file mapped before. false if it cannot be
+	// opened or is empty
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+
+#ifdef _WIN32
+	void* file = nullptr;			// HANDLEs
+	void* mapping = nullptr;
+#endif
+};
@@ -0,0 +1,296 @@
+#include "multigrid.h"
+
+#include <utility>
+
+
+Multigrid::Multigrid() {}
+
+
+void Multigrid::loadShaders() {
+	divergenceShader = Shader("shaders/fluid/divergence.vert", "shaders/fluid/divergence.frag");
+	smoothShader = Shader("shaders/fluid/mg_smooth.vert", "shaders/fluid/mg_smooth.frag");
+	residualShader = Shader("shaders/fluid/mg_residual.vert", "shaders/fluid/mg_residual.frag");
+	restrictShader = Shader("shaders/fluid/mg_restrict.vert", "shaders/fluid/mg_restrict.frag");
+	prolongShader = Shader("shaders/fluid/mg_prolong.vert", "shaders/fluid/mg_prolong.frag");
+	removeMeanShader = Shader("shaders/fluid/mg_remove_mean.vert", "shaders/fluid/mg_remove_mean.frag");
+}
+
+
+void Multigrid::create(int width, int height, unsigned int quadVAO) {
+	this->quadVAO = quadVAO;
+
+	divergenceShader.use();
+	divergenceShader.setInt("velocityTexture", 0);
+
+	smoothShader.use();
+	smoothShader.setInt("pressureTexture", 0);
+	smoothShader.setInt("rhsTexture", 1);
+	smoothWidth = smoothShader.uniform("width");
+	smoothHeight = smoothShader.uniform("height");
+	smoothCellSize2 = smoothShader.uniform("cellSize2");
+	smoothWeight = smoothShader.uniform("weight");
+
+	residualShader.use();
+	residualShader.setInt("pressureTexture", 0);
+	residualShader.setInt("rhsTexture", 1);
+	residualWidth = residualShader.uniform("width");
+	residualHeight = residualShader.uniform("height");
+	residualCellSize2 = residualShader.uniform("cellSize2");
+
+	restrictShader.use();
+	restrictShader.setInt("fineTexture", 0);
+
+	prolongShader.use();
+	prolongShader.setInt("pressureTexture", 0);
+	prolongShader.setInt("coarseTexture", 1);
+	prolongCorrection = prolongShader.uniform("correction");
+
+	removeMeanShader.use();
+	removeMeanShader.setInt("rhsTexture", 0);
+	removeMeanWidth = removeMeanShader.uniform("width");
+	removeMeanHeight = removeMeanShader.uniform("height");
+
+	glUseProgram(0);
+
+	resize(width, height);
+}
+
+
+size_t Multigrid::bytes(int width, int height) {
+	// the same levels as resize(), every target is R32F
+	size_t bytes = 0;
+	bool finest = true;
+	while (true) {
+		size_t cells = (size_t)width * height;
+		bytes += (finest ? 2 : 4) * cells * PingPongField::texelBytes(GL_R32F);
+		finest = false;
+
+		if (width <= 8 || height <= 8) {
+			break;
+		}
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+	return bytes;
+}
+
+
+void Multigrid::resize(int width, int height) {
+	for (Level& level : levels) {
+		level.solution.destroy();
+		glDeleteFramebuffers(1, &level.rhsFramebuffer);
+		glDeleteTextures(1, &level.rhsTexture);
+		glDeleteFramebuffers(1, &level.residualFramebuffer);
+		glDeleteTextures(1, &level.residualTexture);
+	}
+	levels.clear();
+
+	// halve until the coarsest level is a handful of cells across, where a few
+	// jacobi sweeps reach every cell
+	float cellSize = 1.0f;
+	while (true) {
+		Level level;
+		level.width = width;
+		level.height = height;
+		level.cellSize2 = cellSize * cellSize;
+
+		// the finest solution is the simulation's own pressure field. full
+		// float, the coarse levels hold small corrections
+		if (!levels.empty()) {
+			level.solution.create(width, height, GL_R32F);
+		}
+		PingPongField::createTarget(level.rhsFramebuffer, level.rhsTexture, width, height, GL_R32F);
+		PingPongField::createTarget(level.residualFramebuffer, level.residualTexture, width, height, GL_R32F);
+
+		levels.push_back(level);
+
+		if (width <= 8 || height <= 8) {
+			break;
+		}
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+		cellSize *= 2.0f;
+	}
+}
+
+
+void Multigrid::solve(unsigned int velocityTexture, PingPongField& pressure) {
+	begin(velocityTexture, pressure);
+	for (int i = 0; i < cycles; i++) {
+		cycle();
+	}
+}
+
+
+void Multigrid::begin(unsigned int velocityTexture, PingPongField& pressure) {
+	Level& finest = levels[0];
+	finestSolution = &pressure;
+
+	glBindVertexArray(quadVAO);
+
+	// right hand side of the finest level
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+	divergenceShader.use();
+	draw(0, finest.rhsFramebuffer);
+
+	int coarsest = (int)levels.size() - 1;
+
+	if (fullMultigrid) {
+		// move the right hand side all the way down, solve there and work
+		// back up using each prolongated solution as the next initial guess
+		for (int level = 1; level <= coarsest; level++) {
+			restrictTo(level, levels[level - 1].rhsTexture);
+		}
+
+		clearSolution(coarsest);
+		solveCoarsest();
+
+		for (int level = coarsest - 1; level >= 0; level--) {
+			prolongate(level, false);
+			vCycle(level);
+		}
+	}
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, finest.width, finest.height);
+}
+
+
+void Multigrid::cycle() {
+	glBindVertexArray(quadVAO);
+	vCycle(0);
+
+	glBindVertexArray(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, levels[0].width, levels[0].height);
+}
+
+
+void Multigrid::vCycle(int level) {
+	int coarsest = (int)levels.size() - 1;
+
+	if (level == coarsest) {
+		solveCoarsest();
+		return;
+	}
+
+	smooth(level, preSmoothing);
+
+	computeResidual(level);
+	restrictTo(level + 1, levels[level].residualTexture);
+
+	// the coarse level solves for the error, which starts at zero
+	clearSolution(level + 1);
+	vCycle(level + 1);
+
+	prolongate(level, true);
+	smooth(level, postSmoothing);
+}
+
+
+void Multigrid::smooth(int level, int iterations) {
+	Level& l = levels[level];
+
+	smoothShader.use();
+	smoothShader.setFloat(smoothWidth, l.width);
+	smoothShader.setFloat(smoothHeight, l.height);
+	smoothShader.setFloat(smoothCellSize2, l.cellSize2);
+	smoothShader.setFloat(smoothWeight, weight);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, l.rhsTexture);
+
+	PingPongField& x = solution(level);
+	for (int i = 0; i < iterations; i++) {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, x.readTexture());
+
+		draw(level, x.writeFramebuffer());
+		x.swap();
+	}
+}
+
+
+void Multigrid::computeResidual(int level) {
+	Level& l = levels[level];
+
+	residualShader.use();
+	residualShader.setFloat(residualWidth, l.width);
+	residualShader.setFloat(residualHeight, l.height);
+	residualShader.setFloat(residualCellSize2, l.cellSize2);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, solution(level).readTexture());
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, l.rhsTexture);
+
+	draw(level, l.residualFramebuffer);
+}
+
+
+void Multigrid::restrictTo(int level, unsigned int fineTexture) {
+	restrictShader.use();
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, fineTexture);
+
+	draw(level, levels[level].rhsFramebuffer);
+}
+
+
+void Multigrid::prolongate(int level, bool correction) {
+	PingPongField& fine = solution(level);
+	PingPongField& coarse = solution(level + 1);
+
+	prolongShader.use();
+	prolongShader.setBool(prolongCorrection, correction);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, fine.readTexture());
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, coarse.readTexture());
+
+	draw(level, fine.writeFramebuffer());
+	fine.swap();
+}
+
+
+void Multigrid::solveCoarsest() {
+	int coarsest = (int)levels.size() - 1;
+	Level& l = levels[coarsest];
+
+	removeMeanShader.use();
+	removeMeanShader.setFloat(removeMeanWidth, l.width);
+	removeMeanShader.setFloat(removeMeanHeight, l.height);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, l.rhsTexture);
+
+	// the residual target is free on the coarsest level, use it as the new rhs
+	draw(coarsest, l.residualFramebuffer);
+	std::swap(l.rhsFramebuffer, l.residualFramebuffer);
+	std::swap(l.rhsTexture, l.residualTexture);
+
+	smooth(coarsest, coarseIterations);
+}
+
+
+void Multigrid::clearSolution(int level) {
+	glBindFramebuffer(GL_FRAMEBUFFER, solution(level).readFramebuffer());
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+
+PingPongField& Multigrid::solution(int level) {
+	return level == 0 ? *finestSolution : levels[level].solution;
+}
+
+
+void Multigrid::draw(int level, unsigned int framebuffer) {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, levels[level].width, levels[level].height);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
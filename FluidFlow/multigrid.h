@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "field.h"
+#include "shader.h"
+
+// geometric multigrid solver for the pressure poisson equation
+// laplacian(p) = div(v), built on a pyramid of half resolution textures.
+// every level is solved with damped jacobi smoothing, residuals are moved to
+// the coarser level with one bilinear fetch per texel and corrections are
+// moved back with bilinear interpolation
+class Multigrid {
+public:
+	int preSmoothing = 2;		// smoothing sweeps before going to the coarser level
+	int postSmoothing = 2;		// smoothing sweeps after the coarse correction
+	int coarseIterations = 16;	// sweeps on the coarsest level
+	int cycles = 2;				// v cycles per solve, the most with a residual tolerance
+	float weight = 0.8f;		// jacobi damping
+
+	// solve with a full multigrid pass (coarsest level first) instead of
+	// warm starting the v cycles from the previous pressure
+	bool fullMultigrid = false;
+
+	Multigrid();
+
+	// starts building the programs, before create()
+	void loadShaders();
+
+	// allocates the pyramid below a width x height pressure field and sets up the programs
+	void create(int width, int height, unsigned int quadVAO);
+
+	// reallocates the pyramid for a pressure field of a new size
+	void resize(int width, int height);
+
+	// solves for the pressure of velocityTexture. the pressure field is used as
+	// the finest level, so it is warm started from and left in pressure's read side
+	void solve(unsigned int velocityTexture, PingPongField& pressure);
+
+	// solve() in parts, for a caller that checks the residual in between:
+	// begin() sets up the right hand side, and the full multigrid pass when
+	// it is on, then every cycle() runs one v cycle. solve() is begin()
+	// followed by cycles cycle()s
+	void begin(unsigned int velocityTexture, PingPongField& pressure);
+	void cycle();
+
+	// video memory of the pyramid below a width x height pressure field
+	static size_t bytes(int width, int height);
+
+	// number of levels including the finest
+	int levelCount() const { return (int)levels.size(); }
+
+private:
+	struct Level {
+		int width;
+		int height;
+		float cellSize2;				// squared cell size in finest level cells
+
+		PingPongField solution;			// unused on the finest level
+
+		unsigned int rhsFramebuffer;
+		unsigned int rhsTexture;
+
+		unsigned int residualFramebuffer;
+		unsigned int residualTexture;
+	};
+
+	std::vector<Level> levels;
+	PingPongField* finestSolution = nullptr;
+	unsigned int quadVAO;
+
+	Shader divergenceShader;			// velocity divergence, the finest right hand side
+	Shader smoothShader;				// damped jacobi sweep
+	Shader residualShader;				// rhs - laplacian(p)
+	Shader restrictShader;				// fine to coarse
+	Shader prolongShader;				// coarse to fine
+	Shader removeMeanShader;			// makes the coarsest right hand side solvable
+
+	// per level uniforms, samplers are fixed and set in create()
+	Shader::Uniform smoothWidth, smoothHeight, smoothCellSize2, smoothWeight;
+	Shader::Uniform residualWidth, residualHeight, residualCellSize2;
+	Shader::Uniform prolongCorrection;
+	Shader::Uniform removeMeanWidth, removeMeanHeight;
+
+	void vCycle(int level);
+	void smooth(int level, int iterations);
+	void computeResidual(int level);
+	void restrictTo(int level, unsigned int fineTexture);	// writes the rhs of level
+	void prolongate(int level, bool correction);			// from level + 1 into level
+	void clearSolution(int level);
+	void solveCoarsest();
+
+	PingPongField& solution(int level);
+	void draw(int level, unsigned int framebuffer);
+};
@@ -0,0 +1,160 @@
+#include "pass_graph.h"
+
+
+void PassState::framebuffer(unsigned int framebuffer) {
+	if (boundFramebuffer != framebuffer) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		boundFramebuffer = framebuffer;
+	}
+}
+
+
+void PassState::texture(int unit, unsigned int texture) {
+	if (boundTextures[unit] == texture) {
+		return;
+	}
+	if (activeUnit != (unsigned int)unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	boundTextures[unit] = texture;
+}
+
+
+void PassState::program(const Shader& shader) {
+	if (boundProgram != shader.ID) {
+		shader.use();
+		boundProgram = shader.ID;
+	}
+}
+
+
+void PassState::vertexArray(unsigned int vertexArray) {
+	if (boundVertexArray != vertexArray) {
+		glBindVertexArray(vertexArray);
+		boundVertexArray = vertexArray;
+	}
+}
+
+
+void PassState::viewport(int width, int height) {
+	if (viewportWidth != width || viewportHeight != height) {
+		glViewport(0, 0, width, height);
+		viewportWidth = width;
+		viewportHeight = height;
+	}
+}
+
+
+void PassState::invalidate() {
+	boundFramebuffer = UNKNOWN;
+	for (int i = 0; i < UNITS; i++) {
+		boundTextures[i] = UNKNOWN;
+	}
+	activeUnit = UNKNOWN;
+	boundProgram = UNKNOWN;
+	boundVertexArray = UNKNOWN;
+	viewportWidth = -1;
+	viewportHeight = -1;
+}
+
+
+PassGraph::PassGraph() {}
+
+
+void PassGraph::clear(unsigned int kept) {
+	this->kept = kept;
+	declared.clear();
+	fusions.clear();
+	built.clear();
+}
+
+
+void PassGraph::add(const Pass& pass) {
+	declared.push_back(pass);
+}
+
+
+void PassGraph::fuse(const std::string& first, const std::string& second, const Pass& fused) {
+	fusions.push_back({ first, second, fused });
+}
+
+
+void PassGraph::build() {
+	// backwards from the end of the step, a pass stays if something after it
+	// reads what it writes. a pass that also reads a field it writes only
+	// changes it, so the field before it is still needed
+	std::vector<bool> live(declared.size(), false);
+	unsigned int needed = kept;
+	for (size_t i = declared.size(); i-- > 0;) {
+		const Pass& pass = declared[i];
+		if ((pass.writes & needed) == 0) {
+			continue;
+		}
+		live[i] = true;
+		needed = (needed & ~pass.writes) | pass.reads;
+	}
+
+	built.clear();
+	for (size_t i = 0; i < declared.size(); i++) {
+		if (live[i]) {
+			built.push_back(declared[i]);
+		}
+	}
+
+	for (const Fusion& fusion : fusions) {
+		for (size_t i = 0; i + 1 < built.size(); i++) {
+			if (built[i].name != fusion.first || built[i + 1].name != fusion.second) {
+				continue;
+			}
+
+			// what the second reads of the first's writes stays inside the pass
+			Pass fused = fusion.fused;
+			fused.reads = built[i].reads | (built[i + 1].reads & ~built[i].writes);
+			fused.writes = built[i].writes | built[i + 1].writes;
+			built[i] = fused;
+			built.erase(built.begin() + i + 1);
+		}
+	}
+}
+
+
+void PassGraph::execute(Profiler& profiler, PassState& state) const {
+	// whatever ran since the last step bound its own things
+	state.invalidate();
+
+	for (const Pass& pass : built) {
+		profiler.begin(pass.name.c_str());
+		run(pass, state);
+		profiler.end();
+	}
+}
+
+
+void PassGraph::executeGroup(int group, PassState& state) const {
+	state.invalidate();
+
+	for (const Pass& pass : built) {
+		if (pass.group == group) {
+			run(pass, state);
+		}
+	}
+}
+
+
+std::string PassGraph::describe() const {
+	std::string names;
+	for (const Pass& pass : built) {
+		names += (names.empty() ? "" : ", ") + pass.name;
+	}
+	return names;
+}
+
+
+void PassGraph::run(const Pass& pass, PassState& state) {
+	pass.run();
+	if (pass.ownState) {
+		state.invalidate();
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "profiler.h"
+#include "shader.h"
+
+// the gl bindings the fragment passes last made, so that a pass only binds
+// what differs from the pass before. code that binds on its own, like the
+// solvers, leaves it out of date and has to be followed by invalidate()
+class PassState {
+public:
+	static const int UNITS = 4;			// texture units tracked, 0 to UNITS - 1
+
+	void framebuffer(unsigned int framebuffer);
+	void texture(int unit, unsigned int texture);
+	void program(const Shader& shader);
+	void vertexArray(unsigned int vertexArray);
+	void viewport(int width, int height);
+
+	// makes the next call of every function above bind again
+	void invalidate();
+
+private:
+	static const unsigned int UNKNOWN = 0xFFFFFFFF;
+
+	unsigned int boundFramebuffer = UNKNOWN;
+	unsigned int boundTextures[UNITS] = { UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN };
+	unsigned int activeUnit = UNKNOWN;
+	unsigned int boundProgram = UNKNOWN;
+	unsigned int boundVertexArray = UNKNOWN;
+	int viewportWidth = -1;
+	int viewportHeight = -1;
+};
+
+// the passes of a step in order, each declaring the fields it reads and
+// writes as a mask of bits the caller picks. build() drops the passes whose
+// writes are overwritten or never read before the step ends, then replaces
+// every pair of adjacent passes given to fuse() with their fused pass.
+// execute() runs what is left, timing each pass with the profiler
+class PassGraph {
+public:
+	struct Pass {
+		std::string name;				// profiler stage
+		int group = -1;					// what executeGroup() picks it by, -1 for none
+		unsigned int reads = 0;
+		unsigned int writes = 0;
+		bool ownState = false;			// binds without PassState, so it is invalidated after
+		std::function<void()> run;
+	};
+
+	PassGraph();
+
+	// starts over. kept are the fields that live on after the step
+	void clear(unsigned int kept);
+
+	void add(const Pass& pass);
+
+	// when the pass named first is directly followed by second, both run as
+	// fused. its reads and writes are worked out from theirs
+	void fuse(const std::string& first, const std::string& second, const Pass& fused);
+
+	// culls and fuses, after the last add() and fuse()
+	void build();
+
+	// runs every pass in order
+	void execute(Profiler& profiler, PassState& state) const;
+
+	// runs the passes of group only, in order
+	void executeGroup(int group, PassState& state) const;
+
+	// the passes build() left, in order
+	const std::vector<Pass>& passes() const { return built; }
+
+	// names of the passes build() left, for messages
+	std::string describe() const;
+
+private:
+	struct Fusion {
+		std::string first;
+		std::string second;
+		Pass fused;
+	};
+
+	unsigned int kept = 0;
+	std::vector<Pass> declared;
+	std::vector<Fusion> fusions;
+	std::vector<Pass> built;
+
+	static void run(const Pass& pass, PassState& state);
+};
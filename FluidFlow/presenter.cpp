@@ -0,0 +1,204 @@
+#include "presenter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+
+Presenter::Presenter() {}
+
+
+Presenter::~Presenter() {
+	if (display.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		published.notify_one();
+		display.join();
+	}
+}
+
+
+void Presenter::create() {
+	for (Slot& slot : slots) {
+		glGenTextures(1, &slot.texture);
+		glBindTexture(GL_TEXTURE_2D, slot.texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glGenFramebuffers(1, &slot.framebuffer);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+
+void Presenter::start(GLFWwindow* window, int swapInterval, float targetFps) {
+	this->window = window;
+	this->swapInterval = swapInterval;
+	this->targetFps = targetFps;
+
+	stopping = false;
+	newest = -1;
+	showing = -1;
+	display = std::thread(&Presenter::show, this);
+}
+
+
+void Presenter::beginFrame(int width, int height) {
+	// neither the newest frame nor the one on screen, there is always a third
+	GLsync shown = 0;
+	GLsync drawn = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (int i = 0; i < RING; i++) {
+			if (i != newest && i != showing) {
+				drawing = i;
+				break;
+			}
+		}
+		std::swap(shown, slots[drawing].shown);
+		std::swap(drawn, slots[drawing].drawn);
+	}
+	Slot& slot = slots[drawing];
+
+	// the display's blit out of it has to be done before anything draws into it
+	if (shown != 0) {
+		glWaitSync(shown, 0, GL_TIMEOUT_IGNORED);
+		glDeleteSync(shown);
+	}
+	if (drawn != 0) {
+		glDeleteSync(drawn);
+	}
+
+	if (slot.width != width || slot.height != height) {
+		glBindTexture(GL_TEXTURE_2D, slot.texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, slot.framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, slot.texture, 0);
+		slot.width = width;
+		slot.height = height;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, slot.framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+
+void Presenter::endFrame(double inputTime) {
+	// flushed so that the display's context sees the fence come by
+	GLsync drawn = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (newest >= 0) {
+			framesReplaced++;
+		}
+		slots[drawing].drawn = drawn;
+		slots[drawing].inputTime = inputTime;
+		newest = drawing;
+	}
+	drawing = -1;
+	published.notify_one();
+}
+
+
+void Presenter::stop() {
+	if (!display.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	published.notify_one();
+	display.join();
+}
+
+
+void Presenter::report() const {
+	if (latencies.empty()) {
+		return;
+	}
+
+	std::vector<float> sorted = latencies;
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (float latency : sorted) {
+		sum += latency;
+	}
+	std::cout << "Showed " << framesShown << " frames, " << framesReplaced << " replaced unseen. input to swap ms: mean "
+		<< sum / sorted.size() << ", median " << sorted[sorted.size() / 2] << ", 95th "
+		<< sorted[(size_t)(sorted.size() * 0.95)] << ", max " << sorted.back() << std::endl;
+}
+
+
+void Presenter::show() {
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(swapInterval);
+
+	// framebuffers are not shared between contexts, the textures are
+	unsigned int readFramebuffer;
+	glGenFramebuffers(1, &readFramebuffer);
+
+	auto framePeriod = std::chrono::duration<double>(targetFps > 0.0f ? 1.0 / targetFps : 0.0);
+	auto nextFrame = std::chrono::steady_clock::now();
+
+	while (true) {
+		Slot slot;
+		{
+			// the last frame is shown before stopping
+			std::unique_lock<std::mutex> lock(mutex);
+			published.wait(lock, [this]() { return newest >= 0 || stopping; });
+			if (newest < 0) {
+				break;
+			}
+			showing = newest;
+			newest = -1;
+			slot = slots[showing];
+		}
+
+		glWaitSync(slot.drawn, 0, GL_TIMEOUT_IGNORED);
+
+		// the texture may have been reallocated since it was last attached
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, slot.texture, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glBlitFramebuffer(0, 0, slot.width, slot.height, 0, 0, slot.width, slot.height,
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		GLsync shown = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			slots[showing].shown = shown;
+		}
+
+		glfwSwapBuffers(window);
+		latencies.push_back((float)((glfwGetTime() - slot.inputTime) * 1000.0));
+		framesShown++;
+
+		// sleep off the rest of the frame when a target rate is set. a late
+		// frame restarts the schedule rather than rushing to catch up
+		if (targetFps > 0.0f) {
+			nextFrame += std::chrono::duration_cast<std::chrono::steady_clock::duration>(framePeriod);
+			auto now = std::chrono::steady_clock::now();
+			if (nextFrame > now) {
+				std::this_thread::sleep_until(nextFrame);
+			}
+			else {
+				nextFrame = now;
+			}
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		showing = -1;
+	}
+	glDeleteFramebuffers(1, &readFramebuffer);
+	glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// shows the frames in the window from a display thread of its own, so that
+// the swap interval and the compositor never hold up the simulation. the
+// simulation draws on a context of its own that shares its objects with the
+// window's, and the display thread has the window's context.
+//
+// the simulation draws each frame to show into one of RING textures between
+// beginFrame() and endFrame(), which publishes it with a fence. the display
+// thread takes the newest published frame, makes its context wait for the
+// fence on the gpu, blits it to the window and swaps. a frame published
+// before the display took the one before it replaces that one unseen. a
+// texture is only drawn into again once the fence the display left after
+// reading it has passed, so neither side waits for the other on the cpu,
+// apart from the lock around which texture is where
+class Presenter {
+public:
+	static const int RING = 3;
+
+	Presenter();
+	~Presenter();
+
+	Presenter(const Presenter&) = delete;
+	Presenter& operator=(const Presenter&) = delete;
+
+	// creates the textures, on the simulation's context
+	void create();
+
+	// starts the display thread on window's context, which must not be
+	// current anywhere. swapInterval goes to glfwSwapInterval() and a
+	// targetFps above 0 also sleeps off the rest of every frame
+	void start(GLFWwindow* window, int swapInterval, float targetFps);
+
+	// binds the framebuffer of a free texture of width x height and sets the
+	// viewport, for the simulation to draw the next frame into
+	void beginFrame(int width, int height);
+
+	// publishes the frame drawn since beginFrame(). inputTime is when its
+	// input was read, on glfwGetTime()'s clock
+	void endFrame(double inputTime);
+
+	// shows the last published frame and stops the display thread
+	void stop();
+
+	// prints the frames shown and the latency from reading the input to the
+	// swap that showed it
+	void report() const;
+
+	bool running() const { return display.joinable(); }
+
+private:
+	struct Slot {
+		unsigned int texture = 0;
+		unsigned int framebuffer = 0;	// on the simulation's context
+		int width = 0;
+		int height = 0;
+		GLsync drawn = 0;				// the simulation finished drawing it
+		GLsync shown = 0;				// the display finished reading it
+		double inputTime = 0.0;
+	};
+
+	Slot slots[RING];
+	int drawing = -1;					// the simulation's, between beginFrame() and endFrame()
+
+	GLFWwindow* window = NULL;
+	int swapInterval = 1;
+	float targetFps = 0.0f;
+
+	// which slot is where, and the display's statistics
+	std::thread display;
+	std::mutex mutex;
+	std::condition_variable published;
+	int newest = -1;					// published and not taken yet
+	int showing = -1;					// the display's
+	bool stopping = false;
+
+	int framesShown = 0;
+	int framesReplaced = 0;				// published and never shown
+	std::vector<float> latencies;		// milliseconds, one per frame shown
+
+	void show();						// runs on the display thread
+};
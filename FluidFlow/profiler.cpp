@@ -0,0 +1,334 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+Profiler::Profiler() {
+	start = Clock::now();
+
+	// stage 0 is the whole frame, its gpu time is the sum of the outermost stages
+	stages.push_back(Stage());
+	stages[0].name = "frame";
+	stages[0].gpuTimed = true;
+}
+
+
+void Profiler::create() {
+	for (int i = 0; i < QUERY_FRAMES; i++) {
+		frames[i].queries.resize(16);
+		glGenQueries((int)frames[i].queries.size(), frames[i].queries.data());
+	}
+}
+
+
+void Profiler::beginFrame() {
+	if (!enabled) {
+		return;
+	}
+
+	current = (int)(frameNumber % QUERY_FRAMES);
+	Frame& frame = frames[current];
+
+	// last chance for the results of the frame that used these queries before
+	if (frame.pending && !resolve(frame)) {
+		droppedFrames++;
+		frame.pending = false;
+	}
+
+	frame.samples.clear();
+	frame.usedQueries = 0;
+	frame.number = frameNumber;
+	frame.cpuBegin = now();
+	open.clear();
+}
+
+
+void Profiler::endFrame() {
+	if (!enabled) {
+		return;
+	}
+
+	Frame& frame = frames[current];
+	frame.cpuEnd = now();
+	frame.pending = true;
+	frameNumber++;
+
+	// the previous frame has had a whole frame to finish on the gpu
+	Frame& previous = frames[(current + QUERY_FRAMES - 1) % QUERY_FRAMES];
+	if (previous.pending) {
+		resolve(previous);
+	}
+}
+
+
+void Profiler::begin(const char* name) {
+	if (!enabled) {
+		return;
+	}
+
+	Frame& frame = frames[current];
+
+	Sample sample;
+	sample.stage = stageIndex(name);
+	sample.depth = (int)open.size();
+	sample.query = -1;
+	sample.cpuBegin = now();
+	sample.cpuEnd = sample.cpuBegin;
+
+	if (open.empty()) {
+		if (frame.usedQueries == (int)frame.queries.size()) {
+			unsigned int query;
+			glGenQueries(1, &query);
+			frame.queries.push_back(query);
+		}
+		sample.query = frame.usedQueries++;
+		glBeginQuery(GL_TIME_ELAPSED, frame.queries[sample.query]);
+	}
+
+	open.push_back((int)frame.samples.size());
+	frame.samples.push_back(sample);
+}
+
+
+void Profiler::end() {
+	if (!enabled || open.empty()) {
+		return;
+	}
+
+	Frame& frame = frames[current];
+	Sample& sample = frame.samples[open.back()];
+	open.pop_back();
+
+	if (sample.query >= 0) {
+		glEndQuery(GL_TIME_ELAPSED);
+	}
+	sample.cpuEnd = now();
+}
+
+
+bool Profiler::resolve(Frame& frame) {
+	// queries finish in submission order, so the last one being available
+	// means all of them are
+	if (frame.usedQueries > 0) {
+		int available = 0;
+		glGetQueryObjectiv(frame.queries[frame.usedQueries - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available) {
+			return false;
+		}
+	}
+
+	bool keepEvents = !tracePath.empty() || !csvPath.empty();
+	double frameGpu = 0.0;
+
+	for (const Sample& sample : frame.samples) {
+		double gpu = -1.0;
+		if (sample.query >= 0) {
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(frame.queries[sample.query], GL_QUERY_RESULT, &nanoseconds);
+			gpu = nanoseconds / 1.0e6;
+			frameGpu += gpu;
+		}
+
+		Stage& stage = stages[sample.stage];
+		stage.gpu[stage.count % HISTORY] = gpu < 0.0 ? 0.0f : (float)gpu;
+		stage.cpu[stage.count % HISTORY] = (float)((sample.cpuEnd - sample.cpuBegin) / 1000.0);
+		stage.gpuTimed = stage.gpuTimed || gpu >= 0.0;
+		stage.count++;
+
+		if (keepEvents) {
+			events.push_back({ frame.number, sample.stage, sample.depth + 1, sample.cpuBegin, sample.cpuEnd, gpu });
+		}
+	}
+
+	Stage& total = stages[0];
+	total.gpu[total.count % HISTORY] = (float)frameGpu;
+	total.cpu[total.count % HISTORY] = (float)((frame.cpuEnd - frame.cpuBegin) / 1000.0);
+	total.count++;
+
+	if (keepEvents) {
+		events.push_back({ frame.number, 0, 0, frame.cpuBegin, frame.cpuEnd, frameGpu });
+	}
+
+	frame.pending = false;
+	return true;
+}
+
+
+void Profiler::drawOverlay(int width, int height) {
+	if (!enabled || !overlay || stages[0].count == 0) {
+		return;
+	}
+
+	// one row per stage from the top left corner, the frame first
+	const int rowHeight = 10;
+	const int margin = 8;
+	int barWidth = width / 3;
+
+	float slowest = 0.0f;
+	for (int i = 0; i < std::min(stages[0].count, HISTORY); i++) {
+		slowest = std::max(slowest, stages[0].gpu[i]);
+	}
+	if (slowest <= 0.0f) {
+		return;
+	}
+
+	const float colors[][3] = {
+		{ 1.0f, 1.0f, 1.0f }, { 0.9f, 0.3f, 0.3f }, { 0.3f, 0.8f, 0.3f }, { 0.3f, 0.5f, 1.0f },
+		{ 0.9f, 0.8f, 0.2f }, { 0.8f, 0.3f, 0.9f }, { 0.2f, 0.8f, 0.8f }, { 1.0f, 0.6f, 0.2f }
+	};
+	const int colorCount = sizeof(colors) / sizeof(colors[0]);
+
+	glEnable(GL_SCISSOR_TEST);
+
+	// dark backing so the bars stay readable over any picture
+	int rows = (int)stages.size();
+	glScissor(margin - 2, height - margin - rows * rowHeight - 2, barWidth + 4, rows * rowHeight + 4);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	for (int i = 0; i < rows; i++) {
+		if (!stages[i].gpuTimed) {
+			continue;
+		}
+		int length = (int)(barWidth * stages[i].meanGpu() / slowest);
+		if (length <= 0) {
+			continue;
+		}
+		const float* color = colors[i % colorCount];
+		glScissor(margin, height - margin - (i + 1) * rowHeight + 1, length, rowHeight - 2);
+		glClearColor(color[0], color[1], color[2], 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+}
+
+
+std::string Profiler::summary() const {
+	std::ostringstream line;
+	line.precision(2);
+	line << std::fixed;
+
+	for (size_t i = 0; i < stages.size(); i++) {
+		if (i > 0) {
+			line << " | ";
+		}
+		line << stages[i].name << " " << stages[i].meanGpu() << "/" << stages[i].meanCpu();
+	}
+	line << " ms gpu/cpu";
+	return line.str();
+}
+
+
+void Profiler::writeReports() const {
+	if (!enabled) {
+		return;
+	}
+
+	std::cout << "Stage timings, mean of the last " << std::min(stages[0].count, HISTORY)
+		<< " frames (" << droppedFrames << " frames dropped waiting for queries)" << std::endl;
+	for (const Stage& stage : stages) {
+		char row[128];
+		if (stage.gpuTimed) {
+			std::snprintf(row, sizeof(row), "  %-24s gpu %8.3f ms  cpu %8.3f ms", stage.name.c_str(), stage.meanGpu(), stage.meanCpu());
+		}
+		else {
+			std::snprintf(row, sizeof(row), "  %-24s gpu        - ms  cpu %8.3f ms", stage.name.c_str(), stage.meanCpu());
+		}
+		std::cout << row << std::endl;
+	}
+
+	if (!tracePath.empty()) {
+		std::ofstream trace(tracePath);
+		if (!trace) {
+			std::cout << "Failed to write trace " << tracePath << std::endl;
+		}
+		else {
+			trace.precision(3);
+			trace << std::fixed;
+			trace << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"cpu\"}},\n";
+			trace << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"gpu\"}}";
+
+			// time elapsed queries have no start time. the gpu runs stages in
+			// submission order, so each one is placed at its submission or
+			// at the end of the previous one, whichever is later
+			double gpuEnd = 0.0;
+			for (const Event& event : events) {
+				trace << ",\n{\"name\":\"" << stages[event.stage].name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1"
+					<< ",\"ts\":" << event.cpuBegin << ",\"dur\":" << event.cpuEnd - event.cpuBegin
+					<< ",\"args\":{\"frame\":" << event.frame << "}}";
+
+				if (event.gpu >= 0.0 && event.depth == 1) {
+					double begin = std::max(event.cpuBegin, gpuEnd);
+					gpuEnd = begin + event.gpu * 1000.0;
+					trace << ",\n{\"name\":\"" << stages[event.stage].name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2"
+						<< ",\"ts\":" << begin << ",\"dur\":" << event.gpu * 1000.0
+						<< ",\"args\":{\"frame\":" << event.frame << "}}";
+				}
+			}
+			trace << "\n]}\n";
+			std::cout << "Wrote trace " << tracePath << std::endl;
+		}
+	}
+
+	if (!csvPath.empty()) {
+		std::ofstream csv(csvPath);
+		if (!csv) {
+			std::cout << "Failed to write csv " << csvPath << std::endl;
+		}
+		else {
+			csv << "frame,stage,depth,cpu_ms,gpu_ms\n";
+			for (const Event& event : events) {
+				csv << event.frame << "," << stages[event.stage].name << "," << event.depth << ","
+					<< (event.cpuEnd - event.cpuBegin) / 1000.0 << ",";
+				if (event.gpu >= 0.0) {
+					csv << event.gpu;
+				}
+				csv << "\n";
+			}
+			std::cout << "Wrote csv " << csvPath << std::endl;
+		}
+	}
+}
+
+
+int Profiler::stageIndex(const char* name) {
+	for (size_t i = 0; i < stages.size(); i++) {
+		if (stages[i].name == name) {
+			return (int)i;
+		}
+	}
+	stages.push_back(Stage());
+	stages.back().name = name;
+	return (int)stages.size() - 1;
+}
+
+
+double Profiler::now() const {
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+
+float Profiler::Stage::meanGpu() const {
+	int n = std::min(count, HISTORY);
+	float sum = 0.0f;
+	for (int i = 0; i < n; i++) {
+		sum += gpu[i];
+	}
+	return n > 0 ? sum / n : 0.0f;
+}
+
+
+float Profiler::Stage::meanCpu() const {
+	int n = std::min(count, HISTORY);
+	float sum = 0.0f;
+	for (int i = 0; i < n; i++) {
+		sum += cpu[i];
+	}
+	return n > 0 ? sum / n : 0.0f;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// per stage timing of the simulation loop. every stage gets a cpu scope and a
+// GL_TIME_ELAPSED query. queries are double buffered: results of a frame are
+// read while the next frame is recorded, and only once the driver reports them
+// available, so reading never stalls the pipeline. a frame whose results are
+// still pending when its queries are needed again is dropped from the stats
+class Profiler {
+public:
+	bool enabled = false;
+	bool overlay = false;			// draw the rolling stats on top of the picture
+
+	// written by writeReports() when not empty
+	std::string tracePath;			// chrome://tracing / perfetto json
+	std::string csvPath;			// one row per stage per frame
+
+	// frames averaged into the rolling stats
+	static const int HISTORY = 120;
+
+	Profiler();
+
+	// creates the query objects, needs a current gl context
+	void create();
+
+	// brackets one iteration of the simulation loop
+	void beginFrame();
+	void endFrame();
+
+	// brackets one stage. stages may nest, but only the outermost one gets a
+	// gpu query since time elapsed queries can not be nested
+	void begin(const char* name);
+	void end();
+
+	// bars for the mean gpu time of every stage, scaled to the slowest frame
+	// in the history. draws with scissored clears so no state but the
+	// scissor box and clear color is touched
+	void drawOverlay(int width, int height);
+
+	// one line with the mean gpu and cpu time of every stage, for the window title
+	std::string summary() const;
+
+	// prints the rolling stats and writes the trace and csv files
+	void writeReports() const;
+
+private:
+	static const int QUERY_FRAMES = 2;
+
+	typedef std::chrono::steady_clock Clock;
+
+	// rolling window of one stage
+	struct Stage {
+		std::string name;
+		float gpu[HISTORY] = {};	// milliseconds
+		float cpu[HISTORY] = {};
+		int count = 0;				// samples written, the newest is at (count - 1) % HISTORY
+		bool gpuTimed = false;		// false if the stage only ever ran nested
+
+		float meanGpu() const;
+		float meanCpu() const;
+	};
+
+	// one recorded scope
+	struct Sample {
+		int stage;
+		int depth;
+		int query;					// index into the frame's queries, -1 for cpu only
+		double cpuBegin;			// microseconds since the profiler was created
+		double cpuEnd;
+	};
+
+	// queries and scopes of one frame in flight
+	struct Frame {
+		std::vector<unsigned int> queries;
+		std::vector<Sample> samples;
+		int usedQueries = 0;
+		long long number = -1;
+		double cpuBegin = 0.0;
+		double cpuEnd = 0.0;
+		bool pending = false;
+	};
+
+	// a resolved sample kept for the trace and csv
+	struct Event {
+		long long frame;
+		int stage;
+		int depth;
+		double cpuBegin;
+		double cpuEnd;
+		double gpu;					// milliseconds, negative for cpu only scopes
+	};
+
+	Clock::time_point start;
+	std::vector<Stage> stages;
+	std::vector<Event> events;		// only kept when a report file is set
+
+	Frame frames[QUERY_FRAMES];
+	int current = 0;
+	long long frameNumber = 0;
+	long long droppedFrames = 0;
+
+	std::vector<int> open;			// indices into the current frame's samples
+
+	int stageIndex(const char* name);
+	double now() const;
+
+	// reads the results of frame if all of them are available
+	bool resolve(Frame& frame);
+};
@@ -0,0 +1,249 @@
+#include "program_cache.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+std::string ProgramCache::directory = "shader_cache";
+int ProgramCache::loaded = 0;
+int ProgramCache::compiled = 0;
+
+// a program that was started but not finished yet, or is done
+struct CacheEntry {
+	uint64_t key = 0;
+	std::string name;							// the stage paths, for messages
+	std::vector<std::pair<unsigned int, std::string>> shaders;	// until finished, for their logs
+	bool fromSource = false;
+	bool finished = false;
+	bool linked = false;
+};
+
+// start of a binary file, the driver's blob follows
+struct BinaryHeader {
+	char magic[4];
+	uint32_t format;
+	uint64_t key;
+};
+
+static const char BINARY_MAGIC[4] = { 'F', 'F', 'P', 'B' };
+
+static std::unordered_map<uint64_t, unsigned int> programsByKey;
+static std::unordered_map<unsigned int, CacheEntry> entries;
+static uint64_t driverKey = 0;
+static bool binaries = false;
+
+typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+
+// 64 bit FNV-1a
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+
+static uint64_t hashString(uint64_t hash, const char* text) {
+	return text != NULL ? hashBytes(hash, text, std::strlen(text) + 1) : hash;
+}
+
+
+static std::string binaryPath(uint64_t key) {
+	char name[32];
+	std::snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)key);
+	return ProgramCache::directory + name;
+}
+
+
+void ProgramCache::open() {
+	// the most threads the driver wants to use for compiles
+	MaxShaderCompilerThreadsProc maxThreads = NULL;
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+		maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+		maxThreads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	}
+	if (maxThreads != NULL) {
+		maxThreads(0xFFFFFFFF);
+	}
+
+	// a new driver may not load the old binaries, or worse load them wrong
+	driverKey = 14695981039346656037ull;
+	driverKey = hashString(driverKey, (const char*)glGetString(GL_VENDOR));
+	driverKey = hashString(driverKey, (const char*)glGetString(GL_RENDERER));
+	driverKey = hashString(driverKey, (const char*)glGetString(GL_VERSION));
+	driverKey = hashString(driverKey, (const char*)glGetString(GL_SHADING_LANGUAGE_VERSION));
+
+	int formats = 0;
+	if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) {
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	}
+	binaries = !directory.empty() && formats > 0;
+
+	if (binaries) {
+#ifdef _WIN32
+		_mkdir(directory.c_str());
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+	}
+}
+
+
+unsigned int ProgramCache::program(const std::vector<Stage>& stages) {
+	uint64_t key = driverKey;
+	std::string name;
+	for (const Stage& stage : stages) {
+		key = hashBytes(key, &stage.type, sizeof(stage.type));
+		key = hashString(key, stage.source.c_str());
+		name += (name.empty() ? "" : ", ") + stage.path;
+	}
+
+	auto existing = programsByKey.find(key);
+	if (existing != programsByKey.end()) {
+		return existing->second;
+	}
+
+	if (binaries) {
+		FILE* file = std::fopen(binaryPath(key).c_str(), "rb");
+		if (file != NULL) {
+			BinaryHeader header;
+			std::vector<unsigned char> binary;
+			bool read = std::fread(&header, sizeof(header), 1, file) == 1 &&
+				std::memcmp(header.magic, BINARY_MAGIC, sizeof(header.magic)) == 0 && header.key == key;
+			if (read) {
+				std::fseek(file, 0, SEEK_END);
+				long size = std::ftell(file) - (long)sizeof(header);
+				std::fseek(file, (long)sizeof(header), SEEK_SET);
+				binary.resize(size > 0 ? (size_t)size : 0);
+				read = size > 0 && std::fread(binary.data(), 1, binary.size(), file) == binary.size();
+			}
+			std::fclose(file);
+
+			// a binary the driver turns down is compiled again and replaced
+			if (read) {
+				unsigned int program = glCreateProgram();
+				glProgramBinary(program, header.format, binary.data(), (GLsizei)binary.size());
+
+				int success = 0;
+				glGetProgramiv(program, GL_LINK_STATUS, &success);
+				if (success) {
+					CacheEntry& entry = entries[program];
+					entry.key = key;
+					entry.name = name;
+					entry.finished = true;
+					entry.linked = true;
+					programsByKey[key] = program;
+					loaded++;
+					return program;
+				}
+				glDeleteProgram(program);
+			}
+		}
+	}
+
+	// started here, finish() collects the results
+	unsigned int program = glCreateProgram();
+	CacheEntry& entry = entries[program];
+	entry.key = key;
+	entry.name = name;
+	entry.fromSource = true;
+
+	for (const Stage& stage : stages) {
+		const char* source = stage.source.c_str();
+		unsigned int shader = glCreateShader(stage.type);
+		glShaderSource(shader, 1, &source, NULL);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		entry.shaders.push_back(std::make_pair(shader, stage.path));
+	}
+	if (binaries) {
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(program);
+
+	programsByKey[key] = program;
+	compiled++;
+	return program;
+}
+
+
+bool ProgramCache::finish(unsigned int program) {
+	auto found = entries.find(program);
+	if (found == entries.end()) {
+		return program != 0;
+	}
+	CacheEntry& entry = found->second;
+	if (entry.finished) {
+		return entry.linked;
+	}
+
+	// the first query of the status is where the wait for the driver happens
+	int success = 0;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	entry.linked = success != 0;
+
+	char infoLog[512];
+	for (const auto& shader : entry.shaders) {
+		if (!entry.linked) {
+			glGetShaderiv(shader.first, GL_COMPILE_STATUS, &success);
+			if (!success) {
+				glGetShaderInfoLog(shader.first, sizeof(infoLog), NULL, infoLog);
+				std::cout << "ERROR COMPILING SHADER " << shader.second << ": " << infoLog << std::endl;
+			}
+		}
+		glDetachShader(program, shader.first);
+		glDeleteShader(shader.first);
+	}
+	entry.shaders.clear();
+	entry.finished = true;
+
+	if (!entry.linked) {
+		glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+		std::cout << "ERROR LINKING PROGRAM " << entry.name << ": " << infoLog << std::endl;
+		return false;
+	}
+
+	if (binaries && entry.fromSource) {
+		int length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+		BinaryHeader header;
+		std::memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+		header.key = entry.key;
+		std::vector<unsigned char> binary(length > 0 ? length : 0);
+		GLenum format = 0;
+		GLsizei written = 0;
+		if (length > 0) {
+			glGetProgramBinary(program, length, &written, &format, binary.data());
+		}
+		header.format = format;
+
+		// another instance may be reading, so the file appears all at once
+		std::string path = binaryPath(entry.key);
+		std::string temporaryPath = path + ".tmp";
+		FILE* file = written > 0 ? std::fopen(temporaryPath.c_str(), "wb") : NULL;
+		if (file != NULL) {
+			bool saved = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+				std::fwrite(binary.data(), 1, written, file) == (size_t)written;
+			saved = std::fclose(file) == 0 && saved;
+			std::remove(path.c_str());
+			if (!saved || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+				std::remove(temporaryPath.c_str());
+			}
+		}
+	}
+	return true;
+}
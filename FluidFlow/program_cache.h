@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+
+// where linked programs come from. a program is looked up by a hash of its
+// sources and the driver strings, first among the programs already made in
+// this run, then as a binary in directory, and only then compiled. compiles
+// are started and not waited on, with GL_KHR_parallel_shader_compile the
+// driver runs them on its own threads, so all programs build at the same time
+// while the caller goes on. finish() waits for one the first time it is used
+// and saves the binary of freshly linked programs for the next start
+class ProgramCache {
+public:
+	// one shader stage of a program
+	struct Stage {
+		GLenum type;
+		std::string path;				// for messages
+		std::string source;
+	};
+
+	// binaries are kept here, relative to the working directory and ignored
+	// by git. empty turns the disk cache off
+	static std::string directory;
+
+	// needs a current context. turns on parallel compiles and decides if
+	// binaries can be used with this driver
+	static void open();
+
+	// a program of stages that may still be compiling. the same sources give
+	// the same program
+	static unsigned int program(const std::vector<Stage>& stages);
+
+	// waits for program to link and reports errors, once per program.
+	// false if it did not link
+	static bool finish(unsigned int program);
+
+	// programs loaded from binaries and compiled from source so far
+	static int loaded;
+	static int compiled;
+};
@@ -0,0 +1,133 @@
+#include "red_black_solver.h"
+
+#include <string>
+
+
+RedBlackSolver::RedBlackSolver() {}
+
+
+bool RedBlackSolver::inPlaceSupported() {
+	return GLAD_GL_VERSION_4_5 || GLAD_GL_ARB_texture_barrier;
+}
+
+
+void RedBlackSolver::loadShaders(bool compute, GLenum velocityFormat, GLenum pressureFormat) {
+	this->velocityFormat = velocityFormat;
+
+	sorShader = Shader("shaders/fluid/rb_sor.vert", "shaders/fluid/rb_sor.frag");
+	if (compute) {
+		std::string velocityName = PingPongField::formatName(velocityFormat);
+		std::string pressureName = PingPongField::formatName(pressureFormat);
+		sorComputeShaders[0] = Shader("shaders/fluid/rb_sor.comp",
+			"#define FIELD_FORMAT " + velocityName + "\n#define RHS_FORMAT " + velocityName + "\n");
+		sorComputeShaders[1] = Shader("shaders/fluid/rb_sor.comp",
+			"#define FIELD_FORMAT " + pressureName + "\n#define RHS_FORMAT r32f\n");
+	}
+}
+
+
+void RedBlackSolver::create(unsigned int quadVAO, bool compute) {
+	this->quadVAO = quadVAO;
+
+	sorShader.use();
+	sorShader.setInt("fieldTexture", 0);
+	sorShader.setInt("rhsTexture", 1);
+	sorPressure = sorShader.uniform("pressure");
+	sorParity = sorShader.uniform("parity");
+	sorOmega = sorShader.uniform("omega");
+	sorInPlace = sorShader.uniform("inPlace");
+
+	if (compute) {
+		for (int i = 0; i < 2; i++) {
+			computePressure[i] = sorComputeShaders[i].uniform("pressure");
+			computeParity[i] = sorComputeShaders[i].uniform("parity");
+			computeOmega[i] = sorComputeShaders[i].uniform("omega");
+		}
+	}
+
+	glUseProgram(0);
+}
+
+
+void RedBlackSolver::diffuse(PingPongField& velocity, unsigned int rhsFramebuffer, unsigned int rhsTexture,
+	int iterations, bool compute) {
+
+	// the velocity before the solve is both the right hand side and the initial guess
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, velocity.readFramebuffer());
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, rhsFramebuffer);
+	glBlitFramebuffer(0, 0, velocity.width, velocity.height, 0, 0, velocity.width, velocity.height,
+		GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+	sweep(velocity, rhsTexture, iterations, false, diffusionOmega, compute);
+}
+
+
+void RedBlackSolver::solvePressure(PingPongField& pressure, unsigned int divergenceTexture, int iterations,
+	bool compute) {
+
+	// warm started from the last step's pressure like the jacobi solve
+	sweep(pressure, divergenceTexture, iterations, true, pressureOmega, compute);
+}
+
+
+void RedBlackSolver::sweep(PingPongField& field, unsigned int rhsTexture, int iterations,
+	bool pressure, float omega, bool compute) {
+
+	if (compute) {
+		int program = pressure ? 1 : 0;
+		const Shader& sorComputeShader = sorComputeShaders[program];
+		sorComputeShader.use();
+		sorComputeShader.setBool(computePressure[program], pressure);
+		sorComputeShader.setFloat(computeOmega[program], omega);
+
+		glBindImageTexture(0, field.readTexture(), 0, GL_FALSE, 0, GL_READ_WRITE, field.format);
+		glBindImageTexture(1, rhsTexture, 0, GL_FALSE, 0, GL_READ_ONLY, pressure ? GL_R32F : velocityFormat);
+
+		// half the columns per half pass
+		int groupsX = ((field.width + 1) / 2 + 15) / 16;
+		int groupsY = (field.height + 15) / 16;
+
+		for (int i = 0; i < 2 * iterations; i++) {
+			sorComputeShader.setInt(computeParity[program], i % 2);
+			glDispatchCompute(groupsX, groupsY, 1);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		}
+		return;
+	}
+
+	bool inPlace = inPlaceSupported();
+
+	sorShader.use();
+	sorShader.setBool(sorPressure, pressure);
+	sorShader.setFloat(sorOmega, omega);
+	sorShader.setBool(sorInPlace, inPlace);
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, rhsTexture);
+	glBindVertexArray(quadVAO);
+
+	if (inPlace) {
+		glBindFramebuffer(GL_FRAMEBUFFER, field.readFramebuffer());
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, field.readTexture());
+	}
+
+	for (int i = 0; i < 2 * iterations; i++) {
+		sorShader.setInt(sorParity, i % 2);
+
+		if (inPlace) {
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+			// the next half pass reads the cells this one wrote
+			glTextureBarrier();
+		}
+		else {
+			glBindFramebuffer(GL_FRAMEBUFFER, field.writeFramebuffer());
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, field.readTexture());
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+			field.swap();
+		}
+	}
+
+	glBindVertexArray(0);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "field.h"
+#include "shader.h"
+
+// red black ordered SOR for the diffusion and pressure solves. one iteration
+// is two half passes, each updating the cells of one checkerboard colour from
+// their neighbours of the other colour. the field is updated in place: with
+// image load/store on the compute path, and with a texture barrier between
+// half passes on the fragment path. contexts without texture barriers fall
+// back to rendering every half pass into the field's other texture
+class RedBlackSolver {
+public:
+	// over relaxation of each solve. 1 is plain gauss seidel. pressure gains
+	// most from values towards 2, diffusion is already diagonally dominant
+	float pressureOmega = 1.7f;
+	float diffusionOmega = 1.0f;
+
+	RedBlackSolver();
+
+	// true if the fragment path can update the field in place
+	static bool inPlaceSupported();
+
+	// starts building the programs, the compute ones only if compute is true.
+	// those are for fields of these internal formats, the diffusion's right
+	// hand side has the velocity's format and the divergence is GL_R32F
+	void loadShaders(bool compute, GLenum velocityFormat, GLenum pressureFormat);
+
+	// sets up the programs, after loadShaders()
+	void create(unsigned int quadVAO, bool compute);
+
+	// iterations sweeps of the diffusion solve on velocity's read side, which
+	// is copied into the rhs target first since it is the right hand side
+	void diffuse(PingPongField& velocity, unsigned int rhsFramebuffer, unsigned int rhsTexture,
+		int iterations, bool compute);
+
+	// iterations sweeps of the pressure solve against the divergence in
+	// divergenceTexture
+	void solvePressure(PingPongField& pressure, unsigned int divergenceTexture, int iterations, bool compute);
+
+private:
+	unsigned int quadVAO;
+
+	Shader sorShader;					// fragment half pass
+	Shader sorComputeShaders[2];		// in place compute half pass, diffusion and pressure
+
+	Shader::Uniform sorPressure, sorParity, sorOmega, sorInPlace;
+	Shader::Uniform computePressure[2], computeParity[2], computeOmega[2];
+	GLenum velocityFormat = GL_RGBA16F;
+
+	void sweep(PingPongField& field, unsigned int rhsTexture, int iterations,
+		bool pressure, float omega, bool compute);
+};
@@ -0,0 +1,159 @@
+#include "residual_check.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+ResidualCheck::ResidualCheck() {}
+
+
+void ResidualCheck::loadShaders() {
+	residualShader = Shader("shaders/fluid/residual.vert", "shaders/fluid/residual.frag");
+}
+
+
+void ResidualCheck::create(unsigned int quadVAO) {
+	this->quadVAO = quadVAO;
+
+	residualShader.use();
+	residualShader.setInt("pressureTexture", 0);
+	residualShader.setInt("divergenceTexture", 1);
+	glUseProgram(0);
+
+	for (Readback& readback : readbacks) {
+		glGenBuffers(1, &readback.buffer);
+	}
+}
+
+
+void ResidualCheck::resize(int gridWidth, int gridHeight) {
+	dropReadbacks();
+	if (blocksFramebuffer != 0) {
+		glDeleteFramebuffers(1, &blocksFramebuffer);
+		glDeleteTextures(1, &blocksTexture);
+	}
+
+	blocksWidth = (gridWidth + TILE - 1) / TILE;
+	blocksHeight = (gridHeight + TILE - 1) / TILE;
+	PingPongField::createTarget(blocksFramebuffer, blocksTexture, blocksWidth, blocksHeight, GL_RG32F);
+
+	for (Readback& readback : readbacks) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, readbackBytes(), NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// what the old size needed says little about the new one
+	learntLimit = 0;
+	residual = -1.0f;
+}
+
+
+void ResidualCheck::begin() {
+	solve++;
+}
+
+
+void ResidualCheck::measure(unsigned int pressureTexture, unsigned int divergenceTexture, int iterations, bool last) {
+	glBindFramebuffer(GL_FRAMEBUFFER, blocksFramebuffer);
+	glViewport(0, 0, blocksWidth, blocksHeight);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, pressureTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, divergenceTexture);
+
+	residualShader.use();
+	glBindVertexArray(quadVAO);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+
+	// the oldest is dropped when the gpu is that far behind
+	if (readbacksInFlight == READBACK_RING) {
+		Readback& oldest = readbacks[readbackHead];
+		glDeleteSync(oldest.fence);
+		oldest.fence = 0;
+		readbacksInFlight--;
+	}
+
+	Readback& readback = readbacks[readbackHead];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, blocksWidth, blocksHeight, GL_RG, GL_FLOAT, 0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readback.solve = solve;
+	readback.iterations = iterations;
+	readback.last = last;
+	readbackHead = (readbackHead + 1) % READBACK_RING;
+	readbacksInFlight++;
+}
+
+
+bool ResidualCheck::converged() {
+	collectReadbacks();
+	return convergedSolve == solve;
+}
+
+
+int ResidualCheck::limit(int maxIterations) const {
+	return learntLimit > 0 ? std::min(learntLimit, maxIterations) : maxIterations;
+}
+
+
+void ResidualCheck::collectReadbacks() {
+	while (readbacksInFlight > 0) {
+		Readback& readback = readbacks[(readbackHead - readbacksInFlight + READBACK_RING) % READBACK_RING];
+
+		// a zero timeout only asks, flushing makes sure the fence gets there
+		GLenum status = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+			break;
+		}
+		glDeleteSync(readback.fence);
+		readback.fence = 0;
+		readbacksInFlight--;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+		const float* mapped = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readbackBytes(), GL_MAP_READ_BIT);
+		if (mapped == NULL) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			continue;
+		}
+		double residualSum = 0.0;
+		double divergenceSum = 0.0;
+		for (size_t i = 0; i < readbackBytes() / sizeof(float); i += 2) {
+			residualSum += mapped[i];
+			divergenceSum += mapped[i + 1];
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		// still flow has nothing to solve
+		residual = divergenceSum > 0.0 ? (float)std::sqrt(residualSum / divergenceSum) : 0.0f;
+
+		// checks come back in order, so the first under the tolerance is the
+		// fewest iterations its solve needed
+		if (residual <= tolerance) {
+			if (readback.solve > convergedSolve) {
+				convergedSolve = readback.solve;
+				learntLimit = readback.iterations;
+			}
+		}
+		else if (readback.last) {
+			learntLimit = readback.iterations + interval;
+		}
+	}
+}
+
+
+void ResidualCheck::dropReadbacks() {
+	for (Readback& readback : readbacks) {
+		if (readback.fence != 0) {
+			glDeleteSync(readback.fence);
+			readback.fence = 0;
+		}
+	}
+	readbacksInFlight = 0;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+#include "field.h"
+#include "shader.h"
+
+// tells the iterative pressure solves when they have converged. measure()
+// reduces the residual of laplacian(p) = div(v) to one texel per TILE x TILE
+// block of the grid and starts reading those back, converged() adds up the
+// readbacks that have arrived without waiting for the others. the solve
+// keeps iterating while the gpu catches up, so it stops a few checks after
+// the residual fell under the tolerance at worst, and never stalls on it.
+//
+// on a gpu far behind the cpu a readback only comes back after its solve is
+// over. those still teach limit(): a solve that was under the tolerance at
+// some check makes the next ones stop there, and one that ended above it
+// gives the next interval more iterations
+class ResidualCheck {
+public:
+	// grid texels along a block side, same as TILE in residual.frag
+	static const int TILE = 16;
+
+	// residual over the divergence, in the 2 norm, a solve stops under. 0
+	// runs every iteration without checking
+	float tolerance = 0.0f;
+	// iterations between checks
+	int interval = 8;
+
+	ResidualCheck();
+
+	// starts building the program, before create()
+	void loadShaders();
+
+	// sets up the program, the blocks come with resize()
+	void create(unsigned int quadVAO);
+
+	// reallocates the blocks for a new grid size and forgets what was learnt
+	void resize(int gridWidth, int gridHeight);
+
+	// starts the next solve
+	void begin();
+
+	// checks the pressure in pressureTexture against the divergence after
+	// iterations of this solve. last is the check at the end of a solve that
+	// ran out of iterations. changes the framebuffer, textures and viewport
+	void measure(unsigned int pressureTexture, unsigned int divergenceTexture, int iterations, bool last);
+
+	// if a check of this solve that came back was under the tolerance
+	bool converged();
+
+	// iterations the next solve runs at most, out of maxIterations
+	int limit(int maxIterations) const;
+
+	// relative residual of the latest check that came back, -1 before any
+	float lastResidual() const { return residual; }
+
+private:
+	Shader residualShader;
+
+	// GL_RG32F, x the squared residual of a block and y its squared divergence
+	unsigned int blocksFramebuffer = 0;
+	unsigned int blocksTexture = 0;
+	int blocksWidth = 0;
+	int blocksHeight = 0;
+	unsigned int quadVAO = 0;
+
+	static const int READBACK_RING = 8;
+	struct Readback {
+		unsigned int buffer = 0;
+		GLsync fence = 0;
+		int solve = 0;
+		int iterations = 0;
+		bool last = false;
+	};
+	Readback readbacks[READBACK_RING];
+	int readbackHead = 0;
+	int readbacksInFlight = 0;
+
+	int solve = 0;						// counts begin()
+	int convergedSolve = -1;			// latest solve a check of was under the tolerance
+	int learntLimit = 0;				// 0 for none yet
+	float residual = -1.0f;
+
+	size_t readbackBytes() const { return 2 * (size_t)blocksWidth * blocksHeight * sizeof(float); }
+	void collectReadbacks();			// the ones that are done, without waiting
+	void dropReadbacks();
+};
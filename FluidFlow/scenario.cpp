@@ -0,0 +1,115 @@
+#include "scenario.h"
+
+#include <glad/glad.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+
+bool Scenario::load(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		std::cout << "Unable to open scenario " << path << std::endl;
+		return false;
+	}
+
+	std::string line;
+	int number = 0;
+	while (std::getline(file, line)) {
+		number++;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) {
+			line.erase(comment);
+		}
+
+		std::istringstream words(line);
+		std::string key;
+		if (!(words >> key)) {
+			continue;
+		}
+
+		bool valid = true;
+		if (key == "resolution") {
+			valid = (bool)(words >> gridResolution >> dyeResolution) && gridResolution > 0 && dyeResolution > 0;
+		}
+		else if (key == "steps") {
+			valid = (bool)(words >> steps) && steps >= 0;
+		}
+		else if (key == "initial") {
+			std::string name;
+			words >> name;
+			if (name == "default") {
+				initial = ScenarioInitial::DEFAULT;
+			}
+			else if (name == "still") {
+				initial = ScenarioInitial::STILL;
+			}
+			else if (name == "empty") {
+				initial = ScenarioInitial::EMPTY;
+			}
+			else {
+				valid = false;
+			}
+		}
+		else if (key == "viscosity") {
+			valid = (bool)(words >> viscosity) && viscosity >= 0.0f;
+		}
+		else if (key == "milliseconds") {
+			valid = (bool)(words >> millisecondsPerFrame) && millisecondsPerFrame > 0.0f;
+		}
+		else if (key == "iterations") {
+			valid = (bool)(words >> diffusionIterations >> pressureIterations) &&
+				diffusionIterations >= 0 && pressureIterations >= 0;
+		}
+		else if (key == "force" || key == "dye") {
+			ScenarioImpulse impulse;
+			impulse.dye = key == "dye";
+			valid = (bool)(words >> impulse.start >> impulse.duration >> impulse.x >> impulse.y
+				>> impulse.valueX >> impulse.valueY) && impulse.start >= 0 && impulse.duration > 0;
+
+			// the radius is optional
+			float radius;
+			if (valid && words >> radius) {
+				impulse.radius = radius;
+				valid = radius > 0.0f;
+			}
+			else if (valid && !words.eof()) {
+				valid = false;
+			}
+			impulses.push_back(impulse);
+		}
+		else {
+			std::cout << path << ":" << number << ": unknown setting " << key << std::endl;
+			return false;
+		}
+
+		std::string rest;
+		if (!valid || words >> rest) {
+			std::cout << path << ":" << number << ": invalid " << key << " line" << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+uint64_t fieldChecksum(const PingPongField& field) {
+	// the texels as stored, whatever the field's format
+	GLenum format = GL_RGBA, type = GL_HALF_FLOAT;
+	PingPongField::pixelFormat(field.format, format, type);
+	std::vector<unsigned char> texels((size_t)field.width * field.height * PingPongField::texelBytes(field.format));
+
+	glBindFramebuffer(GL_FRAMEBUFFER, field.readFramebuffer());
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, field.width, field.height, format, type, texels.data());
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	const unsigned char* bytes = texels.data();
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < texels.size(); i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
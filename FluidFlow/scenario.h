@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "field.h"
+
+// a gaussian impulse added to the velocity or the picture for a range of
+// steps. positions are in [0, 1] across the field, y pointing up
+struct ScenarioImpulse {
+	bool dye = false;			// adds to the picture instead of the velocity
+	int start = 0;				// first step it is applied in, from 0
+	int duration = 1;			// steps it is applied in
+	float x = 0.5f;
+	float y = 0.5f;
+	float valueX = 0.0f;		// velocity added each step in cells per unit time, or dye red and green
+	float valueY = 0.0f;
+	float radius = 0.0316f;		// gaussian radius in half window widths
+
+	bool activeAt(int step) const { return step >= start && step < start + duration; }
+};
+
+// what the fields hold before the first step
+enum class ScenarioInitial {
+	DEFAULT,					// the picture and swirl of an interactive run
+	STILL,						// the picture at rest
+	EMPTY						// black picture at rest
+};
+
+// a scripted run, replayed without input by Simulation::runScenario(). the
+// file has one setting per line, # starts a comment:
+//
+//   resolution 256 1024          grid and dye cells along the shorter side
+//   steps 600
+//   initial default|still|empty
+//   viscosity 0.000001
+//   milliseconds 333.3           Simulation::millisecondsPerFrame
+//   iterations 40 40             diffusion and pressure iterations
+//   force start duration x y vx vy [radius]
+//   dye start duration x y red green [radius]
+struct Scenario {
+	int gridResolution = 0;		// 0 keeps the command line's
+	int dyeResolution = 0;
+	int steps = 300;
+	ScenarioInitial initial = ScenarioInitial::DEFAULT;
+
+	// negative keeps the simulation's defaults
+	float viscosity = -1.0f;
+	float millisecondsPerFrame = -1.0f;
+	int diffusionIterations = -1;
+	int pressureIterations = -1;
+
+	std::vector<ScenarioImpulse> impulses;
+
+	// reads the file, false with a message naming the line on errors
+	bool load(const std::string& path);
+};
+
+// 64 bit FNV-1a hash of the read side of field in its own format, the same
+// scenario on the same driver gives the same checksums
+uint64_t fieldChecksum(const PingPongField& field);
@@ -1,102 +1,160 @@
 #include "shader.h"
 
+#include "program_cache.h"
+
 Shader::Shader(const char* vertexPath, const char* fragmentPath) {
-	// first load code from file
-	std::string vertexCode;
-	std::string fragmentCode;
+	// compiles in the background unless the cache has it, see program_cache.h
+	ID = ProgramCache::program({
+		{ GL_VERTEX_SHADER, vertexPath, readCode(vertexPath) },
+		{ GL_FRAGMENT_SHADER, fragmentPath, readCode(fragmentPath) }
+	});
+}
+
+Shader::Shader(const char* computePath) {
+	ID = ProgramCache::program({
+		{ GL_COMPUTE_SHADER, computePath, readCode(computePath) }
+	});
+}
 
-	readCode(vertexPath, fragmentPath, vertexCode, fragmentCode);
+Shader::Shader(const char* computePath, const std::string& defines) {
+	std::string code = readCode(computePath);
+	size_t versionEnd = code.find('\n', code.find("#version"));
+	code.insert(versionEnd == std::string::npos ? code.size() : versionEnd + 1, defines);
+
+	ID = ProgramCache::program({
+		{ GL_COMPUTE_SHADER, computePath, code }
+	});
+}
+
+Shader::Shader() {
+	ready = true;
+}
 
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
 
-	// compile and link shaders
-	unsigned int vertex, fragment;
+void Shader::use() const {
+	prepare();
+	glUseProgram(ID);
+}
 
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
-	checkShaderError(vertex);
 
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-	checkShaderError(fragment);
+Shader::Uniform Shader::uniform(const std::string& name) const {
+	prepare();
+	auto found = uniforms.find(name);
+	if (found == uniforms.end()) {
+		return Uniform();
+	}
+	return found->second;
+}
 
-	ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
-	checkShaderError(ID, true);
 
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+void Shader::setBool(Uniform uniform, bool value) const {
+#ifdef _DEBUG
+	if (uniform.location != -1 && uniform.type != GL_BOOL)
+		std::cout << "Uniform at location " << uniform.location << " is not a bool" << std::endl;
+#endif
+	glUniform1i(uniform.location, (int)value);
 }
 
-Shader::Shader() {}
 
+void Shader::setInt(Uniform uniform, int value) const {
+#ifdef _DEBUG
+	if (uniform.location != -1 && uniform.type != GL_INT && uniform.type != GL_SAMPLER_2D)
+		std::cout << "Uniform at location " << uniform.location << " is not an int or sampler" << std::endl;
+#endif
+	glUniform1i(uniform.location, value);
+}
 
-void Shader::use() {
-	glUseProgram(ID);
+
+void Shader::setFloat(Uniform uniform, float value) const {
+#ifdef _DEBUG
+	if (uniform.location != -1 && uniform.type != GL_FLOAT)
+		std::cout << "Uniform at location " << uniform.location << " is not a float" << std::endl;
+#endif
+	glUniform1f(uniform.location, value);
+}
+
+
+void Shader::setVec2(Uniform uniform, float x, float y) const {
+#ifdef _DEBUG
+	if (uniform.location != -1 && uniform.type != GL_FLOAT_VEC2)
+		std::cout << "Uniform at location " << uniform.location << " is not a vec2" << std::endl;
+#endif
+	glUniform2f(uniform.location, x, y);
 }
 
 
 void Shader::setBool(const std::string& name, bool value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	setBool(uniform(name), value);
 }
 
 
 void Shader::setInt(const std::string& name, int value) const {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	setInt(uniform(name), value);
 }
 
 
 void Shader::setFloat(const std::string& name, float value) const {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	setFloat(uniform(name), value);
 }
 
 
-void Shader::checkShaderError(unsigned int shader, bool program) {
-	int success;
-	char infoLog[512];
-
-	if (program) {
-		glGetProgramiv(shader, GL_COMPILE_STATUS, &success);
-	}
-	else {
-		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+void Shader::prepare() const {
+	if (ready) {
+		return;
 	}
-
-	if (!success) {
-		glGetShaderInfoLog(shader, 512, NULL, infoLog);
-		std::cout << "ERROR COMPILING SHADER: " << infoLog << std::endl;
+	ready = true;
+	if (ProgramCache::finish(ID)) {
+		reflectUniforms();
 	}
 }
 
 
-void Shader::readCode(const char* vertexPath, const char* fragmentPath,
-	std::string& vertexCode, std::string& fragmentCode) {
+void Shader::reflectUniforms() const {
+	uniforms.clear();
 
-	std::ifstream vertexStream(vertexPath);
-	std::ifstream fragmentStream(fragmentPath);
+	int count = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
 
-	std::string line;
+	char name[256];
+	for (int i = 0; i < count; i++) {
+		int length = 0;
+		int size = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(ID, (unsigned int)i, sizeof(name), &length, &size, &type, name);
 
-	if (vertexStream.is_open()) {
-		while (std::getline(vertexStream, line)) {
-			vertexCode += line + '\n';
+		// members of uniform blocks have no location
+		int location = glGetUniformLocation(ID, name);
+		if (location == -1) {
+			continue;
 		}
-	}
-	else {
-		std::cout << "Unable to open vertex shader file" << std::endl;
-	}
 
-	if (fragmentStream.is_open()) {
-		while (std::getline(fragmentStream, line)) {
-			fragmentCode += line + '\n';
+		// arrays are reported as name[0], also make them reachable as name
+		std::string key(name, length);
+		if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0) {
+			key.resize(key.size() - 3);
 		}
+
+		Uniform uniform;
+		uniform.location = location;
+		uniform.type = type;
+		uniforms[key] = uniform;
 	}
-	else {
-		std::cout << "Unable to open fragment shader file" << std::endl;
+
+	unsigned int block = glGetUniformBlockIndex(ID, "FrameUniforms");
+	if (block != GL_INVALID_INDEX) {
+		glUniformBlockBinding(ID, block, FRAME_UNIFORMS_BINDING);
 	}
-}
\ No newline at end of file
+}
+
+
+std::string Shader::readCode(const char* path) {
+	std::ifstream stream(path, std::ios::binary);
+	if (!stream.is_open()) {
+		std::cout << "Unable to open shader file " << path << std::endl;
+		return "";
+	}
+
+	std::ostringstream code;
+	code << stream.rdbuf();
+	return code.str();
+}
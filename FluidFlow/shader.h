@@ -3,29 +3,61 @@
 #include <glad/glad.h>
 
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+// uniform buffer binding point of the FrameUniforms block shared by all programs
+const unsigned int FRAME_UNIFORMS_BINDING = 0;
+
 class Shader {
 public:
-	// program id
-	unsigned int ID;
+	// location and type of an active uniform, reflected once at link time
+	struct Uniform {
+		int location = -1;
+		GLenum type = GL_NONE;
+	};
+
+	// program id. the program may still be compiling, use() and uniform()
+	// wait for it, see program_cache.h
+	unsigned int ID = 0;
 
 	// constructor
 	Shader();
 	Shader(const char* vertexPath, const char* fragmentPath);
+	// compute program, needs a GL 4.3 context
+	explicit Shader(const char* computePath);
+	// compute program with #define lines inserted after its #version line
+	Shader(const char* computePath, const std::string& defines);
 
 	// activate, calls useProgram
-	void use();
+	void use() const;
+
+	// handle of an active uniform, with location -1 if the program has no
+	// uniform by that name. look handles up once and keep them
+	Uniform uniform(const std::string& name) const;
 
 	// functions to set uniform values
+	void setBool(Uniform uniform, bool value) const;
+	void setInt(Uniform uniform, int value) const;
+	void setFloat(Uniform uniform, float value) const;
+	void setVec2(Uniform uniform, float x, float y) const;
+
 	void setBool(const std::string& name, bool value) const;
 	void setInt(const std::string& name, int value) const;
 	void setFloat(const std::string& name, float value) const;
 
 private:
-	void readCode(const char* vertexPath, const char* fragmentPath,
-		std::string& vertexCode, std::string& fragmentCode);
-	void checkShaderError(unsigned int shader, bool program = false);
+	// filled on first use, once the program has linked
+	mutable std::unordered_map<std::string, Uniform> uniforms;
+	mutable bool ready = false;
+
+	// waits for the link, then reflects the uniforms
+	void prepare() const;
+
+	// fills uniforms and binds the FrameUniforms block if the program uses it
+	void reflectUniforms() const;
+
+	static std::string readCode(const char* path);
 };
\ No newline at end of file
@@ -0,0 +1,39 @@
+#version 330 core
+
+// one instance per tile of the grid, see active_tiles.h. draws the tile in
+// texture coordinates of whatever field the pass writes, or nothing when the
+// tile and its neighbours have settled
+
+out vec2 texCoords;
+
+uniform sampler2D tileMask;		// x velocity and y picture activity per tile
+uniform bool pictureTiles;		// the tile must also have uneven picture nearby
+
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
+
+const int TILE = 16;
+
+void main() {
+	ivec2 tiles = textureSize(tileMask, 0);
+	ivec2 tile = ivec2(gl_InstanceID % tiles.x, gl_InstanceID / tiles.x);
+
+	// whatever reaches the tile within a step comes from its neighbours
+	vec2 activity = vec2(0.0);
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			ivec2 neighbour = clamp(tile + ivec2(x, y), ivec2(0), tiles - 1);
+			activity = max(activity, texelFetch(tileMask, neighbour, 0).xy);
+		}
+	}
+	bool drawn = activity.x > 0.0 && (!pictureTiles || activity.y > 0.0);
+
+	// the last tiles of a row or column stick out of the field and are cut
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	texCoords = min((vec2(tile) + corner) * float(TILE) * texelSize, vec2(1.0));
+	gl_Position = drawn ? vec4(2.0 * texCoords - 1.0, 0.0, 1.0) : vec4(2.0, 2.0, 0.0, 1.0);
+}
\ No newline at end of file
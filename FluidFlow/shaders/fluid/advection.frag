@@ -5,18 +5,28 @@ out vec4 fragColor;
 in vec2 texCoords;
 
 uniform sampler2D screenTexture;
+uniform sampler2D obstacleTexture;	// 1 in solid cells, see boundary_cells.h
+uniform bool obstacles;
 
-uniform float fps;
-
-uniform float width;
-uniform float height;
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
 
 void main() {
+	// nothing moves inside an obstacle
+	if (obstacles && texture(obstacleTexture, texCoords).x > 0.5) {
+		fragColor = vec4(0.0);
+		return;
+	}
+
 	// delta t is 1/60
 	// vec2 texCoords = vec2(0.5f * (coords.x + 1.0f), 0.5f * (coords.y + 1.0f));
 
 	// vec2 newTexCoords = texCoords - (255 * texture(screenTexture, texCoords).xy / (60.0 * size));
-	vec2 change = vec2((texture(screenTexture, texCoords).x)/(fps * width), (texture(screenTexture, texCoords).y)/(fps * height));
+	vec2 change = texture(screenTexture, texCoords).xy * dt * texelSize;
 	vec2 newTexCoords = texCoords - change;
 	fragColor = texture(screenTexture, newTexCoords);
 
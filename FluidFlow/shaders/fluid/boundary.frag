@@ -1,70 +1,25 @@
 #version 330 core
 
+// a boundary cell takes the average of its fluid neighbours, which the
+// velocity takes negated so that nothing flows through the walls
+
 out vec4 fragColor;
-in vec2 texCoords;
+flat in vec4 weights;
 
 uniform sampler2D inputTexture;
-
-uniform float width;
-uniform float height;
-
 uniform bool velocity;
 
 void main() {
-	float offsetX = 1.0 / width;
-	float offsetY = 1.0 / height;
-	vec4 curr = texture(inputTexture, texCoords);
-
-	float offsetToUse = 0.0;
-	bool x = true;
-	float multiplier = 1.0;
-
-	float boundsX = (width - 998.0) / (2.0 * width);
-	float boundsY = (height - 998.0) / (2.0 * height);
-
-	if (texCoords.x <= boundsX) {
-		if (velocity) {
-			offsetToUse = offsetX;
-			multiplier = -1.0;
-		} else {
-			offsetToUse = offsetX;
-			multiplier = 1.0;
-		}
-	} else if (texCoords.x >= (1.0 - boundsX)) {
-		if (velocity) {
-			offsetToUse = -offsetX;
-			multiplier = -1.0;
-		} else {
-			offsetToUse = -offsetX;
-			multiplier = 1.0;
-		}
-	} else if (texCoords.y >= (1.0 - boundsY)) {
-		if (velocity) {
-			offsetToUse = -offsetY;
-			multiplier = -1.0;
-			x = false;
-		} else {
-			offsetToUse = -offsetY;
-			multiplier = 1.0;
-			x = false;
-		}
-	} else if (texCoords.y <= boundsY) {
-		if (velocity) {
-			offsetToUse = offsetY;
-			multiplier = -1.0;
-			x = false;
-		} else {
-			offsetToUse = offsetY;
-			multiplier = 1.0;
-			x = false;
-		}
-	}
-
-	if (x) {
-		curr = texture(inputTexture, vec2(texCoords.x + offsetToUse, texCoords.y));
-		fragColor = vec4(multiplier * curr.x, multiplier * curr.y, curr.z, curr.w);
-	} else {
-		curr = texture(inputTexture, vec2(texCoords.x, texCoords.y + offsetToUse));
-		fragColor = vec4(multiplier * curr.x, multiplier * curr.y, curr.z, curr.w);
-	}
+	ivec2 cell = ivec2(gl_FragCoord.xy);
+
+	// only the weighted neighbours are inside the field
+	vec4 sum = vec4(0.0);
+	if (weights.x > 0.0) sum += texelFetch(inputTexture, cell + ivec2(-1, 0), 0);
+	if (weights.y > 0.0) sum += texelFetch(inputTexture, cell + ivec2(1, 0), 0);
+	if (weights.z > 0.0) sum += texelFetch(inputTexture, cell + ivec2(0, -1), 0);
+	if (weights.w > 0.0) sum += texelFetch(inputTexture, cell + ivec2(0, 1), 0);
+	vec4 average = sum / dot(weights, vec4(1.0));
+
+	float multiplier = velocity ? -1.0 : 1.0;
+	fragColor = vec4(multiplier * average.x, multiplier * average.y, average.z, average.w);
 }
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+
+// one point per boundary cell, see boundary_cells.h
+
+layout (location = 0) in vec2 cell;			// in texels, from the bottom left
+layout (location = 1) in vec4 neighbours;	// weights of the left, right, bottom and top neighbour
+
+flat out vec4 weights;
+
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
+
+void main() {
+	weights = neighbours;
+	gl_Position = vec4(2.0 * (cell + 0.5) * texelSize - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
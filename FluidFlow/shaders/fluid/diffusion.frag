@@ -4,25 +4,27 @@ out vec4 fragColor;
 
 in vec2 texCoords;
 
-uniform sampler2D velocityTexture;
+uniform sampler2D velocityTexture;	// current iterate
+uniform sampler2D rhsTexture;		// velocity before the solve
 
-uniform float width;
-uniform float height;
-
-uniform float viscosity;
-uniform float fps;
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
 
 void main() {
-	float offsetX = 1.0 / width;
-	float offsetY = 1.0 / height;
+	float offsetX = texelSize.x;
+	float offsetY = texelSize.y;
 	
 	vec2 sum =	texture(velocityTexture, vec2(texCoords.x - offsetX, texCoords.y)).xy + 
 				texture(velocityTexture, vec2(texCoords.x + offsetX, texCoords.y)).xy +
 				texture(velocityTexture, vec2(texCoords.x, texCoords.y - offsetY)).xy +
 				texture(velocityTexture, vec2(texCoords.x, texCoords.y + offsetY)).xy;
 	
-	float coeff = 1.0 / (viscosity*(1.0/fps));
-	vec4 curr = texture(velocityTexture, texCoords);
+	float coeff = 1.0 / (viscosity * dt);
+	vec4 curr = texture(rhsTexture, texCoords);
 	sum = sum + vec2(coeff * curr.x, coeff * curr.y);
 
 	sum = vec2(sum.x/(4 + coeff), sum.y/(4 + coeff));
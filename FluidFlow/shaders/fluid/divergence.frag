@@ -0,0 +1,31 @@
+#version 330 core
+
+// divergence of the velocity, the right hand side of the pressure solves.
+// computed once a step into its own target
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+uniform sampler2D velocityTexture;
+
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
+
+void main() {
+	float offsetX = texelSize.x;
+	float offsetY = texelSize.y;
+
+	float x_term =	texture(velocityTexture, vec2(texCoords.x + offsetX, texCoords.y)).x - 
+					texture(velocityTexture, vec2(texCoords.x - offsetX, texCoords.y)).x;
+	x_term = x_term / 2.0;
+
+	float y_term =	texture(velocityTexture, vec2(texCoords.x, texCoords.y + offsetY)).y - 
+					texture(velocityTexture, vec2(texCoords.x, texCoords.y - offsetY)).y;
+	y_term = y_term / 2.0;
+
+	fragColor = vec4(x_term + y_term, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
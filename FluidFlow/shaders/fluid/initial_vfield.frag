@@ -3,18 +3,20 @@
 out vec4 fragColor;
 in vec2 loc;
 
-uniform float width;
-uniform float height;
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
 
 void main() {
 	float mult = 2.0;
 	float mag = 0.45;
-	
-	if (abs(loc.x * width / 1000.0) > 1.0) {
-		fragColor = vec4(0.0, 0.0, 0.0, 1.0);
-	} else {
-		fragColor = vec4(mag*(1000.0)*sin(mult*3.1415*loc.y*height/1000.0), mag*(1000.0)*sin(mult*3.1415*loc.x*width/1000.0), 0.0, 1.0);
-	}
+
+	// velocities are in cells per unit time, so scale with the grid to get
+	// the same flow at every resolution
+	fragColor = vec4(mag*gridSize.x*sin(mult*3.1415*loc.y), mag*gridSize.y*sin(mult*3.1415*loc.x), 0.0, 1.0);
 
 	// fragColor = vec4(0.0, 0.0, 0.0, 1.0);
 }
\ No newline at end of file
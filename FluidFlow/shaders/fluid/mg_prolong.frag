@@ -0,0 +1,20 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+uniform sampler2D pressureTexture;
+uniform sampler2D coarseTexture;
+
+// false replaces the fine solution instead of correcting it (full multigrid)
+uniform bool correction;
+
+void main() {
+	float coarse = texture(coarseTexture, texCoords).x;
+
+	if (correction) {
+		fragColor = vec4(texture(pressureTexture, texCoords).x + coarse, 0.0, 0.0, 1.0);
+	} else {
+		fragColor = vec4(coarse, 0.0, 0.0, 1.0);
+	}
+}
\ No newline at end of file
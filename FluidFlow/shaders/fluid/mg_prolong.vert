@@ -4,10 +4,8 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec2 aTexCoords;
 
 out vec2 texCoords;
-out vec2 windowCoords;
 
 void main() {
 	gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);
 	texCoords = aTexCoords;
-	windowCoords = aPos.xy;
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+uniform sampler2D rhsTexture;
+
+// size of the coarsest level, only a few texels across
+uniform float width;
+uniform float height;
+
+void main() {
+	// with neumann boundaries the pressure is only defined up to a constant
+	// and a right hand side with a non zero mean has no solution, so the
+	// coarse solve would keep adding to the constant. remove that part here
+	float sum = 0.0;
+	for (int y = 0; y < int(height); y++) {
+		for (int x = 0; x < int(width); x++) {
+			sum += texelFetch(rhsTexture, ivec2(x, y), 0).x;
+		}
+	}
+	float mean = sum / (width * height);
+
+	fragColor = vec4(texture(rhsTexture, texCoords).x - mean, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
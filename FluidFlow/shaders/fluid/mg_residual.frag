@@ -0,0 +1,26 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+uniform sampler2D pressureTexture;
+uniform sampler2D rhsTexture;
+
+uniform float width;
+uniform float height;
+
+uniform float cellSize2;
+
+void main() {
+	float offsetX = 1.0 / width;
+	float offsetY = 1.0 / height;
+
+	float sum =	texture(pressureTexture, vec2(texCoords.x - offsetX, texCoords.y)).x + 
+				texture(pressureTexture, vec2(texCoords.x + offsetX, texCoords.y)).x +
+				texture(pressureTexture, vec2(texCoords.x, texCoords.y - offsetY)).x +
+				texture(pressureTexture, vec2(texCoords.x, texCoords.y + offsetY)).x;
+
+	float laplacian = (sum - 4.0 * texture(pressureTexture, texCoords).x) / cellSize2;
+
+	fragColor = vec4(texture(rhsTexture, texCoords).x - laplacian, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
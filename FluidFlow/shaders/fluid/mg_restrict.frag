@@ -0,0 +1,13 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+// finer level, sampled with GL_LINEAR
+uniform sampler2D fineTexture;
+
+void main() {
+	// a coarse texel centre lies on the corner shared by 2x2 fine texels, so
+	// one bilinear fetch is their average
+	fragColor = vec4(texture(fineTexture, texCoords).x, 0.0, 0.0, 1.0);
+}
\ No newline at end of file
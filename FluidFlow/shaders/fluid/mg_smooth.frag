@@ -0,0 +1,31 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+uniform sampler2D pressureTexture;
+uniform sampler2D rhsTexture;
+
+// size of this multigrid level
+uniform float width;
+uniform float height;
+
+// squared cell size of this level in fine grid cells
+uniform float cellSize2;
+// damping of the jacobi update, 0.8 is the best smoother for the 5 point stencil
+uniform float weight;
+
+void main() {
+	float offsetX = 1.0 / width;
+	float offsetY = 1.0 / height;
+
+	float sum =	texture(pressureTexture, vec2(texCoords.x - offsetX, texCoords.y)).x + 
+				texture(pressureTexture, vec2(texCoords.x + offsetX, texCoords.y)).x +
+				texture(pressureTexture, vec2(texCoords.x, texCoords.y - offsetY)).x +
+				texture(pressureTexture, vec2(texCoords.x, texCoords.y + offsetY)).x;
+
+	float curr = texture(pressureTexture, texCoords).x;
+	float jacobi = (sum - cellSize2 * texture(rhsTexture, texCoords).x) / 4.0;
+
+	fragColor = vec4(mix(curr, jacobi, weight), 0.0, 0.0, 1.0);
+}
\ No newline at end of file
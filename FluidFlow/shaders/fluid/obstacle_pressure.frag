@@ -0,0 +1,33 @@
+#version 330 core
+
+// the pressure of the obstacle cells next to fluid, drawn into the target of
+// every pressure.frag iteration. they take the average of their fluid
+// neighbours' new pressure, computed here again instead of read back from
+// the target, so that no pressure gradient pushes fluid into the obstacle
+
+out vec4 fragColor;
+flat in vec4 weights;
+
+uniform sampler2D pressureTexture;
+uniform sampler2D divergenceTexture;
+
+// one jacobi iteration at cell, like pressure.frag
+float iterate(ivec2 cell) {
+	float sum =	texelFetch(pressureTexture, cell + ivec2(-1, 0), 0).x +
+				texelFetch(pressureTexture, cell + ivec2(1, 0), 0).x +
+				texelFetch(pressureTexture, cell + ivec2(0, -1), 0).x +
+				texelFetch(pressureTexture, cell + ivec2(0, 1), 0).x;
+	return (sum - texelFetch(divergenceTexture, cell, 0).x) / 4.0;
+}
+
+void main() {
+	ivec2 cell = ivec2(gl_FragCoord.xy);
+
+	float sum = 0.0;
+	if (weights.x > 0.0) sum += iterate(cell + ivec2(-1, 0));
+	if (weights.y > 0.0) sum += iterate(cell + ivec2(1, 0));
+	if (weights.z > 0.0) sum += iterate(cell + ivec2(0, -1));
+	if (weights.w > 0.0) sum += iterate(cell + ivec2(0, 1));
+
+	fragColor = vec4(sum / dot(weights, vec4(1.0)), 0.0, 0.0, 1.0);
+}
\ No newline at end of file
@@ -6,13 +6,16 @@ out vec4 fragColor;
 uniform sampler2D velocityTexture;
 uniform sampler2D pictureTexture;
 
-uniform float fps;
-uniform float width;
-uniform float height;
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
 
 void main() {
 	// delta t is 1/60
-	vec2 change = vec2((texture(velocityTexture, texCoords).x)/(fps * width), (texture(velocityTexture, texCoords).y)/(fps * height));
+	vec2 change = texture(velocityTexture, texCoords).xy * dt * texelSize;
 	vec2 newTexCoords = texCoords - change;
 	fragColor = texture(pictureTexture, newTexCoords);
 }
\ No newline at end of file
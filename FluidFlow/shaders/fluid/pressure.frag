@@ -4,26 +4,22 @@ out vec4 fragColor;
 in vec2 texCoords;
 
 uniform sampler2D pressureTexture;
-uniform sampler2D velocityTexture;
+uniform sampler2D divergenceTexture;	// of the velocity, see divergence.frag
 
-uniform float width;
-uniform float height;
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
 
 void main() {
-	float offsetX = 1.0 / width;
-	float offsetY = 1.0 / height;
+	float offsetX = texelSize.x;
+	float offsetY = texelSize.y;
 
-
-	// first compute divergence of velocity field
-	float x_term =	texture(velocityTexture, vec2(texCoords.x + offsetX, texCoords.y)).x - 
-					texture(velocityTexture, vec2(texCoords.x - offsetX, texCoords.y)).x;
-	x_term = x_term / (2.0 * 1);
-
-	float y_term =	texture(velocityTexture, vec2(texCoords.x, texCoords.y + offsetY)).y - 
-					texture(velocityTexture, vec2(texCoords.x, texCoords.y - offsetY)).y;
-	y_term = y_term / (2.0 * 1);
-
-	float vel_divergence = x_term + y_term;
+	// the velocity does not change during the solve, so its divergence is
+	// computed once before it
+	float vel_divergence = texture(divergenceTexture, texCoords).x;
 
 	// now perform jacobi iteration to solve for new pressure field
 	float sum =	texture(pressureTexture, vec2(texCoords.x - offsetX, texCoords.y)).x + 
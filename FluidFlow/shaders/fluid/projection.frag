@@ -5,13 +5,25 @@ in vec2 texCoords;
 
 uniform sampler2D pressureTexture;
 uniform sampler2D velocityTexture;
+uniform sampler2D obstacleTexture;	// 1 in solid cells, see boundary_cells.h
+uniform bool obstacles;
 
-uniform float width;
-uniform float height;
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
 
 void main() {
-	float offsetX = 1.0 / width;
-	float offsetY = 1.0 / height;
+	// the cells next to fluid are set by projection_boundary.frag after this
+	if (obstacles && texture(obstacleTexture, texCoords).x > 0.5) {
+		fragColor = vec4(0.0);
+		return;
+	}
+
+	float offsetX = texelSize.x;
+	float offsetY = texelSize.y;
 	
 	float gX =	texture(pressureTexture, vec2(texCoords.x + offsetX, texCoords.y)).x -
 				texture(pressureTexture, vec2(texCoords.x - offsetX, texCoords.y)).x;
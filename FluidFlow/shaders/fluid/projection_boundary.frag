@@ -0,0 +1,40 @@
+#version 330 core
+
+// the velocity boundary of the cells projection.frag just wrote, drawn into
+// the same target. the fluid neighbours are projected here again instead of
+// read back from the target
+
+out vec4 fragColor;
+flat in vec4 weights;
+
+uniform sampler2D pressureTexture;
+uniform sampler2D velocityTexture;
+
+float pressureAt(ivec2 cell) {
+	// a corner projects a border cell, whose neighbours reach past the edge.
+	// clamped like the edge of projection.frag's sampler
+	return texelFetch(pressureTexture, clamp(cell, ivec2(0), textureSize(pressureTexture, 0) - 1), 0).x;
+}
+
+// the velocity at cell minus the pressure gradient, like projection.frag
+vec4 project(ivec2 cell) {
+	float gX = pressureAt(cell + ivec2(1, 0)) - pressureAt(cell + ivec2(-1, 0));
+	float gY = pressureAt(cell + ivec2(0, 1)) - pressureAt(cell + ivec2(0, -1));
+
+	vec4 curr = texelFetch(velocityTexture, cell, 0);
+	return vec4(curr.x - gX / 2.0, curr.y - gY / 2.0, curr.z, curr.w);
+}
+
+void main() {
+	ivec2 cell = ivec2(gl_FragCoord.xy);
+
+	vec4 sum = vec4(0.0);
+	if (weights.x > 0.0) sum += project(cell + ivec2(-1, 0));
+	if (weights.y > 0.0) sum += project(cell + ivec2(1, 0));
+	if (weights.z > 0.0) sum += project(cell + ivec2(0, -1));
+	if (weights.w > 0.0) sum += project(cell + ivec2(0, 1));
+	vec4 average = sum / dot(weights, vec4(1.0));
+
+	// no flow through the walls
+	fragColor = vec4(-average.x, -average.y, average.z, average.w);
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+// one half pass of red black ordered SOR. only the cells of one checkerboard
+// colour are updated, their neighbours all have the other colour and keep
+// their values, so the field can be updated in place
+
+uniform sampler2D fieldTexture;		// current iterate
+uniform sampler2D rhsTexture;		// divergence for pressure, velocity before the solve for diffusion
+
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
+
+// false updates the xy velocity like diffusion.frag, true the pressure in x
+// like pressure.frag
+uniform bool pressure;
+
+uniform int parity;			// colour being updated, (x + y) % 2
+uniform float omega;		// over relaxation, 1 is plain gauss seidel
+
+// true when rendering into fieldTexture itself, the other colour is then
+// left alone. false when rendering into a second texture, it is copied
+uniform bool inPlace;
+
+void main() {
+	ivec2 cell = ivec2(gl_FragCoord.xy);
+	vec4 curr = texture(fieldTexture, texCoords);
+
+	if (((cell.x + cell.y) & 1) != parity) {
+		if (inPlace) {
+			discard;
+		}
+		fragColor = curr;
+		return;
+	}
+
+	float offsetX = texelSize.x;
+	float offsetY = texelSize.y;
+
+	vec2 sum =	texture(fieldTexture, vec2(texCoords.x - offsetX, texCoords.y)).xy + 
+				texture(fieldTexture, vec2(texCoords.x + offsetX, texCoords.y)).xy +
+				texture(fieldTexture, vec2(texCoords.x, texCoords.y - offsetY)).xy +
+				texture(fieldTexture, vec2(texCoords.x, texCoords.y + offsetY)).xy;
+
+	// x = (sum of neighbours + alpha * b) / beta
+	float alpha = pressure ? -1.0 : 1.0 / (viscosity * dt);
+	float beta = pressure ? 4.0 : 4.0 + alpha;
+
+	vec4 rhs = texture(rhsTexture, texCoords);
+	vec2 gaussSeidel = (sum + alpha * rhs.xy) / beta;
+	vec2 relaxed = mix(curr.xy, gaussSeidel, omega);
+
+	if (pressure) {
+		fragColor = vec4(relaxed.x, 0.0, 0.0, 1.0);
+	} else {
+		fragColor = vec4(relaxed, curr.z, curr.w);
+	}
+}
\ No newline at end of file
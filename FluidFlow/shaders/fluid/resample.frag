@@ -0,0 +1,14 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 texCoords;
+
+uniform sampler2D inputTexture;
+
+// multiplies xy, velocities are in cells so they scale with the grid
+uniform vec2 scale;
+
+void main() {
+	vec4 curr = texture(inputTexture, texCoords);
+	fragColor = vec4(scale * curr.xy, curr.z, curr.w);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#version 330 core
+
+// one texel per TILE x TILE block of the grid, see residual_check.h. x sums
+// the squared residual of the pressure equation over the block, y the
+// squared divergence it is measured against
+out vec4 fragColor;
+
+uniform sampler2D pressureTexture;
+uniform sampler2D divergenceTexture;	// of the velocity, see divergence.frag
+
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
+
+const int TILE = 16;
+
+float pressureAt(ivec2 cell) {
+	// clamped like the solves' fetches past the edge
+	return texelFetch(pressureTexture, clamp(cell, ivec2(0), ivec2(gridSize) - 1), 0).x;
+}
+
+void main() {
+	ivec2 tile = ivec2(gl_FragCoord.xy);
+	ivec2 start = tile * TILE;
+	ivec2 end = min(start + TILE, ivec2(gridSize));
+
+	float residual = 0.0;
+	float divergence = 0.0;
+	for (int y = start.y; y < end.y; y++) {
+		for (int x = start.x; x < end.x; x++) {
+			ivec2 cell = ivec2(x, y);
+			float sum = pressureAt(cell - ivec2(1, 0)) + pressureAt(cell + ivec2(1, 0)) +
+				pressureAt(cell - ivec2(0, 1)) + pressureAt(cell + ivec2(0, 1));
+			float rhs = texelFetch(divergenceTexture, cell, 0).x;
+
+			// what is left of pressure.frag's 4 p = sum - divergence
+			float r = sum - rhs - 4.0 * pressureAt(cell);
+			residual += r * r;
+			divergence += rhs * rhs;
+		}
+	}
+
+	fragColor = vec4(residual, divergence, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+
+out vec4 fragColor;
+in vec2 offset;
+flat in vec2 value;
+
+void main() {
+	// added to the field by the blend, so overlapping splats sum like separate
+	// passes would. the velocity and the picture both take the impulse in xy
+	fragColor = vec4(exp(-dot(offset, offset)) * value, 0.0, 0.0);
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#version 330 core
+
+// one instance per splat
+layout (location = 0) in vec4 splat;	// xy centre, zw value
+layout (location = 1) in float radius;
+
+out vec2 offset;						// from the centre, in radii
+flat out vec2 value;
+
+// the gaussian is down to exp(-9), about 1.2e-4 of its peak, three radii out.
+// nothing further is drawn
+const float EXTENT = 3.0;
+
+void main() {
+	vec2 corner = vec2((gl_VertexID & 1) == 0 ? -1.0 : 1.0, (gl_VertexID & 2) == 0 ? -1.0 : 1.0);
+
+	offset = corner * EXTENT;
+	value = splat.zw;
+	gl_Position = vec4(splat.xy + corner * EXTENT * radius, 0.0, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#version 330 core
+
+// one texel per tile of the grid, see active_tiles.h. x counts down the
+// updates the velocity of the tile stays active, y those of its picture
+out vec4 fragColor;
+
+uniform sampler2D velocityTexture;
+uniform sampler2D pictureTexture;
+uniform sampler2D previousMask;
+
+uniform vec2 thresholds;		// speed in cells per unit of dt, colour range
+uniform int hold;
+uniform bool everything;		// every tile is active, the fields just changed
+
+layout (std140) uniform FrameUniforms {
+	vec2 gridSize;			// size of the simulation fields in texels
+	vec2 texelSize;			// 1 / gridSize
+	float dt;				// 1 / Simulation::millisecondsPerFrame
+	float viscosity;
+};
+
+const int TILE = 16;
+
+void main() {
+	ivec2 tile = ivec2(gl_FragCoord.xy);
+	ivec2 start = tile * TILE;
+	ivec2 end = min(start + TILE, ivec2(gridSize));
+
+	// the picture is sampled at the cell centres, which is enough to tell an
+	// even area from one with edges in it
+	float speed = 0.0;
+	vec3 low = vec3(1.0e4);
+	vec3 high = vec3(-1.0e4);
+	for (int y = start.y; y < end.y; y++) {
+		for (int x = start.x; x < end.x; x++) {
+			speed = max(speed, length(texelFetch(velocityTexture, ivec2(x, y), 0).xy));
+
+			vec3 colour = texture(pictureTexture, (vec2(x, y) + 0.5) * texelSize).rgb;
+			low = min(low, colour);
+			high = max(high, colour);
+		}
+	}
+
+	vec2 previous = texelFetch(previousMask, tile, 0).xy;
+	bool moving = everything || speed > thresholds.x;
+	bool uneven = everything || any(greaterThan(high - low, vec3(thresholds.y)));
+
+	fragColor = vec4(moving ? float(hold) : max(previous.x - 1.0, 0.0),
+		uneven ? float(hold) : max(previous.y - 1.0, 0.0), 0.0, 1.0);
+}
\ No newline at end of file
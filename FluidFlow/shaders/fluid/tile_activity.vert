@@ -0,0 +1,8 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoords;
+
+void main() {
+	gl_Position = vec4(aPos.x, aPos.y, 0.0, 1.0);
+}
\ No newline at end of file
@@ -1,25 +1,49 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <utility>
 #include <tgmath.h>
+#ifdef _WIN32
 #include <direct.h>
+#endif
 
+#include "program_cache.h"
 #include "shader.h"
 #include "simulation.h"
+
+#ifdef _WIN32
 #include <windows.h>
+#endif
+
 
+Simulation::Simulation(int gridResolution, int dyeResolution, const std::string& restartPath,
+	const FieldFormats& formats) {
+
+	this->gridResolution = gridResolution;
+	this->dyeResolution = dyeResolution;
+	this->restartPath = restartPath;
+	this->formats = formats;
 
-Simulation::Simulation() {
 	// GLFW provides basic functionality to define an OpenGL context and application window
 	initGLFW();
 
 	width = 1000;
 	height = 1000;
 
-	// create window and set gl context
+	// create window and set gl context. the simulation draws on a hidden
+	// window's context that shares its objects with the shown one, so that
+	// the presenter's thread can have the shown window's context to itself
 	window = createWindow();
-	glfwMakeContextCurrent(window);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	simulationContext = glfwCreateWindow(1, 1, "", NULL, window);
+	glfwMakeContextCurrent(simulationContext);
+	glfwSetWindowUserPointer(window, this);
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
 
 	/* Checks if GLAD is initialized. GLAD fetches the actual implementations of the OpenGL functions used
@@ -29,261 +53,1016 @@ Simulation::Simulation() {
 		std::cout << "Failed to initialize GLAD" << std::endl;
 	}
 
-	glViewport(0, 0, width, height);
+	profiler.create();
 
 	// sets framebufferSizeCallback to be called when window resized
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
-	// load shaders
-	shader = Shader("shaders/vertex_shader.vert", "shaders/fragment_shader.frag");	// draws on picture texture
-	backgroundShader = Shader("shaders/background_shader.vert", "shaders/background_shader.frag");	// background for the picture texture
-	pictureShader = Shader("shaders/fluid/picture_shader.vert", "shaders/fluid/picture_shader.frag");	// computes new picture from vel field
-	screenShader = Shader("shaders/window.vert", "shaders/window.frag");	// puts resulting picture on the actual window
-
-	initialVField = Shader("shaders/fluid/initial_vfield.vert", "shaders/fluid/initial_vfield.frag");	// initial v field
-	advectionShader = Shader("shaders/fluid/advection.vert", "shaders/fluid/advection.frag");		// advection for vel field
-	diffusionShader = Shader("shaders/fluid/diffusion.vert", "shaders/fluid/diffusion.frag");		// viscous diffusion
-	force_shader = Shader("shaders/fluid/force_shader.vert", "shaders/fluid/force_shader.frag");		// external forces
-	pressureShader = Shader("shaders/fluid/pressure.vert", "shaders/fluid/pressure.frag");		// solves for pressure field
-	projectionShader = Shader("shaders/fluid/projection.vert", "shaders/fluid/projection.frag");		// subtracts grad pressure field
-	boundaryShader = Shader("shaders/fluid/boundary.vert", "shaders/fluid/boundary.frag");		// subtracts grad pressure field
-
+	// the mouse goes to inputQueue as it comes, the cursor has to be known
+	// before the first press
+	double x, y;
+	glfwGetCursorPos(window, &x, &y);
+	cursorX = (float)x;
+	cursorY = (float)y;
+	glfwSetCursorPosCallback(window, cursorPositionCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+
+	// every program starts compiling here, the first use of each waits for it
+	auto shadersStart = std::chrono::steady_clock::now();
+	ProgramCache::open();
+	loadShaders();
+
+	configureShaders();
+
+	fitBudget();
+	fieldSize(this->gridResolution, gridWidth, gridHeight);
+	fieldSize(this->dyeResolution, dyeWidth, dyeHeight);
+
+	// one buffer for the per frame constants, bound to the FrameUniforms block of every program
+	glGenBuffers(1, &frameUniformBuffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, frameUniformBuffer);
+	updateFrameUniforms();
 
 	loadFramebuffers();
 
 	screenVAO = windowQuad();
 	background = sceneBackground();
 
-	drawInitialPicture();
-	drawInitialVelField();
-	drawInitialPressureField();
+	multigrid.create(gridWidth, gridHeight, screenVAO);
+	if (ComputeSolver::supported()) {
+		computeSolver.create();
+	}
+	redBlackSolver.create(screenVAO, ComputeSolver::supported());
+	splatBatch.create();
+	activeTiles.create(screenVAO);
+	activeTiles.resize(gridWidth, gridHeight);
+	residualCheck.create(screenVAO);
+	residualCheck.resize(gridWidth, gridHeight);
+	boundaryCells.create();
+	boundaryCells.resize(gridWidth, gridHeight);
+	presenter.create();
+
+	std::cout << "Shaders ready in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - shadersStart).count()
+		<< " ms, " << ProgramCache::loaded << " programs from the cache and " << ProgramCache::compiled << " compiled" << std::endl;
+	reportMemory();
+
+	if (!restored) {
+		drawInitialPicture();
+		drawInitialVelField();
+		drawInitialPressureField();
+	}
 }
 
 
 void Simulation::run() {
+	if (solverBackend == SolverBackend::COMPUTE && !ComputeSolver::supported()) {
+		std::cout << "Compute shaders need OpenGL 4.3, using the fragment solver" << std::endl;
+		solverBackend = SolverBackend::FRAGMENT;
+	}
+
+	// the display thread shows the newest picture at its own pace, the swap
+	// never waits for the steps and the steps never wait for the swap
+	presenter.start(window, vsync ? 1 : 0, targetFps);
+
+	double stepSeconds = 1.0 / stepsPerSecond;
+	double accumulator = stepSeconds;	// so the first frame shows a step
+	double previousTime = glfwGetTime();
+
+	int frame = 0;
+
+	if (!exportPath.empty()) {
+		frameExporter.start(exportPath, dyeWidth, dyeHeight);
+	}
+
 	while (!glfwWindowShouldClose(window)) {
+		profiler.beginFrame();
+
+		profiler.begin("input");
 		processInput(window);
 		glfwGetWindowSize(window, &width, &height);
+		if (resized) {
+			resize();
+		}
+
+		updateFrameUniforms();
+		double inputTime = glfwGetTime();
+		profiler.end();
+
+		// run as many fixed steps as real time has passed. a frame that took
+		// longer than maxSubsteps steps drops the rest instead of making the
+		// next frame even slower
+		double time = glfwGetTime();
+		accumulator += time - previousTime;
+		previousTime = time;
+
+		int substeps = 0;
+		while (accumulator >= stepSeconds && substeps < maxSubsteps) {
+			// the step takes the mouse events of its own stretch of real time
+			stepInputTime = time - accumulator + stepSeconds;
+			step();
+			accumulator -= stepSeconds;
+			substeps++;
+
+			if (checkpointInterval > 0 && stepCount % checkpointInterval == 0) {
+				saveCheckpoint();
+			}
+		}
+		if (accumulator >= stepSeconds) {
+			droppedSeconds += accumulator - fmod(accumulator, stepSeconds);
+			accumulator = fmod(accumulator, stepSeconds);
+		}
+
+		// a pass without a step has no new picture to show
+		if (substeps > 0) {
+			// the latency counts from the oldest mouse event the picture shows
+			profiler.begin("present");
+			presentFrame(firstEventTime >= 0.0 ? firstEventTime : inputTime);
+			firstEventTime = -1.0;
+			profiler.end();
+
+			if (frameExporter.active()) {
+				profiler.begin("export");
+				frameExporter.capture(picture);
+				profiler.end();
+			}
+		}
+
+		// hands a finished checkpoint readback to the writer thread
+		checkpointWriter.update();
+
+		profiler.endFrame();
+
+		// the numbers behind the overlay bars, a few times a second is enough
+		if (profiler.enabled && profiler.overlay && ++frame % 30 == 0) {
+			glfwSetWindowTitle(window, profiler.summary().c_str());
+		}
+
+		// handles the window's events until the next step is due, input that
+		// arrives in between is read right away for it
+		double untilStep = previousTime + stepSeconds - accumulator - glfwGetTime();
+		if (untilStep > 0.0) {
+			glfwWaitEventsTimeout(untilStep);
+		}
+		else {
+			glfwPollEvents();
+		}
+	}
+
+	presenter.stop();
+	checkpointWriter.finish();
+	frameExporter.finish();
+
+	if (droppedSeconds > 0.0) {
+		std::cout << "Dropped " << droppedSeconds << " s of simulation time on frames over "
+			<< maxSubsteps << " steps" << std::endl;
+	}
+	if (inputQueue.dropped() > 0) {
+		std::cout << "Dropped " << inputQueue.dropped() << " mouse events on a full input queue" << std::endl;
+	}
+	reportSolves();
+	presenter.report();
+	profiler.writeReports();
+}
+
+
+void Simulation::runScenario(const Scenario& scenario, const std::string& timingsPath) {
+	if (solverBackend == SolverBackend::COMPUTE && !ComputeSolver::supported()) {
+		std::cout << "Compute shaders need OpenGL 4.3, using the fragment solver" << std::endl;
+		solverBackend = SolverBackend::FRAGMENT;
+	}
+
+	if (scenario.viscosity >= 0.0f) {
+		viscosity = scenario.viscosity;
+	}
+	if (scenario.millisecondsPerFrame > 0.0f) {
+		millisecondsPerFrame = scenario.millisecondsPerFrame;
+	}
+	if (scenario.diffusionIterations >= 0) {
+		diffusionIterations = scenario.diffusionIterations;
+	}
+	if (scenario.pressureIterations >= 0) {
+		pressureIterations = scenario.pressureIterations;
+	}
+	updateFrameUniforms();
+
+	// a restart keeps the checkpoint's fields
+	if (!restored && scenario.initial != ScenarioInitial::DEFAULT) {
+		for (int i = 0; i < 2; i++) {
+			glBindFramebuffer(GL_FRAMEBUFFER, velocity.writeFramebuffer());
+			glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+			velocity.swap();
+
+			if (scenario.initial == ScenarioInitial::EMPTY) {
+				glBindFramebuffer(GL_FRAMEBUFFER, picture.writeFramebuffer());
+				glClear(GL_COLOR_BUFFER_BIT);
+				picture.swap();
+			}
+		}
+	}
+
+	scripted = true;
+
+	// a restart picks the timeline up at the checkpoint's step, which a
+	// checkpoint of a run of the same scenario counts from its start
+	int firstStep = restored ? (int)std::min(stepCount, (unsigned long long)scenario.steps) : 0;
+	int runSteps = scenario.steps - firstStep;
+
+	// a timestamp before the first step and after every step. the queries are
+	// reused in a ring and a result is only read once the ring comes back
+	// around, by then the gpu is long done with it
+	const int TIMESTAMP_RING = 16;
+	unsigned int timestampQueries[TIMESTAMP_RING];
+	glGenQueries(TIMESTAMP_RING, timestampQueries);
+
+	std::vector<unsigned long long> timestamps;
+	std::vector<double> cpuMilliseconds;
+	std::vector<std::pair<int, int>> solveIterations;	// pressure and diffusion
+	timestamps.reserve(runSteps + 1);
+	cpuMilliseconds.reserve(runSteps);
+	solveIterations.reserve(runSteps);
+
+	auto resolve = [&](int index) {
+		GLuint64 time = 0;
+		glGetQueryObjectui64v(timestampQueries[index % TIMESTAMP_RING], GL_QUERY_RESULT, &time);
+		timestamps.push_back(time);
+	};
+
+	// every step of a replay is a frame of the export, none is dropped
+	if (!exportPath.empty()) {
+		frameExporter.dropFrames = false;
+		frameExporter.start(exportPath, dyeWidth, dyeHeight);
+	}
+
+	glFinish();
+	auto start = std::chrono::steady_clock::now();
+	glQueryCounter(timestampQueries[0], GL_TIMESTAMP);
+
+	int steps = 0;
+	while (steps < runSteps) {
+		// nothing from the window changes the run, it only has to stay responsive
+		if (steps % 60 == 0) {
+			glfwPollEvents();
+			processInput(window);
+			if (glfwWindowShouldClose(window)) {
+				break;
+			}
+		}
+
+		stepImpulses.clear();
+		for (const ScenarioImpulse& impulse : scenario.impulses) {
+			if (impulse.activeAt(firstStep + steps)) {
+				stepImpulses.push_back(impulse);
+			}
+		}
+
+		auto stepStart = std::chrono::steady_clock::now();
+		profiler.beginFrame();
+		step();
+		profiler.endFrame();
+
+		steps++;
+		if (steps >= TIMESTAMP_RING) {
+			resolve(steps - TIMESTAMP_RING);
+		}
+		glQueryCounter(timestampQueries[steps % TIMESTAMP_RING], GL_TIMESTAMP);
+		cpuMilliseconds.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stepStart).count());
+		solveIterations.push_back(std::make_pair(stepPressureIterations, stepDiffusionIterations));
 
-		double x, y;
-		glfwGetCursorPos(window, &x, &y);
-		forceX = (float)x;
-		forceY = (float)y;
+		if (frameExporter.active()) {
+			frameExporter.capture(picture);
+		}
+
+		if (checkpointInterval > 0 && stepCount % checkpointInterval == 0) {
+			saveCheckpoint();
+		}
+		checkpointWriter.update();
+	}
+
+	glFinish();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	for (int i = (int)timestamps.size(); i <= steps; i++) {
+		resolve(i);
+	}
+	glDeleteQueries(TIMESTAMP_RING, timestampQueries);
+
+	scripted = false;
+	checkpointWriter.finish();
+	frameExporter.finish();
+
+	std::vector<double> gpuMilliseconds(steps);
+	for (int i = 0; i < steps; i++) {
+		gpuMilliseconds[i] = (timestamps[i + 1] - timestamps[i]) / 1000000.0;
+	}
+
+	if (!timingsPath.empty()) {
+		std::ofstream timings(timingsPath);
+		timings << "step,gpu_ms,cpu_ms,pressure_iterations,diffusion_iterations\n";
+		for (int i = 0; i < steps; i++) {
+			timings << firstStep + i << "," << gpuMilliseconds[i] << "," << cpuMilliseconds[i] << ","
+				<< solveIterations[i].first << "," << solveIterations[i].second << "\n";
+		}
+		if (!timings) {
+			std::cout << "Unable to write " << timingsPath << std::endl;
+		}
+	}
 
-		if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE) {
-			previousX = forceX;
-			previousY = forceY;
+	if (firstStep > 0) {
+		std::cout << "Continued the scenario at step " << firstStep << " of " << scenario.steps << std::endl;
+	}
+	std::cout << "Ran " << steps << " steps of " << gridWidth << "x" << gridHeight << " grid, "
+		<< dyeWidth << "x" << dyeHeight << " dye in " << seconds << " s, "
+		<< (seconds > 0.0 ? steps / seconds : 0.0) << " steps/s" << std::endl;
+	if (steps > 0) {
+		std::vector<double> sorted = gpuMilliseconds;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (double milliseconds : sorted) {
+			sum += milliseconds;
 		}
+		std::cout << "gpu ms per step: mean " << sum / steps << ", median " << sorted[steps / 2]
+			<< ", 95th " << sorted[(size_t)(steps * 0.95)] << ", max " << sorted.back() << std::endl;
+	}
+	reportSolves();
+
+	char checksums[160];
+	std::snprintf(checksums, sizeof(checksums), "checksums: velocity %016llx pressure %016llx picture %016llx",
+		(unsigned long long)fieldChecksum(velocity), (unsigned long long)fieldChecksum(pressure),
+		(unsigned long long)fieldChecksum(picture));
+	std::cout << checksums << std::endl;
+
+	// shows the final picture once
+	presenter.start(window, 0, 0.0f);
+	presentFrame(glfwGetTime());
+	presenter.stop();
+	profiler.writeReports();
+}
 
-		advection();
-		diffusion();
-		forceApplication();
-		pressureSolve();
-		projectToDivergenceFree();
-		boundaryConditions();
 
-		newImage();
-		swapToMain();
+void Simulation::step() {
+	if (sparseTiles) {
+		profiler.begin("activeTiles");
+		activeTiles.update(velocity.readTexture(), picture.readTexture(), frameUniforms.dt);
+		profiler.end();
 	}
+	tiledStep = sparseTiles && activeTiles.tiled();
+
+	if (passGraphKey != passSettings()) {
+		buildPassGraph();
+	}
+	passGraph.execute(profiler, passState);
+
+	stepCount++;
+}
+
+
+void Simulation::runPass(SimulationPass pass) {
+	if (passGraphKey != passSettings()) {
+		buildPassGraph();
+	}
+	passGraph.executeGroup((int)pass, passState);
+}
+
+
+int Simulation::passSettings() const {
+	return (int)pressureSolver | (int)diffusionSolver << 4 | (int)solverBackend << 8 | (int)fusePasses << 12 |
+		(int)(residualCheck.tolerance > 0.0f) << 16;
+}
+
+
+// the fields the passes of a step read and write
+static const unsigned int VELOCITY_FIELD = 1;
+static const unsigned int PRESSURE_FIELD = 2;
+static const unsigned int PICTURE_FIELD = 4;
+static const unsigned int DIVERGENCE_FIELD = 8;
+
+
+void Simulation::buildPassGraph() {
+	bool fragment = solverBackend == SolverBackend::FRAGMENT;
+
+	// the divergence only lives until the pressure solve
+	passGraph.clear(VELOCITY_FIELD | PRESSURE_FIELD | PICTURE_FIELD);
+
+	auto add = [this](const char* name, SimulationPass group, unsigned int reads, unsigned int writes,
+		bool ownState, std::function<void()> run) {
+		PassGraph::Pass pass;
+		pass.name = name;
+		pass.group = (int)group;
+		pass.reads = reads;
+		pass.writes = writes;
+		pass.ownState = ownState;
+		pass.run = run;
+		passGraph.add(pass);
+	};
+
+	add("advection", SimulationPass::ADVECTION, VELOCITY_FIELD, VELOCITY_FIELD, false,
+		[this]() { advection(); });
+	add("diffusion", SimulationPass::DIFFUSION, VELOCITY_FIELD, VELOCITY_FIELD,
+		!(fragment && diffusionSolver == DiffusionSolver::JACOBI), [this]() { diffusion(); });
+	add("forceApplication", SimulationPass::FORCE, VELOCITY_FIELD, VELOCITY_FIELD, true,
+		[this]() { forceApplication(); });
+
+	// multigrid works out its own right hand side on the finest level, which
+	// leaves the divergence culled unless the residual checks read it
+	unsigned int solveReads = DIVERGENCE_FIELD;
+	if (pressureSolver == PressureSolver::MULTIGRID) {
+		solveReads = VELOCITY_FIELD | (residualCheck.tolerance > 0.0f ? DIVERGENCE_FIELD : 0);
+	}
+	add("divergence", SimulationPass::PRESSURE, VELOCITY_FIELD, DIVERGENCE_FIELD, !fragment,
+		[this]() { velocityDivergence(); });
+	add("pressureSolve", SimulationPass::PRESSURE, PRESSURE_FIELD | solveReads, PRESSURE_FIELD,
+		!(fragment && pressureSolver == PressureSolver::JACOBI), [this]() { pressureSolve(); });
+
+	add("projectToDivergenceFree", SimulationPass::PROJECTION, VELOCITY_FIELD | PRESSURE_FIELD, VELOCITY_FIELD, false,
+		[this]() { projectToDivergenceFree(); });
+	add("velocityBoundary", SimulationPass::BOUNDARY, VELOCITY_FIELD, VELOCITY_FIELD, true,
+		[this]() { velocityBoundary(); });
+	add("pressureBoundary", SimulationPass::BOUNDARY, PRESSURE_FIELD, PRESSURE_FIELD, true,
+		[this]() { pressureBoundary(); });
+
+	add("newImage", SimulationPass::NEW_IMAGE, VELOCITY_FIELD | PICTURE_FIELD, PICTURE_FIELD, false,
+		[this]() { newImage(); });
+
+	// not a pass of its own for runPass(), the benchmark leaves the dye out
+	PassGraph::Pass dye;
+	dye.name = "dyeApplication";
+	dye.reads = PICTURE_FIELD;
+	dye.writes = PICTURE_FIELD;
+	dye.ownState = true;
+	dye.run = [this]() { dyeApplication(); };
+	passGraph.add(dye);
+
+	if (boundaryCells.hasObstacles() && !(fragment && pressureSolver == PressureSolver::JACOBI)) {
+		std::cout << "Only the fragment jacobi solve keeps the pressure out of obstacles" << std::endl;
+	}
+
+	if (fusePasses) {
+		PassGraph::Pass fused;
+		fused.name = "projectionBoundary";
+		fused.group = (int)SimulationPass::PROJECTION;
+		fused.run = [this]() { projectionBoundary(); };
+		passGraph.fuse("projectToDivergenceFree", "velocityBoundary", fused);
+	}
+
+	passGraph.build();
+	passGraphKey = passSettings();
+
+	std::cout << "Step passes: " << passGraph.describe() << std::endl;
+}
+
+
+void Simulation::setResolution(int gridResolution, int dyeResolution) {
+	this->gridResolution = gridResolution;
+	this->dyeResolution = dyeResolution;
+	resize();
+}
+
+
+bool Simulation::loadObstacles(const std::string& path) {
+	if (!boundaryCells.loadObstacles(path)) {
+		return false;
+	}
+	boundaryCells.resize(gridWidth, gridHeight);
+	configureObstacles();
+	std::cout << "Obstacles from " << path << ", " << boundaryCells.obstacleCount() << " cells along them" << std::endl;
+	return true;
+}
+
+
+void Simulation::configureObstacles() {
+	for (const Shader* program : { &advectionShader, &tileAdvectionShader, &projectionShader, &tileProjectionShader }) {
+		program->use();
+		program->setBool("obstacles", boundaryCells.hasObstacles());
+	}
+	glUseProgram(0);
 }
 
 
 void Simulation::advection() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediateVelocityFramebuffer);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+	passState.viewport(gridWidth, gridHeight);
+	passState.framebuffer(velocity.writeFramebuffer());
+	passState.texture(0, velocity.readTexture());
+	if (boundaryCells.hasObstacles()) {
+		passState.texture(BoundaryCells::OBSTACLE_UNIT, boundaryCells.obstacleTexture());
+	}
 
 	// advection
-	glBindVertexArray(screenVAO);
-	advectionShader.use();
-	advectionShader.setFloat("fps", millisecondsPerFrame);
-	advectionShader.setFloat("width", width);
-	advectionShader.setFloat("height", height);
+	drawPass(advectionShader, tileAdvectionShader);
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);	// unbinding VAO
-
-	swapBuffers(intermediateVelocityTexture, velocityFramebuffer);
+	velocity.swap();
 }
 
 
 void Simulation::diffusion() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediateVelocityFramebuffer);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, velocityTexture);
-	glBindVertexArray(screenVAO);
+	passState.viewport(gridWidth, gridHeight);
 
-	diffusionShader.use();
-	diffusionShader.setFloat("width", width);
-	diffusionShader.setFloat("height", height);
-	diffusionShader.setFloat("viscosity", 1.0f / 1000000.0f);
-	diffusionShader.setInt("velocityTexture", 0);
-	diffusionShader.setFloat("fps", millisecondsPerFrame);
+	int sweeps = diffusionSweeps();
+	stepDiffusionIterations = sweeps;
+	diffusionCounts.add(sweeps);
+	if (sweeps == 0) {
+		return;
+	}
 
-	for (int i = 0; i < 40; i++) {
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	if (diffusionSolver == DiffusionSolver::RED_BLACK_SOR) {
+		redBlackSolver.diffuse(velocity, diffusionFramebuffer, diffusionTexture, sweeps,
+			solverBackend == SolverBackend::COMPUTE);
+		return;
+	}
+
+	// the velocity before the solve is the right hand side of every iteration,
+	// so move it out of the field and iterate between the two field textures
+	velocity.exchangeRead(diffusionFramebuffer, diffusionTexture);
+
+	if (solverBackend == SolverBackend::COMPUTE) {
+		computeSolver.diffuse(velocity, diffusionTexture, sweeps);
+		return;
 	}
 
-	glBindVertexArray(0);	// unbinding VAO
+	passState.texture(1, diffusionTexture);
 
-	swapBuffers(intermediateVelocityTexture, velocityFramebuffer);
+	for (int i = 0; i < sweeps; i++) {
+		// the right hand side is also the initial guess
+		passState.framebuffer(velocity.writeFramebuffer());
+		passState.texture(0, i == 0 ? diffusionTexture : velocity.readTexture());
+
+		drawPass(diffusionShader, tileDiffusionShader);
+		velocity.swap();
+	}
+}
+
+
+int Simulation::diffusionSweeps() const {
+	if (residualCheck.tolerance <= 0.0f) {
+		return diffusionIterations;
+	}
+
+	// a sweep is x = (neighbours + alpha b) / (4 + alpha), started from b.
+	// the solution is within 8 / alpha of b relative to the largest velocity,
+	// and every sweep shrinks the error by 4 / (4 + alpha) at least. at the
+	// default viscosity alpha is around 3e8, and not even one sweep is needed
+	double alpha = 1.0 / ((double)viscosity * frameUniforms.dt);
+	double error = 8.0 / alpha;
+	int sweeps = 0;
+	while (error > residualCheck.tolerance && sweeps < diffusionIterations) {
+		error *= 4.0 / (4.0 + alpha);
+		sweeps++;
+	}
+	return sweeps;
 }
 
 
 void Simulation::forceApplication() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediateVelocityFramebuffer);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, velocityTexture);
-	glBindVertexArray(screenVAO);
+	passState.viewport(gridWidth, gridHeight);
 
-	force_shader.use();
-	force_shader.setInt("velocityTexture", 0);
-	force_shader.setFloat("width", width);
-	force_shader.setFloat("height", height);
-	force_shader.setFloat("fps", millisecondsPerFrame);
-	force_shader.setFloat("magnitude_x", 1000.0f * (forceX - previousX) / width);
-	force_shader.setFloat("magnitude_y", -1000.0f * (forceY - previousY) / height);
-	force_shader.setFloat("xPos", (forceX - (width / 2.0)) / (width / 2.0));
-	force_shader.setFloat("yPos", -1.0f * (forceY - (height / 2.0)) / (height / 2.0));
+	stepSplats = forceSplats;
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+	if (scripted) {
+		addImpulses(false);
+	}
+	else {
+		strokeImpulses();
+	}
 
-	swapBuffers(intermediateVelocityTexture, velocityFramebuffer);
+	// the splats land in the read side only, the passes after this have to
+	// rewrite their tiles even where nothing moved before
+	if (sparseTiles) {
+		for (const Splat& splat : stepSplats) {
+			float extent = SplatBatch::EXTENT * splat.radius;
+			activeTiles.mark(splat.x - extent, splat.y - extent, splat.x + extent, splat.y + extent);
+		}
+	}
+
+	splatBatch.apply(velocity, stepSplats);
 }
 
 
 void Simulation::dyeApplication() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediatePictureFramebuffer);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, pictureTexture);
-	glBindVertexArray(screenVAO);
+	passState.viewport(dyeWidth, dyeHeight);
+
+	stepSplats = dyeSplats;
+
+	if (scripted) {
+		addImpulses(true);
+	}
+
+	// settled tiles are not drawn by the next newImage(), so both sides need the dye
+	splatBatch.apply(picture, stepSplats, sparseTiles);
+}
 
-	force_shader.use();
-	force_shader.setInt("velocityTexture", 0);
-	force_shader.setFloat("width", width);
-	force_shader.setFloat("height", height);
-	force_shader.setFloat("fps", millisecondsPerFrame);
-	force_shader.setFloat("magnitude_x", 1.0f * (forceX - previousX) / width);
-	force_shader.setFloat("magnitude_y", -1.0f * (forceY - previousY) / height);
-	force_shader.setFloat("xPos", (previousX - (width / 2.0)) / (width / 2.0));
-	force_shader.setFloat("yPos", -1.0f * (previousY - (height / 2.0)) / (height / 2.0));
 
+void Simulation::strokeImpulses() {
+	InputEvent event;
+	while (inputQueue.peek(event) && event.time <= stepInputTime) {
+		inputQueue.pop();
+		if (firstEventTime < 0.0) {
+			firstEventTime = event.time;
+		}
+
+		switch (event.type) {
+		case InputEvent::Type::PRESS:
+			strokeDown = true;
+			strokeX = event.x;
+			strokeY = event.y;
+			strokeTravelled = 0.0f;
+			strokeMovedX = 0.0f;
+			strokeMovedY = 0.0f;
+			break;
+		case InputEvent::Type::MOVE:
+			if (strokeDown) {
+				strokeTo(event.x, event.y);
+			}
+			break;
+		case InputEvent::Type::RELEASE:
+			// the rest of the way since the last impulse is not lost
+			if (strokeDown) {
+				strokeTo(event.x, event.y);
+				if (strokeTravelled > 0.0f) {
+					strokeImpulse();
+				}
+				strokeDown = false;
+			}
+			break;
+		}
+	}
+}
+
+
+void Simulation::strokeTo(float x, float y) {
+	// in grid cells the spacing is the same along both axes
+	float cellsX = gridWidth * (x - strokeX) / width;
+	float cellsY = gridHeight * (y - strokeY) / height;
+	float length = std::sqrt(cellsX * cellsX + cellsY * cellsY);
+	if (length == 0.0f) {
+		return;
+	}
+
+	// an impulse wherever the path has gone strokeSpacing since the last one.
+	// a tenth of a cell is closer than the splats can tell apart anyway
+	float spacing = std::max(strokeSpacing, 0.1f);
+	float startX = strokeX;
+	float startY = strokeY;
+	float walked = 0.0f;
+	while (strokeTravelled + (length - walked) >= spacing) {
+		float step = spacing - strokeTravelled;
+		walked += step;
+		float nextX = startX + (x - startX) * walked / length;
+		float nextY = startY + (y - startY) * walked / length;
+		strokeMovedX += nextX - strokeX;
+		strokeMovedY += nextY - strokeY;
+		strokeX = nextX;
+		strokeY = nextY;
+		strokeImpulse();
+	}
+
+	strokeTravelled += length - walked;
+	strokeMovedX += x - strokeX;
+	strokeMovedY += y - strokeY;
+	strokeX = x;
+	strokeY = y;
+}
+
+
+void Simulation::strokeImpulse() {
+	// at the stroke's position in window coordinates, y pointing up. the
+	// force is the movement since the last impulse in grid cells
+	Splat splat;
+	splat.x = (strokeX - (width / 2.0f)) / (width / 2.0f);
+	splat.y = -1.0f * (strokeY - (height / 2.0f)) / (height / 2.0f);
+	splat.valueX = gridWidth * strokeMovedX / width;
+	splat.valueY = -gridHeight * strokeMovedY / height;
+	splat.radius = strokeRadius;
+	stepSplats.push_back(splat);
+
+	strokeTravelled = 0.0f;
+	strokeMovedX = 0.0f;
+	strokeMovedY = 0.0f;
+}
+
+
+void Simulation::drawPass(const Shader& shader, const Shader& tileShader) {
+	if (tiledStep) {
+		passState.program(tileShader);
+		activeTiles.draw();
+		// the tiles bind their own vertex array and mask unit
+		passState.invalidate();
+		return;
+	}
+
+	drawQuad(shader);
+}
+
+
+void Simulation::drawQuad(const Shader& shader) {
+	passState.program(shader);
+	passState.vertexArray(screenVAO);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);
+}
 
-	swapBuffers(intermediatePictureTexture, pictureFramebuffer);
 
+void Simulation::addImpulses(bool dye) {
+	for (const ScenarioImpulse& impulse : stepImpulses) {
+		if (impulse.dye == dye) {
+			// window coordinates like the mouse
+			Splat splat;
+			splat.x = 2.0f * impulse.x - 1.0f;
+			splat.y = 2.0f * impulse.y - 1.0f;
+			splat.valueX = impulse.valueX;
+			splat.valueY = impulse.valueY;
+			splat.radius = impulse.radius;
+			stepSplats.push_back(splat);
+		}
+	}
 }
 
 
+void Simulation::velocityDivergence() {
+	passState.viewport(gridWidth, gridHeight);
+
+	// the compute solves take it as an image, the direct solve reads it back
+	// and needs it on the framebuffer side
+	if (solverBackend == SolverBackend::COMPUTE && pressureSolver != PressureSolver::DIRECT) {
+		computeSolver.divergence(velocity.readTexture(), divergenceTexture, gridWidth, gridHeight);
+		return;
+	}
+
+	passState.framebuffer(divergenceFramebuffer);
+	passState.texture(0, velocity.readTexture());
+
+	// only the jacobi iterations stay inside the active tiles
+	if (pressureSolver == PressureSolver::JACOBI) {
+		drawPass(divergenceShader, tileDivergenceShader);
+	}
+	else {
+		drawQuad(divergenceShader);
+	}
+}
+
 
 void Simulation::pressureSolve() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediatePressureFramebuffer);
+	passState.viewport(gridWidth, gridHeight);
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, pressureTexture);
+	stepPressureIterations = 0;
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+	if (pressureSolver == PressureSolver::MULTIGRID) {
+		multigridPressureSolve();
+		return;
+	}
 
-	glBindVertexArray(screenVAO);
+	if (pressureSolver == PressureSolver::DIRECT) {
+		directPressureSolve();
+		return;
+	}
 
-	pressureShader.use();
-	pressureShader.setInt("pressureTexture", 0);
-	pressureShader.setInt("velocityTexture", 1);
-	pressureShader.setFloat("width", width);
-	pressureShader.setFloat("height", height);
+	if (residualCheck.tolerance <= 0.0f) {
+		iteratePressure(pressureIterations);
+		stepPressureIterations = pressureIterations;
+		pressureCounts.add(pressureIterations);
+		return;
+	}
 
-	for (int i = 0; i < 40; i++) {
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	// checks every interval iterations and at the end, until a check that
+	// came back says it has converged
+	int limit = residualCheck.limit(pressureIterations);
+	int iterations = 0;
+	residualCheck.begin();
+	while (iterations < limit) {
+		int chunk = std::min(std::max(residualCheck.interval, 1), limit - iterations);
+		iteratePressure(chunk);
+		iterations += chunk;
+
+		residualCheck.measure(pressure.readTexture(), divergenceTexture, iterations, iterations == limit);
+		passState.invalidate();
+		passState.viewport(gridWidth, gridHeight);
+		if (residualCheck.converged()) {
+			break;
+		}
 	}
 
-	glBindVertexArray(0);
+	stepPressureIterations = iterations;
+	pressureCounts.add(iterations);
+}
+
+
+void Simulation::multigridPressureSolve() {
+	if (residualCheck.tolerance <= 0.0f) {
+		multigrid.solve(velocity.readTexture(), pressure);
+		return;
+	}
+
+	// checks after every v cycle, which does the work of many jacobi iterations
+	int limit = residualCheck.limit(multigrid.cycles);
+	int cycles = 0;
+	residualCheck.begin();
+	multigrid.begin(velocity.readTexture(), pressure);
+	while (cycles < limit) {
+		multigrid.cycle();
+		cycles++;
+
+		residualCheck.measure(pressure.readTexture(), divergenceTexture, cycles, cycles == limit);
+		if (residualCheck.converged()) {
+			break;
+		}
+	}
+	passState.invalidate();
+	passState.viewport(gridWidth, gridHeight);
 
-	swapBuffers(intermediatePressureTexture, pressureFramebuffer);
+	stepPressureIterations = cycles;
+	pressureCounts.add(cycles);
 }
 
 
-void Simulation::projectToDivergenceFree() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediateVelocityFramebuffer);
+void Simulation::iteratePressure(int iterations) {
+	if (pressureSolver == PressureSolver::RED_BLACK_SOR) {
+		redBlackSolver.solvePressure(pressure, divergenceTexture, iterations,
+			solverBackend == SolverBackend::COMPUTE);
+	}
+	else if (solverBackend == SolverBackend::COMPUTE) {
+		computeSolver.solvePressure(pressure, divergenceTexture, iterations);
+	}
+	else {
+		jacobiPressureSolve(iterations);
+	}
+}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, pressureTexture);
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+void Simulation::jacobiPressureSolve(int iterations) {
+	passState.texture(1, divergenceTexture);
 
-	glBindVertexArray(screenVAO);
+	for (int i = 0; i < iterations; i++) {
+		passState.framebuffer(pressure.writeFramebuffer());
+		passState.texture(0, pressure.readTexture());
 
-	projectionShader.use();
-	projectionShader.setInt("pressureTexture", 0);
-	projectionShader.setInt("velocityTexture", 1);
-	projectionShader.setFloat("width", width);
-	projectionShader.setFloat("height", height);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		drawPass(pressureShader, tilePressureShader);
+		if (boundaryCells.hasObstacles()) {
+			drawCells(obstaclePressureShader, BoundaryCells::Cells::OBSTACLES);
+		}
+		pressure.swap();
+	}
+}
 
-	glBindVertexArray(0);
 
-	swapBuffers(intermediateVelocityTexture, velocityFramebuffer);
+void Simulation::directPressureSolve() {
+	size_t cells = (size_t)gridWidth * gridHeight;
+	divergenceReadback.resize(cells);
+	directPressure.resize(cells);
+
+	// drawn by velocityDivergence() just before
+	passState.framebuffer(divergenceFramebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, gridWidth, gridHeight, GL_RED, GL_FLOAT, divergenceReadback.data());
+
+	if (compareDirect) {
+		// the jacobi solve runs from the last pressure like it normally would
+		jacobiPressureSolve(pressureIterations);
+		jacobiReadback.resize(cells);
+		glBindFramebuffer(GL_FRAMEBUFFER, pressure.readFramebuffer());
+		glReadPixels(0, 0, gridWidth, gridHeight, GL_RED, GL_FLOAT, jacobiReadback.data());
+	}
+
+	dctSolver.solve(gridWidth, gridHeight, divergenceReadback.data(), directPressure.data());
+
+	if (compareDirect && directSolves % 30 == 0) {
+		// pressure is only defined up to a constant, compare without the means
+		double meanDirect = 0.0;
+		double meanJacobi = 0.0;
+		for (size_t i = 0; i < cells; i++) {
+			meanDirect += directPressure[i];
+			meanJacobi += jacobiReadback[i];
+		}
+		meanDirect /= cells;
+		meanJacobi /= cells;
+
+		double difference = 0.0;
+		double norm = 0.0;
+		for (size_t i = 0; i < cells; i++) {
+			double d = (jacobiReadback[i] - meanJacobi) - (directPressure[i] - meanDirect);
+			difference += d * d;
+			norm += (directPressure[i] - meanDirect) * (directPressure[i] - meanDirect);
+		}
+
+		std::cout << "Direct vs jacobi pressure: relative difference "
+			<< (norm > 0.0 ? std::sqrt(difference / norm) : 0.0)
+			<< ", residual direct " << DctSolver::residual(gridWidth, gridHeight, divergenceReadback.data(), directPressure.data())
+			<< ", jacobi " << DctSolver::residual(gridWidth, gridHeight, divergenceReadback.data(), jacobiReadback.data())
+			<< std::endl;
+	}
+	directSolves++;
+
+	glBindTexture(GL_TEXTURE_2D, pressure.readTexture());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, gridWidth, gridHeight, GL_RED, GL_FLOAT, directPressure.data());
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
 
-void Simulation::boundaryConditions() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediateVelocityFramebuffer);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, pressureTexture);
+void Simulation::projectToDivergenceFree() {
+	passState.viewport(gridWidth, gridHeight);
+	passState.framebuffer(velocity.writeFramebuffer());
+	passState.texture(0, pressure.readTexture());
+	passState.texture(1, velocity.readTexture());
+	if (boundaryCells.hasObstacles()) {
+		passState.texture(BoundaryCells::OBSTACLE_UNIT, boundaryCells.obstacleTexture());
+	}
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+	drawPass(projectionShader, tileProjectionShader);
+	if (boundaryCells.hasObstacles()) {
+		drawCells(projectionBoundaryShader, BoundaryCells::Cells::OBSTACLES);
+	}
 
-	glBindVertexArray(screenVAO);
+	velocity.swap();
+}
 
-	boundaryShader.use();
-	boundaryShader.setInt("inputTexture", 1);
-	boundaryShader.setFloat("width", width);
-	boundaryShader.setFloat("height", height);
-	boundaryShader.setBool("velocity", true);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediatePressureFramebuffer);
-	boundaryShader.setInt("inputTexture", 0);
-	boundaryShader.setBool("velocity", false);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+void Simulation::velocityBoundary() {
+	passState.viewport(gridWidth, gridHeight);
+	passState.framebuffer(velocity.writeFramebuffer());
+	passState.texture(1, velocity.readTexture());
 
-	glBindVertexArray(0);
-	
-	swapBuffers(intermediateVelocityTexture, velocityFramebuffer);
-	swapBuffers(intermediatePressureTexture, pressureFramebuffer);
+	passState.program(boundaryShader);
+	boundaryShader.setInt(boundaryInputTexture, 1);
+	boundaryShader.setBool(boundaryVelocity, true);
+	drawCells(boundaryShader, BoundaryCells::Cells::BORDER);
+
+	copyBorder(velocity);
 }
 
 
-void Simulation::newImage() {
-	glBindFramebuffer(GL_FRAMEBUFFER, intermediatePictureFramebuffer);
+void Simulation::pressureBoundary() {
+	passState.viewport(gridWidth, gridHeight);
+	passState.framebuffer(pressure.writeFramebuffer());
+	passState.texture(0, pressure.readTexture());
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, velocityTexture);
+	passState.program(boundaryShader);
+	boundaryShader.setInt(boundaryInputTexture, 0);
+	boundaryShader.setBool(boundaryVelocity, false);
+	drawCells(boundaryShader, BoundaryCells::Cells::BORDER);
+
+	copyBorder(pressure);
+}
 
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, pictureTexture);
 
-	glBindVertexArray(screenVAO);
-	pictureShader.use();
-	pictureShader.setInt("velocityTexture", 0);
-	pictureShader.setInt("pictureTexture", 1);
-	pictureShader.setFloat("fps", millisecondsPerFrame);
-	pictureShader.setFloat("width", width);
-	pictureShader.setFloat("height", height);
+void Simulation::projectionBoundary() {
+	passState.viewport(gridWidth, gridHeight);
+	passState.framebuffer(velocity.writeFramebuffer());
+	passState.texture(0, pressure.readTexture());
+	passState.texture(1, velocity.readTexture());
+	if (boundaryCells.hasObstacles()) {
+		passState.texture(BoundaryCells::OBSTACLE_UNIT, boundaryCells.obstacleTexture());
+	}
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0);	// unbinding VAO
+	// the boundary cells overwrite what the projection wrote there, and read
+	// the same sides it did
+	drawPass(projectionShader, tileProjectionShader);
+	drawCells(projectionBoundaryShader, BoundaryCells::Cells::ALL);
 
-	swapBuffers(intermediatePictureTexture, pictureFramebuffer);
+	velocity.swap();
 }
 
 
-void Simulation::swapToMain() {
+void Simulation::drawCells(const Shader& shader, BoundaryCells::Cells cells) {
+	passState.program(shader);
+	passState.vertexArray(boundaryCells.vertexArray());
+	boundaryCells.draw(cells);
+}
+
+
+void Simulation::copyBorder(const PingPongField& field) {
+	// the rest of the write side is out of date, so the sides stay as they are
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, field.writeFramebuffer());
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, field.readFramebuffer());
+
+	int strips[][4] = {
+		{ 0, 0, 1, gridHeight },
+		{ gridWidth - 1, 0, gridWidth, gridHeight },
+		{ 0, 0, gridWidth, 1 },
+		{ 0, gridHeight - 1, gridWidth, gridHeight }
+	};
+	for (const int* rect : strips) {
+		glBlitFramebuffer(rect[0], rect[1], rect[2], rect[3], rect[0], rect[1], rect[2], rect[3],
+			GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+void Simulation::newImage() {
+	passState.viewport(dyeWidth, dyeHeight);
+	passState.framebuffer(picture.writeFramebuffer());
+	passState.texture(0, velocity.readTexture());
+	passState.texture(1, picture.readTexture());
+
+	drawPass(pictureShader, tilePictureShader);
+
+	picture.swap();
+}
+
+
+void Simulation::presentFrame(double inputTime) {
+	// the picture is stretched over the window, the linear filter of the
+	// picture texture does the upscale
+	presenter.beginFrame(framebufferWidth, framebufferHeight);
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 
@@ -292,95 +1071,54 @@ void Simulation::swapToMain() {
 
 	glBindVertexArray(screenVAO);
 	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, pictureTexture);
+	glBindTexture(GL_TEXTURE_2D, picture.readTexture());
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-	glfwSwapBuffers(window);	// show current buffer on screen
-	glfwPollEvents();	// check if any inputs triggered aand update window state
-}
-
-
-void Simulation::swapBuffers(unsigned int sourceTexture, unsigned int targetFramebuffer) {
-	glBindFramebuffer(GL_FRAMEBUFFER, targetFramebuffer);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, sourceTexture);
-	glBindVertexArray(screenVAO);
+	profiler.drawOverlay(framebufferWidth, framebufferHeight);
 
-	screenShader.use();
-	screenShader.setBool("swappingMain", false);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	presenter.endFrame(inputTime);
 }
 
 
 void Simulation::drawInitialPressureField() {
-	for (unsigned int i : {0, 1}) {
-		unsigned int framebuffer;
-		unsigned int texture;
-		if (i == 0) {
-			framebuffer = pressureFramebuffer;
-			texture = pressureTexture;
-		}
-		else {
-			framebuffer = intermediatePressureFramebuffer;
-			texture = intermediatePressureTexture;
-		}
+	glViewport(0, 0, gridWidth, gridHeight);
 
-		// draw on the velocity framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-		glBindTexture(GL_TEXTURE_2D, texture);
+	for (int i = 0; i < 2; i++) {
+		// draw on both sides of the pressure field
+		glBindFramebuffer(GL_FRAMEBUFFER, pressure.writeFramebuffer());
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		backgroundShader.use();
 		glBindVertexArray(background);
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		pressure.swap();
 	}
 }
 
 
 void Simulation::drawInitialVelField() {
-	for (unsigned int i : {0, 1}) {
-		unsigned int framebuffer;
-		unsigned int texture;
-		if (i == 0) {
-			framebuffer = velocityFramebuffer;
-			texture = velocityTexture;
-		}
-		else {
-			framebuffer = intermediateVelocityFramebuffer;
-			texture = intermediateVelocityTexture;
-		}
+	glViewport(0, 0, gridWidth, gridHeight);
 
-		// draw on the velocity framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-		glBindTexture(GL_TEXTURE_2D, texture);
+	for (int i = 0; i < 2; i++) {
+		// draw on both sides of the velocity field
+		glBindFramebuffer(GL_FRAMEBUFFER, velocity.writeFramebuffer());
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
 		initialVField.use();
-		initialVField.setFloat("width", (float)width);
-		initialVField.setFloat("height", (float)height);
 		glBindVertexArray(initialVelocityField());
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		velocity.swap();
 	}
 }
 
 
 void Simulation::drawInitialPicture() {
-	for (unsigned int i : {0, 1}) {
-		unsigned int framebuffer;
-		unsigned int texture;
-		if (i == 0) {
-			framebuffer = pictureFramebuffer;
-			texture = pictureTexture;
-		}
-		else {
-			framebuffer = intermediatePictureFramebuffer;
-			texture = intermediatePictureTexture;
-		}
+	glViewport(0, 0, dyeWidth, dyeHeight);
 
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-		glBindTexture(GL_TEXTURE_2D, texture);
+	for (int i = 0; i < 2; i++) {
+		glBindFramebuffer(GL_FRAMEBUFFER, picture.writeFramebuffer());
 		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
@@ -391,6 +1129,7 @@ void Simulation::drawInitialPicture() {
 		shader.use();
 		glBindVertexArray(sceneData());
 		glDrawElements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, 0);
+		picture.swap();
 	}
 }
 
@@ -515,8 +1254,8 @@ unsigned int Simulation::sceneBackground() {
 }
 
 unsigned int Simulation::sceneData() {
-	float offsetX = 0.5f * 1000.0f / width;
-	float offsetY = 0.5f * 1000.0f / height;
+	float offsetX = 0.5f;
+	float offsetY = 0.5f;
 
 	float vertices[] = {
 		-offsetX, -offsetY, 0.0f,
@@ -562,59 +1301,262 @@ void Simulation::loadShaders() {
 	initialVField = Shader("shaders/fluid/initial_vfield.vert", "shaders/fluid/initial_vfield.frag");	// initial v field
 	advectionShader = Shader("shaders/fluid/advection.vert", "shaders/fluid/advection.frag");		// advection for vel field
 	diffusionShader = Shader("shaders/fluid/diffusion.vert", "shaders/fluid/diffusion.frag");		// viscous diffusion
-	force_shader = Shader("shaders/fluid/force_shader.vert", "shaders/fluid/force_shader.frag");		// external forces
 	pressureShader = Shader("shaders/fluid/pressure.vert", "shaders/fluid/pressure.frag");		// solves for pressure field
 	projectionShader = Shader("shaders/fluid/projection.vert", "shaders/fluid/projection.frag");		// subtracts grad pressure field
-	boundaryShader = Shader("shaders/fluid/boundary.vert", "shaders/fluid/boundary.frag");		// subtracts grad pressure field
+	boundaryShader = Shader("shaders/fluid/boundary_cells.vert", "shaders/fluid/boundary.frag");		// border cells from their inner neighbour
+	resampleShader = Shader("shaders/fluid/resample.vert", "shaders/fluid/resample.frag");		// moves fields to a new size
+	divergenceShader = Shader("shaders/fluid/divergence.vert", "shaders/fluid/divergence.frag");		// right hand side of the pressure solves
+	projectionBoundaryShader = Shader("shaders/fluid/boundary_cells.vert", "shaders/fluid/projection_boundary.frag");	// velocity boundary after the projection
+	obstaclePressureShader = Shader("shaders/fluid/boundary_cells.vert", "shaders/fluid/obstacle_pressure.frag");	// obstacle pressure after a jacobi iteration
+
+	// the same passes over the active tiles
+	tileAdvectionShader = Shader("shaders/fluid/active_tiles.vert", "shaders/fluid/advection.frag");
+	tileDiffusionShader = Shader("shaders/fluid/active_tiles.vert", "shaders/fluid/diffusion.frag");
+	tilePressureShader = Shader("shaders/fluid/active_tiles.vert", "shaders/fluid/pressure.frag");
+	tileProjectionShader = Shader("shaders/fluid/active_tiles.vert", "shaders/fluid/projection.frag");
+	tileDivergenceShader = Shader("shaders/fluid/active_tiles.vert", "shaders/fluid/divergence.frag");
+	tilePictureShader = Shader("shaders/fluid/active_tiles.vert", "shaders/fluid/picture_shader.frag");
+
+	// the solvers' programs build alongside, their create() waits for them
+	multigrid.loadShaders();
+	redBlackSolver.loadShaders(ComputeSolver::supported(), formats.velocity, formats.pressure);
+	splatBatch.loadShaders();
+	activeTiles.loadShaders();
+	residualCheck.loadShaders();
+	if (ComputeSolver::supported()) {
+		computeSolver.loadShaders(formats.velocity, formats.pressure);
+	}
+}
+
+
+void Simulation::configureShaders() {
+	// texture units never change, so samplers are set once
+	pictureShader.use();
+	pictureShader.setInt("velocityTexture", 0);
+	pictureShader.setInt("pictureTexture", 1);
+
+	tilePictureShader.use();
+	tilePictureShader.setInt("velocityTexture", 0);
+	tilePictureShader.setInt("pictureTexture", 1);
+	ActiveTiles::configure(tilePictureShader, true);
+
+	screenShader.use();
+	screenShader.setInt("screenTexture", 0);
+	screenShader.setBool("swappingMain", false);
+
+	advectionShader.use();
+	advectionShader.setInt("screenTexture", 0);
+	advectionShader.setInt("obstacleTexture", BoundaryCells::OBSTACLE_UNIT);
+	tileAdvectionShader.use();
+	tileAdvectionShader.setInt("screenTexture", 0);
+	tileAdvectionShader.setInt("obstacleTexture", BoundaryCells::OBSTACLE_UNIT);
+	ActiveTiles::configure(tileAdvectionShader, false);
+
+	diffusionShader.use();
+	diffusionShader.setInt("velocityTexture", 0);
+	diffusionShader.setInt("rhsTexture", 1);
+	tileDiffusionShader.use();
+	tileDiffusionShader.setInt("velocityTexture", 0);
+	tileDiffusionShader.setInt("rhsTexture", 1);
+	ActiveTiles::configure(tileDiffusionShader, false);
+
+	pressureShader.use();
+	pressureShader.setInt("pressureTexture", 0);
+	pressureShader.setInt("divergenceTexture", 1);
+	tilePressureShader.use();
+	tilePressureShader.setInt("pressureTexture", 0);
+	tilePressureShader.setInt("divergenceTexture", 1);
+	ActiveTiles::configure(tilePressureShader, false);
+
+	projectionShader.use();
+	projectionShader.setInt("pressureTexture", 0);
+	projectionShader.setInt("velocityTexture", 1);
+	projectionShader.setInt("obstacleTexture", BoundaryCells::OBSTACLE_UNIT);
+	tileProjectionShader.use();
+	tileProjectionShader.setInt("pressureTexture", 0);
+	tileProjectionShader.setInt("velocityTexture", 1);
+	tileProjectionShader.setInt("obstacleTexture", BoundaryCells::OBSTACLE_UNIT);
+	ActiveTiles::configure(tileProjectionShader, false);
+
+	projectionBoundaryShader.use();
+	projectionBoundaryShader.setInt("pressureTexture", 0);
+	projectionBoundaryShader.setInt("velocityTexture", 1);
+
+	obstaclePressureShader.use();
+	obstaclePressureShader.setInt("pressureTexture", 0);
+	obstaclePressureShader.setInt("divergenceTexture", 1);
+
+	divergenceShader.use();
+	divergenceShader.setInt("velocityTexture", 0);
+	tileDivergenceShader.use();
+	tileDivergenceShader.setInt("velocityTexture", 0);
+	ActiveTiles::configure(tileDivergenceShader, false);
+
+	resampleShader.use();
+	resampleShader.setInt("inputTexture", 0);
+	resampleScale = resampleShader.uniform("scale");
+
+	boundaryInputTexture = boundaryShader.uniform("inputTexture");
+	boundaryVelocity = boundaryShader.uniform("velocity");
+
+	glUseProgram(0);
+}
+
+
+void Simulation::updateFrameUniforms() {
+	frameUniforms.gridSize[0] = (float)gridWidth;
+	frameUniforms.gridSize[1] = (float)gridHeight;
+	frameUniforms.texelSize[0] = 1.0f / gridWidth;
+	frameUniforms.texelSize[1] = 1.0f / gridHeight;
+
+	frameUniforms.dt = 1.0f / millisecondsPerFrame;
+	frameUniforms.viscosity = viscosity;
+	frameUniforms.padding[0] = 0.0f;
+	frameUniforms.padding[1] = 0.0f;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUniformBuffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frameUniforms);
 }
 
 
 void Simulation::loadFramebuffers() {
-	createFramebuffer(pictureFramebuffer, pictureTexture);
-	
-	createFramebuffer(intermediatePictureFramebuffer, intermediatePictureTexture);
-	
-	createFramebuffer(velocityFramebuffer, velocityTexture);
-	
-	createFramebuffer(intermediateVelocityFramebuffer, intermediateVelocityTexture);
-	
-	createFramebuffer(pressureFramebuffer, pressureTexture);
-	
-	createFramebuffer(intermediatePressureFramebuffer, intermediatePressureTexture);
+	// a restart creates the fields at the checkpoint's sizes, resize() moves
+	// them to the window's afterwards
+	CheckpointReader checkpoint;
+	bool restart = !restartPath.empty() && openCheckpoint(checkpoint);
+
+	picture.create(dyeWidth, dyeHeight, formats.picture);
+	velocity.create(gridWidth, gridHeight, formats.velocity);
+	pressure.create(gridWidth, gridHeight, formats.pressure);
+
+	// swapped with velocity's read side, so it has the velocity's format
+	PingPongField::createTarget(diffusionFramebuffer, diffusionTexture, gridWidth, gridHeight, formats.velocity);
+
+	// the solves read the right hand side at full precision whatever the
+	// pressure is stored in
+	PingPongField::createTarget(divergenceFramebuffer, divergenceTexture, gridWidth, gridHeight, GL_R32F);
+
+	if (restart) {
+		restored = loadCheckpoint(checkpoint);
+	}
 }
 
 
-void Simulation::createFramebuffer(unsigned int& framebuffer, unsigned int& textureBuffer) {
-	glGenFramebuffers(1, &framebuffer);
-	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+bool Simulation::openCheckpoint(CheckpointReader& checkpoint) {
+	if (!checkpoint.open(restartPath)) {
+		return false;
+	}
 
-	glGenTextures(1, &textureBuffer);
-	glBindTexture(GL_TEXTURE_2D, textureBuffer);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	const CheckpointHeader& header = checkpoint.header();
+	const CheckpointBlock* fields[] = {
+		checkpoint.block(CheckpointField::VELOCITY),
+		checkpoint.block(CheckpointField::PRESSURE),
+		checkpoint.block(CheckpointField::PICTURE)
+	};
+	for (int i = 0; i < 3; i++) {
+		int fieldWidth = i < 2 ? header.gridWidth : header.dyeWidth;
+		int fieldHeight = i < 2 ? header.gridHeight : header.dyeHeight;
+		if (fields[i] == NULL || fields[i]->width != fieldWidth || fields[i]->height != fieldHeight) {
+			std::cout << "Checkpoint " << restartPath << " is missing fields, starting over" << std::endl;
+			checkpoint.close();
+			return false;
+		}
+	}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	gridWidth = header.gridWidth;
+	gridHeight = header.gridHeight;
+	dyeWidth = header.dyeWidth;
+	dyeHeight = header.dyeHeight;
+	return true;
+}
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+bool Simulation::loadCheckpoint(CheckpointReader& checkpoint) {
+	auto start = std::chrono::steady_clock::now();
 
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureBuffer, 0);
+	bool loaded = checkpoint.upload(*checkpoint.block(CheckpointField::VELOCITY), velocity.readTexture()) &&
+		checkpoint.upload(*checkpoint.block(CheckpointField::PRESSURE), pressure.readTexture()) &&
+		checkpoint.upload(*checkpoint.block(CheckpointField::PICTURE), picture.readTexture());
+	if (!loaded) {
+		std::cout << "Checkpoint " << restartPath << " is damaged, starting over" << std::endl;
+		return false;
+	}
+	glFinish();
+
+	const CheckpointHeader& header = checkpoint.header();
+	stepCount = header.step;
+	millisecondsPerFrame = header.millisecondsPerFrame;
+	viscosity = header.viscosity;
+	diffusionIterations = header.diffusionIterations;
+	pressureIterations = header.pressureIterations;
+	updateFrameUniforms();
+
+	// a window of another shape resamples the fields on the first frame
+	int windowGridWidth, windowGridHeight, windowDyeWidth, windowDyeHeight;
+	fieldSize(gridResolution, windowGridWidth, windowGridHeight);
+	fieldSize(dyeResolution, windowDyeWidth, windowDyeHeight);
+	if (windowGridWidth != gridWidth || windowGridHeight != gridHeight ||
+		windowDyeWidth != dyeWidth || windowDyeHeight != dyeHeight) {
+		resized = true;
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Restarted from step " << stepCount << " of " << restartPath << " in " << milliseconds << " ms" << std::endl;
+	return true;
+}
 
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+
+void Simulation::saveCheckpoint() {
+	CheckpointHeader header = {};
+	header.step = stepCount;
+	header.millisecondsPerFrame = millisecondsPerFrame;
+	header.viscosity = viscosity;
+	header.diffusionIterations = diffusionIterations;
+	header.pressureIterations = pressureIterations;
+	header.gridResolution = gridResolution;
+	header.dyeResolution = dyeResolution;
+	header.gridWidth = gridWidth;
+	header.gridHeight = gridHeight;
+	header.dyeWidth = dyeWidth;
+	header.dyeHeight = dyeHeight;
+
+	// every field in its own format, exact and no larger than it is on the
+	// gpu. a restart with other formats converts them on upload
+	auto native = [](CheckpointField field, const PingPongField& source) {
+		CheckpointWriter::Source native = { field, &source, GL_RGBA, GL_HALF_FLOAT };
+		PingPongField::pixelFormat(source.format, native.format, native.type);
+		return native;
+	};
+	std::vector<CheckpointWriter::Source> fields = {
+		native(CheckpointField::VELOCITY, velocity),
+		native(CheckpointField::PRESSURE, pressure),
+		native(CheckpointField::PICTURE, picture)
+	};
+	checkpointWriter.save(checkpointPath, header, fields);
 }
 
 
 void Simulation::processInput(GLFWwindow* window) {
 	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, true);
+
+	// one checkpoint per press
+	bool saveKey = glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS;
+	if (saveKey && !saveKeyDown) {
+		saveCheckpoint();
+	}
+	saveKeyDown = saveKey;
 }
 
 
 GLFWwindow* Simulation::createWindow() {
 	GLFWwindow* window = glfwCreateWindow(width, height, "LearnOpenGL", NULL, NULL);
+	if (window == NULL) {
+		// no 4.3 for the compute solver, everything else runs on 3.3
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		window = glfwCreateWindow(width, height, "LearnOpenGL", NULL, NULL);
+	}
 	if (window == NULL) {
 		std::cout << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
@@ -625,13 +1567,251 @@ GLFWwindow* Simulation::createWindow() {
 
 void Simulation::initGLFW() {
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 }
 
 
 void Simulation::framebufferSizeCallback(GLFWwindow* window, int width, int height) {
-	width = width;
-	glViewport(0, 0, width, height);
+	Simulation* sim = (Simulation*)glfwGetWindowUserPointer(window);
+
+	// minimized windows report 0x0, keep the fields as they are
+	if (sim == NULL || width == 0 || height == 0) {
+		return;
+	}
+	sim->framebufferWidth = width;
+	sim->framebufferHeight = height;
+	sim->resized = true;
+}
+
+
+void Simulation::cursorPositionCallback(GLFWwindow* window, double x, double y) {
+	Simulation* sim = (Simulation*)glfwGetWindowUserPointer(window);
+	if (sim == NULL) {
+		return;
+	}
+	sim->cursorX = (float)x;
+	sim->cursorY = (float)y;
+
+	InputEvent event;
+	event.type = InputEvent::Type::MOVE;
+	event.time = glfwGetTime();
+	event.x = (float)x;
+	event.y = (float)y;
+	sim->inputQueue.push(event);
+}
+
+
+void Simulation::mouseButtonCallback(GLFWwindow* window, int button, int action, int /*mods*/) {
+	Simulation* sim = (Simulation*)glfwGetWindowUserPointer(window);
+	if (sim == NULL || button != GLFW_MOUSE_BUTTON_LEFT) {
+		return;
+	}
+
+	InputEvent event;
+	event.type = action == GLFW_PRESS ? InputEvent::Type::PRESS : InputEvent::Type::RELEASE;
+	event.time = glfwGetTime();
+	event.x = sim->cursorX;
+	event.y = sim->cursorY;
+	sim->inputQueue.push(event);
+}
+
+
+void Simulation::fieldSize(int resolution, int& fieldWidth, int& fieldHeight) const {
+	// resolution cells along the shorter side, square cells
+	if (framebufferWidth <= framebufferHeight) {
+		fieldWidth = resolution;
+		fieldHeight = (int)std::lround((double)resolution * framebufferHeight / framebufferWidth);
+	}
+	else {
+		fieldHeight = resolution;
+		fieldWidth = (int)std::lround((double)resolution * framebufferWidth / framebufferHeight);
+	}
+}
+
+
+size_t Simulation::fieldBytes() const {
+	return fieldBytes(gridWidth, gridHeight, dyeWidth, dyeHeight);
+}
+
+
+size_t Simulation::fieldBytes(int gridWidth, int gridHeight, int dyeWidth, int dyeHeight) const {
+	size_t cells = (size_t)gridWidth * gridHeight;
+
+	// two sides of every field, plus the diffusion and divergence targets
+	return 3 * cells * PingPongField::texelBytes(formats.velocity) +
+		2 * cells * PingPongField::texelBytes(formats.pressure) +
+		cells * PingPongField::texelBytes(GL_R32F) +
+		2 * (size_t)dyeWidth * dyeHeight * PingPongField::texelBytes(formats.picture) +
+		Multigrid::bytes(gridWidth, gridHeight);
+}
+
+
+void Simulation::fitBudget() {
+	int newGridWidth, newGridHeight, newDyeWidth, newDyeHeight;
+	fieldSize(gridResolution, newGridWidth, newGridHeight);
+	fieldSize(dyeResolution, newDyeWidth, newDyeHeight);
+	size_t bytes = fieldBytes(newGridWidth, newGridHeight, newDyeWidth, newDyeHeight);
+	if (formats.budget == 0 || bytes <= formats.budget) {
+		return;
+	}
+
+	// the memory goes with the square of the resolutions, so one scale gets
+	// close and the rest is rounding
+	int oldGridResolution = gridResolution;
+	int oldDyeResolution = dyeResolution;
+	while (bytes > formats.budget && gridResolution > 8 && dyeResolution > 8) {
+		double scale = std::min(std::sqrt((double)formats.budget / bytes), 0.99);
+		gridResolution = std::max(8, (int)(gridResolution * scale));
+		dyeResolution = std::max(8, (int)(dyeResolution * scale));
+
+		fieldSize(gridResolution, newGridWidth, newGridHeight);
+		fieldSize(dyeResolution, newDyeWidth, newDyeHeight);
+		bytes = fieldBytes(newGridWidth, newGridHeight, newDyeWidth, newDyeHeight);
+	}
+
+	std::cout << "Fields need more than the " << formats.budget / (1024.0 * 1024.0) << " MB budget, grid resolution "
+		<< oldGridResolution << " -> " << gridResolution << ", dye resolution "
+		<< oldDyeResolution << " -> " << dyeResolution << std::endl;
+}
+
+
+void Simulation::reportMemory() const {
+	std::cout << "Field memory " << fieldBytes() / (1024.0 * 1024.0) << " MB: velocity "
+		<< gridWidth << "x" << gridHeight << " " << PingPongField::formatName(formats.velocity)
+		<< ", pressure " << PingPongField::formatName(formats.pressure)
+		<< ", picture " << dyeWidth << "x" << dyeHeight << " " << PingPongField::formatName(formats.picture);
+	if (formats.budget > 0) {
+		std::cout << ", budget " << formats.budget / (1024.0 * 1024.0) << " MB";
+	}
+	std::cout << std::endl;
+}
+
+
+void Simulation::reportSolves() const {
+	// a fixed number of iterations is no news
+	if (residualCheck.tolerance <= 0.0f) {
+		return;
+	}
+
+	if (pressureSolver == PressureSolver::DIRECT) {
+		std::cout << "Pressure solves were direct and exact, the tolerance only applied to the diffusion" << std::endl;
+	}
+	else if (pressureCounts.solves > 0) {
+		bool cycles = pressureSolver == PressureSolver::MULTIGRID;
+		std::cout << "Pressure solves used " << pressureCounts.mean() << (cycles ? " v cycles" : " iterations")
+			<< " on average, " << pressureCounts.fewest << " to " << pressureCounts.most << " of "
+			<< (cycles ? multigrid.cycles : pressureIterations)
+			<< ", relative residual " << residualCheck.lastResidual() << " at the last check" << std::endl;
+	}
+	if (diffusionCounts.solves > 0) {
+		std::cout << "Diffusion solves used " << diffusionCounts.mean() << " iterations on average, "
+			<< diffusionCounts.fewest << " to " << diffusionCounts.most << " of " << diffusionIterations << std::endl;
+	}
+}
+
+
+void SolveCounts::add(int used) {
+	fewest = solves > 0 ? std::min(fewest, used) : used;
+	most = solves > 0 ? std::max(most, used) : used;
+	solves++;
+	iterations += used;
+}
+
+
+bool FieldFormats::set(const std::string& field, const std::string& name) {
+	GLenum format = PingPongField::parseFormat(name);
+	int channels = PingPongField::channels(format);
+	bool floating = format != GL_RGBA8;
+
+	// the velocity is signed and the solves need float, the picture is colour
+	if (field == "velocity" && channels >= 2 && floating) {
+		velocity = format;
+	}
+	else if (field == "pressure" && channels >= 1 && floating) {
+		pressure = format;
+	}
+	else if (field == "picture" && channels == 4) {
+		picture = format;
+	}
+	else {
+		std::cout << "Unknown " << field << " format " << name << ", expected "
+			<< (field == "velocity" ? "rg16f, rg32f, rgba16f or rgba32f" :
+				field == "pressure" ? "r16f, r32f, rg16f, rg32f, rgba16f or rgba32f" : "rgba8, rgba16f or rgba32f")
+			<< std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+void Simulation::resize() {
+	resized = false;
+	fitBudget();
+
+	int newGridWidth, newGridHeight, newDyeWidth, newDyeHeight;
+	fieldSize(gridResolution, newGridWidth, newGridHeight);
+	fieldSize(dyeResolution, newDyeWidth, newDyeHeight);
+
+	bool reallocated = newGridWidth != gridWidth || newGridHeight != gridHeight ||
+		newDyeWidth != dyeWidth || newDyeHeight != dyeHeight;
+
+	if (newGridWidth != gridWidth || newGridHeight != gridHeight) {
+		// velocities are in cells, so they stretch with the cell count
+		resample(velocity, newGridWidth, newGridHeight,
+			(float)newGridWidth / gridWidth, (float)newGridHeight / gridHeight);
+		resample(pressure, newGridWidth, newGridHeight, 1.0f, 1.0f);
+
+		glDeleteFramebuffers(1, &diffusionFramebuffer);
+		glDeleteTextures(1, &diffusionTexture);
+		PingPongField::createTarget(diffusionFramebuffer, diffusionTexture, newGridWidth, newGridHeight,
+			formats.velocity);
+
+		glDeleteFramebuffers(1, &divergenceFramebuffer);
+		glDeleteTextures(1, &divergenceTexture);
+		PingPongField::createTarget(divergenceFramebuffer, divergenceTexture, newGridWidth, newGridHeight, GL_R32F);
+
+		multigrid.resize(newGridWidth, newGridHeight);
+		activeTiles.resize(newGridWidth, newGridHeight);
+		residualCheck.resize(newGridWidth, newGridHeight);
+		boundaryCells.resize(newGridWidth, newGridHeight);
+
+		gridWidth = newGridWidth;
+		gridHeight = newGridHeight;
+	}
+
+	if (newDyeWidth != dyeWidth || newDyeHeight != dyeHeight) {
+		resample(picture, newDyeWidth, newDyeHeight, 1.0f, 1.0f);
+		activeTiles.invalidate();
+
+		dyeWidth = newDyeWidth;
+		dyeHeight = newDyeHeight;
+	}
+
+	if (reallocated) {
+		reportMemory();
+	}
+	updateFrameUniforms();
+}
+
+
+void Simulation::resample(PingPongField& field, int newWidth, int newHeight, float scaleX, float scaleY) {
+	PingPongField resampled;
+	resampled.create(newWidth, newHeight, field.format);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, resampled.writeFramebuffer());
+	glViewport(0, 0, newWidth, newHeight);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, field.readTexture());
+	glBindVertexArray(screenVAO);
+
+	resampleShader.use();
+	resampleShader.setVec2(resampleScale, scaleX, scaleY);
+	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+
+	resampled.swap();
+	field.destroy();
+	field = resampled;
 }
\ No newline at end of file
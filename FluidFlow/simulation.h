@@ -2,58 +2,330 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <string>
 #include <tgmath.h>
+#include <vector>
+#ifdef _WIN32
 #include <direct.h>
+#endif
 
+#include "active_tiles.h"
+#include "boundary_cells.h"
+#include "checkpoint.h"
+#include "compute_solver.h"
+#include "dct_solver.h"
+#include "field.h"
+#include "frame_exporter.h"
+#include "input_queue.h"
 #include "shader.h"
+#include "multigrid.h"
+#include "pass_graph.h"
+#include "presenter.h"
+#include "profiler.h"
+#include "red_black_solver.h"
+#include "residual_check.h"
+#include "scenario.h"
+#include "splat_batch.h"
+
+// cpu side of the std140 FrameUniforms block declared in the fluid shaders,
+// member order and padding have to match
+struct FrameUniforms {
+	float gridSize[2];
+	float texelSize[2];
+	float dt;
+	float viscosity;
+	float padding[2];			// std140 rounds the block up to a vec4
+};
+
+// what runs the jacobi iterations of the diffusion and pressure solves
+enum class SolverBackend {
+	FRAGMENT,				// one full screen draw per iteration
+	COMPUTE					// tiled compute dispatches, see compute_solver.h. needs GL 4.3
+};
+
+// how Simulation::pressureSolve() solves the pressure poisson equation
+enum class PressureSolver {
+	JACOBI,					// pressure.frag iterations
+	MULTIGRID,				// v cycles over a texture pyramid, see multigrid.h
+	RED_BLACK_SOR,			// in place over relaxed gauss seidel, see red_black_solver.h
+	DIRECT					// exact DCT solve on the cpu, see dct_solver.h
+};
+
+// how Simulation::diffusion() solves the viscous diffusion
+enum class DiffusionSolver {
+	JACOBI,
+	RED_BLACK_SOR
+};
+
+// the passes of Simulation::step() in order, for timing them one at a time
+enum class SimulationPass {
+	ADVECTION,
+	DIFFUSION,
+	FORCE,
+	PRESSURE,
+	PROJECTION,
+	BOUNDARY,
+	NEW_IMAGE
+};
+
+// internal formats of the fields, see field.h for the ones there are, and the
+// most video memory they may take together. the divergence the pressure
+// solves read is always GL_R32F
+struct FieldFormats {
+	GLenum velocity = GL_RG16F;		// xy
+	GLenum pressure = GL_R32F;		// x, full float since the solves accumulate into it
+	GLenum picture = GL_RGBA16F;	// rgba, GL_RGBA8 quarters the largest field
+	size_t budget = 0;				// bytes, 0 for no limit. resolutions shrink to fit
+
+	// sets the format of field, "velocity", "pressure" or "picture", from its
+	// name. prints why and returns false if the format can't hold that field
+	bool set(const std::string& field, const std::string& name);
+};
+
+// iterations the solves of a run used
+struct SolveCounts {
+	long long solves = 0;
+	long long iterations = 0;
+	int fewest = 0;
+	int most = 0;
+
+	void add(int used);
+	double mean() const { return solves > 0 ? (double)iterations / solves : 0.0; }
+};
 
 class Simulation {
 public:
 	// self explanatory
 	float millisecondsPerFrame = 1000.0f/3.0f;
+	float viscosity = 1.0f / 1000000.0f;
+
+	// every step advances the fluid by 1 / millisecondsPerFrame, and steps run
+	// at a fixed rate of real time however fast frames are shown
+	float stepsPerSecond = 60.0f;
+	int maxSubsteps = 4;			// per pass of the input loop, slower passes drop time
+
+	// pacing of the display thread, which shows the newest picture while the
+	// steps go on at stepsPerSecond. targetFps of 0 leaves the rate to vsync,
+	// or to the driver when vsync is off
+	bool vsync = true;
+	float targetFps = 0.0f;
+
+	// the most iterations of each solve. with a tolerance in residualCheck
+	// the jacobi and SOR pressure solves stop once they have converged, so do
+	// multigrid's v cycles, and the diffusion only runs the sweeps its
+	// coefficient leaves any work for.
+	// both start from what they solve for, the last step's pressure and the
+	// velocity before the solve
+	int diffusionIterations = 40;
+	int pressureIterations = 40;
+	ResidualCheck residualCheck;
+
+	SolverBackend solverBackend = SolverBackend::FRAGMENT;
+	ComputeSolver computeSolver;
+
+	DiffusionSolver diffusionSolver = DiffusionSolver::JACOBI;
+	PressureSolver pressureSolver = PressureSolver::JACOBI;
+	Multigrid multigrid;
+	RedBlackSolver redBlackSolver;
+	DctSolver dctSolver;
+
+	// draws the advection, jacobi, projection, boundary and picture passes
+	// over the moving tiles only, see active_tiles.h. the other solvers
+	// still cover the whole grid
+	bool sparseTiles = false;
+	ActiveTiles activeTiles;
+
+	// draws the velocity boundary into the projection's target, see
+	// projection_boundary.frag, instead of as a pass of its own
+	bool fusePasses = true;
+
+	// with the direct solver, also run the jacobi solve every step and print
+	// how far apart the two pressures are
+	bool compareDirect = false;
+
+	// stage timings, see profiler.h
+	Profiler profiler;
+
+	// checkpoints of the fields, see checkpoint.h. F5 saves one, and every
+	// checkpointInterval steps when that is above 0
+	std::string checkpointPath = "checkpoint.ffc";
+	int checkpointInterval = 0;
+	CheckpointWriter checkpointWriter;
+
+	// a mouse stroke adds an impulse every strokeSpacing grid cells along its
+	// path, each the movement since the one before, of strokeRadius in window
+	// coordinates
+	float strokeSpacing = 2.0f;
+	float strokeRadius = 0.0316f;
+
+	// impulses every step adds to the velocity and the picture, besides the
+	// mouse and the scenario's. all of a field's go in one draw, see splat_batch.h
+	std::vector<Splat> forceSplats;
+	std::vector<Splat> dyeSplats;
+	SplatBatch splatBatch;
 
-	// constructor
-	Simulation();
+	// every picture handed to the presenter, or every step of a scenario, is
+	// streamed to exportPath when it is set, at the picture size of the first
+	// frame. see frame_exporter.h
+	std::string exportPath;
+	FrameExporter frameExporter;
+
+	// constructor. the velocity and pressure grid has gridResolution cells
+	// along the shorter side of the window and the picture has dyeResolution
+	// texels, both keep the window's aspect ratio. a restartPath continues
+	// from that checkpoint instead of the initial fields. the fields have the
+	// formats of formats, at lower resolutions if they don't fit its budget
+	Simulation(int gridResolution = 256, int dyeResolution = 1024, const std::string& restartPath = "",
+		const FieldFormats& formats = FieldFormats());
 
 	// runs the simulation
 	void run();
 
+	// replays scenario as fast as the gpu goes, without input or vsync. prints
+	// the step timings and the checksums of the final fields, and writes the
+	// timing of every step to timingsPath when it is set. after a restart it
+	// runs the steps from the checkpoint's step to the scenario's end. every
+	// step is exported when exportPath is set, which the timings include
+	void runScenario(const Scenario& scenario, const std::string& timingsPath = "");
+
+	// one fixed step, the passes of the pass graph in order
+	void step();
+	// the passes of step() that make up pass, on their own
+	void runPass(SimulationPass pass);
+
+	// reallocates the fields for new resolutions, like a window resize would
+	void setResolution(int gridResolution, int dyeResolution);
+
+	// keeps the fluid out of the solid cells of a mask, see boundary_cells.h.
+	// the advection, the fragment jacobi pressure solve and the projection
+	// respect it. prints why and returns false when the mask can't be read
+	bool loadObstacles(const std::string& path);
+
+	int fieldWidth() const { return gridWidth; }
+	int fieldHeight() const { return gridHeight; }
+	int pictureWidth() const { return dyeWidth; }
+	int pictureHeight() const { return dyeHeight; }
+	const FieldFormats& fieldFormats() const { return formats; }
+
+	// video memory of the fields, the solve targets and the multigrid pyramid
+	// at the current sizes
+	size_t fieldBytes() const;
+
 private:
 
+	// window size in screen coordinates, for the mouse
 	int width;
 	int height;
 
-	GLFWwindow* window;
+	// window size in pixels, set by framebufferSizeCallback
+	int framebufferWidth;
+	int framebufferHeight;
+	bool resized = false;
+
+	// cells along the shorter side of the window
+	int gridResolution;
+	int dyeResolution;
+
+	FieldFormats formats;
+
+	// current field sizes
+	int gridWidth;
+	int gridHeight;
+	int dyeWidth;
+	int dyeHeight;
+
+	GLFWwindow* window;					// shown, its context belongs to the presenter's thread
+	GLFWwindow* simulationContext;		// hidden, shares window's objects and runs everything else
+
+	Presenter presenter;
+
+	double droppedSeconds = 0.0;		// real time not simulated because of maxSubsteps
+
+	unsigned long long stepCount = 0;	// steps since the start, kept across restarts
+	std::string restartPath;
+	bool restored = false;				// fields came from the restart checkpoint
+	bool saveKeyDown = false;
 
 	unsigned int screenVAO;				// quad that covers whole screen
 	unsigned int background;
 
-	void loadShaders();					// load the shaders
+	void loadShaders();					// starts building every program, the solvers' too
+	void configureShaders();			// sampler units and uniform handles, once after loading
+	void updateFrameUniforms();			// uploads the FrameUniforms block for this frame
 	void loadFramebuffers();			// load the framebuffers and textures
-	void createFramebuffer(unsigned int& framebuffer, unsigned int& textureBuffer);
+	bool openCheckpoint(CheckpointReader& checkpoint);	// restartPath, takes its field sizes
+	bool loadCheckpoint(CheckpointReader& checkpoint);	// fills the new fields from it
+	void saveCheckpoint();				// starts writing the fields to checkpointPath
+
+	// size of a field with resolution cells along the shorter window side
+	void fieldSize(int resolution, int& fieldWidth, int& fieldHeight) const;
+	// fieldBytes() of fields of these sizes
+	size_t fieldBytes(int gridWidth, int gridHeight, int dyeWidth, int dyeHeight) const;
+	// lowers the resolutions until the fields at the window's aspect fit the budget
+	void fitBudget();
+	// prints the memory of the fields
+	void reportMemory() const;
+	// reallocates the fields that changed size after the window was resized
+	void resize();
+	// replaces field by a newWidth x newHeight copy, xy multiplied by the scale
+	void resample(PingPongField& field, int newWidth, int newHeight, float scaleX, float scaleY);
 
 	void drawInitialPicture();			// initial picture
 	void drawInitialVelField();			// initial velocity field
 	void drawInitialPressureField();	// initial pressure field
 
-	// swaps two buffers (intermediate vel field and target vel field for instance)
-	void swapBuffers(unsigned int sourceTexture, 
-		unsigned int targetFramebuffer);
+	// the passes of a step, in the order buildPassGraph() adds them. each
+	// binds through passState and sets its own viewport
+	PassGraph passGraph;
+	PassState passState;
+	int passGraphKey = -1;				// the settings the graph was built for
+	int passSettings() const;			// the settings that change the graph
+	void buildPassGraph();
 
 	// terms of Navier Stokes eqn
 	void advection();
 	void diffusion();
+	int diffusionSweeps() const;		// the ones the diffusion needs, at most diffusionIterations
 	void forceApplication();
+	void velocityDivergence();			// the right hand side of the pressure solves
 	void pressureSolve();
+	void iteratePressure(int iterations);	// of the jacobi or SOR solve
+	void multigridPressureSolve();		// checks the residual between v cycles with a tolerance
+	void jacobiPressureSolve(int iterations);	// of pressure.frag
+	void directPressureSolve();			// reads back the divergence, uploads the DCT solution
 	void projectToDivergenceFree();
-	void boundaryConditions();
+	void velocityBoundary();
+	void pressureBoundary();
+	void projectionBoundary();			// the last three in one pass when fusePasses is set
+
+	// the border and the obstacles, drawn as points over the cells they hold
+	BoundaryCells boundaryCells;
+	void drawCells(const Shader& shader, BoundaryCells::Cells cells);
+	// copies the border of the write side of field to its read side, after
+	// the border cells were drawn into the write side
+	void copyBorder(const PingPongField& field);
+	// sets whether the programs that respect obstacles sample their mask
+	void configureObstacles();
 
 	void dyeApplication();
 
+	// impulses of the current scripted step, which replace the mouse
+	bool scripted = false;
+	std::vector<ScenarioImpulse> stepImpulses;
+	std::vector<Splat> stepSplats;		// what forceApplication() and dyeApplication() draw
+	void addImpulses(bool dye);			// the scenario's of this step to stepSplats
+
+	// draws a pass with shader over the whole target, or with tileShader, its
+	// twin on active_tiles.vert, over the active tiles in a tiled step
+	bool tiledStep = false;				// sparseTiles and few enough tiles move
+	void drawPass(const Shader& shader, const Shader& tileShader);
+	void drawQuad(const Shader& shader);	// over the whole target in any step
+
 	// compute new image using current image and vel field
 	void newImage();
-	// draws pictureFramebuffer on actual screen
-	void swapToMain();
+	// draws the picture and the overlay into the presenter's next frame and
+	// publishes it, inputTime is when the input it shows was read
+	void presentFrame(double inputTime);
 
 	unsigned int sceneData();
 	unsigned int sceneBackground();
@@ -67,31 +339,65 @@ private:
 	void processInput(GLFWwindow* window);
 
 
-	// for computing forces from mouse movement
-	float forceX;
-	float forceY;
+	// the mouse comes in through the callbacks, which push events to
+	// inputQueue, and every step takes the events up to stepInputTime
+	static void cursorPositionCallback(GLFWwindow* window, double x, double y);
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	InputQueue inputQueue;
+	float cursorX = 0.0f;				// the callbacks', where a press happens
+	float cursorY = 0.0f;
+	double stepInputTime = 0.0;			// real time the current step ends at
+	double firstEventTime = -1.0;		// of the oldest event since the last presentFrame(), -1 for none
+
+	// the stroke the steps have followed so far, in screen coordinates
+	bool strokeDown = false;
+	float strokeX = 0.0f;
+	float strokeY = 0.0f;
+	float strokeTravelled = 0.0f;		// grid cells since the last impulse
+	float strokeMovedX = 0.0f;			// window coordinates since the last impulse
+	float strokeMovedY = 0.0f;
 
-	float previousX;
-	float previousY;
+	// the impulses along the strokes up to stepInputTime, to stepSplats
+	void strokeImpulses();
+	void strokeTo(float x, float y);
+	void strokeImpulse();
 
-	// framebuffers and textures
-	unsigned int pictureFramebuffer;
-	unsigned int pictureTexture;
+	// per frame constants shared by all programs through one uniform buffer
+	FrameUniforms frameUniforms;
+	unsigned int frameUniformBuffer;
 
-	unsigned int intermediatePictureFramebuffer;
-	unsigned int intermediatePictureTexture;
+	// uniforms that change between draws
+	Shader::Uniform boundaryInputTexture;
+	Shader::Uniform boundaryVelocity;
+	Shader::Uniform resampleScale;
 
-	unsigned int velocityFramebuffer;
-	unsigned int velocityTexture;
+	// fields, each pass reads one side and writes the other
+	PingPongField picture;
+	PingPongField velocity;
+	PingPongField pressure;
 
-	unsigned int intermediateVelocityFramebuffer;
-	unsigned int intermediateVelocityTexture;
+	// right hand side of the diffusion solve, swapped in and out of velocity
+	unsigned int diffusionFramebuffer;
+	unsigned int diffusionTexture;
 
-	unsigned int pressureFramebuffer;
-	unsigned int pressureTexture;
+	// divergence of the velocity before the pressure solve, GL_R32F
+	unsigned int divergenceFramebuffer;
+	unsigned int divergenceTexture;
 
-	unsigned int intermediatePressureFramebuffer;
-	unsigned int intermediatePressureTexture;
+	// cpu copies for the direct pressure solve
+	std::vector<float> divergenceReadback;
+	std::vector<float> directPressure;
+	std::vector<float> jacobiReadback;
+	int directSolves = 0;
+
+	// iterations of the solves, this step's for the timings and the run's to
+	// print at the end. multigrid counts its v cycles when it checks the
+	// residual and 0 otherwise, the direct solve always 0
+	int stepPressureIterations = 0;
+	int stepDiffusionIterations = 0;
+	SolveCounts pressureCounts;
+	SolveCounts diffusionCounts;
+	void reportSolves() const;
 
 	Shader shader;						// draws on picture texture
 	Shader backgroundShader;			// background for the picture texture
@@ -101,9 +407,20 @@ private:
 	Shader initialVField;				// initial v field
 	Shader advectionShader;				// advection for vel field
 	Shader diffusionShader;				// viscous diffusion
-	Shader force_shader;				// external forces
 	Shader pressureShader;				// solves for pressure field
 	Shader projectionShader;			// subtracts grad pressure field
-	Shader boundaryShader;				// subtracts grad pressure field
+	Shader boundaryShader;				// the border cells take their inner neighbour
+	Shader projectionBoundaryShader;	// velocity boundary in the projection's target
+	Shader obstaclePressureShader;		// obstacle pressure in a jacobi iteration's target
+	Shader resampleShader;				// copies a field into one of another size
+	Shader divergenceShader;			// divergence of the velocity for the pressure solves
+
+	// the passes sparseTiles draws, over the active tiles
+	Shader tileAdvectionShader;
+	Shader tileDiffusionShader;
+	Shader tilePressureShader;
+	Shader tileProjectionShader;
+	Shader tileDivergenceShader;
+	Shader tilePictureShader;
 
 };
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "splat_batch.h"
+
+#include <cstddef>
+
+
+SplatBatch::SplatBatch() {}
+
+
+void SplatBatch::loadShaders() {
+	splatShader = Shader("shaders/fluid/splat.vert", "shaders/fluid/splat.frag");
+}
+
+
+void SplatBatch::create() {
+	glGenVertexArrays(1, &splatVAO);
+	glGenBuffers(1, &instanceBuffer);
+
+	// the quad corners come from gl_VertexID, only the splats are attributes
+	glBindVertexArray(splatVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Splat), (void*)offsetof(Splat, x));
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(Splat), (void*)offsetof(Splat, radius));
+	glVertexAttribDivisor(0, 1);
+	glVertexAttribDivisor(1, 1);
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+
+	glBindVertexArray(0);
+}
+
+
+void SplatBatch::apply(PingPongField& field, const std::vector<Splat>& splats, bool bothSides) {
+	if (splats.empty()) {
+		return;
+	}
+
+	// orphans the last batch, which the gpu may still be reading
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+	if (splats.size() > capacity) {
+		capacity = splats.size() * 2;
+	}
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Splat), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, splats.size() * sizeof(Splat), splats.data());
+
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_ONE, GL_ONE);
+
+	glBindVertexArray(splatVAO);
+	splatShader.use();
+
+	// nothing is sampled, so the read side can be the target
+	glBindFramebuffer(GL_FRAMEBUFFER, field.readFramebuffer());
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)splats.size());
+	if (bothSides) {
+		glBindFramebuffer(GL_FRAMEBUFFER, field.writeFramebuffer());
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)splats.size());
+	}
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+}
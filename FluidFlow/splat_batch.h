@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "field.h"
+#include "shader.h"
+
+// one gaussian impulse, in window coordinates like the mouse
+struct Splat {
+	float x = 0.0f;				// centre, -1 to 1 across the window
+	float y = 0.0f;
+	float valueX = 0.0f;		// added at the centre, a velocity in grid cells or red and green dye
+	float valueY = 0.0f;
+	float radius = 0.0316f;		// where the impulse falls to 1/e, in window coordinates
+};
+
+// adds any number of splats to a field in one instanced draw. each splat is
+// a quad over its own neighbourhood only, and the blend adds it to the field
+// in place, so there is no full screen pass and no swap however many there are
+class SplatBatch {
+public:
+	// the gaussian is down to exp(-9), about 1.2e-4 of its peak, this many
+	// radii out, nothing further is drawn. same as EXTENT in splat.vert
+	static const int EXTENT = 3;
+
+	SplatBatch();
+
+	// starts building the program, before create()
+	void loadShaders();
+
+	// allocates the instance buffer
+	void create();
+
+	// adds splats to the read side of field, and to the write side too with
+	// bothSides. the viewport has to cover the field
+	void apply(PingPongField& field, const std::vector<Splat>& splats, bool bothSides = false);
+
+private:
+	Shader splatShader;
+
+	unsigned int splatVAO = 0;
+	unsigned int instanceBuffer = 0;
+	size_t capacity = 0;				// splats instanceBuffer holds
+};
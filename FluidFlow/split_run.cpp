@@ -0,0 +1,204 @@
+#include "split_run.h"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "cpu_simulation.h"
+#endif
+
+
+#ifdef __linux__
+namespace {
+
+// a barrier for processes that share the memory it is in. the last to
+// arrive starts the next generation and wakes the others, which spin on it
+// for a while first since the sweep of a strip is short
+struct SharedBarrier {
+	static const int SPINS = 4096;
+
+	std::atomic<uint32_t> arrived;
+	std::atomic<uint32_t> generation;
+	uint32_t parties;
+
+	void wait() {
+		uint32_t current = generation.load(std::memory_order_acquire);
+		if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == parties) {
+			arrived.store(0, std::memory_order_relaxed);
+			generation.fetch_add(1, std::memory_order_release);
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&generation), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+			return;
+		}
+
+		for (int spin = 0; spin < SPINS; spin++) {
+			if (generation.load(std::memory_order_acquire) != current) {
+				return;
+			}
+		}
+		// the kernel only sleeps while the generation is still current
+		while (generation.load(std::memory_order_acquire) == current) {
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&generation), FUTEX_WAIT, current, NULL, NULL, 0);
+		}
+	}
+};
+
+// start of the segment, the planes follow at HEADER_BYTES
+struct SegmentHeader {
+	SharedBarrier barrier;
+	double seconds;						// of the steps, measured by the first worker
+	int picturePlanes[3];				// where the picture ended up after the swaps
+};
+
+const size_t HEADER_BYTES = 4096;
+
+int work(SegmentHeader* header, float* planes, int width, int height, int rowBegin, int rowEnd,
+	int steps, unsigned int threads, KernelIsa isa) {
+
+	// the constructor waits for every strip to be drawn
+	CpuSimulation sim(width, height, planes, rowBegin, rowEnd, [header]() { header->barrier.wait(); }, threads);
+	sim.useKernels(isa);
+
+	// every step ends waiting for the others, so the first worker's time is the run's
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < steps; i++) {
+		sim.step();
+	}
+
+	if (rowBegin == 0) {
+		header->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		size_t stride = CpuSimulation::planeStride(width, height);
+		for (int channel = 0; channel < 3; channel++) {
+			header->picturePlanes[channel] = (int)((sim.getPicture(channel) - planes) / stride);
+		}
+	}
+	return 0;
+}
+
+}
+#endif
+
+
+SplitRun::SplitRun() {}
+
+
+bool SplitRun::run(int width, int height, int steps, const std::string& output) {
+#ifndef __linux__
+	std::cout << "Runs split over processes need linux" << std::endl;
+	return false;
+#else
+	int workerCount = std::min(std::max(processes, 1), height);
+	unsigned int threads = threadsPerProcess > 0 ? threadsPerProcess :
+		std::max(std::thread::hardware_concurrency() / workerCount, 1u);
+
+	size_t stride = CpuSimulation::planeStride(width, height);
+	size_t bytes = HEADER_BYTES + CpuSimulation::PLANES * stride * sizeof(float);
+
+	// unlinked as soon as it is mapped, so nothing is left in /dev/shm however the run ends
+	std::string name = "/fluidflow-" + std::to_string(getpid());
+	int descriptor = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (descriptor < 0) {
+		std::cout << "Unable to create shared memory " << name << std::endl;
+		return false;
+	}
+	void* mapping = MAP_FAILED;
+	if (ftruncate(descriptor, (off_t)bytes) == 0) {
+		mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+	}
+	shm_unlink(name.c_str());
+	close(descriptor);
+	if (mapping == MAP_FAILED) {
+		std::cout << "Unable to map " << bytes / (1024.0 * 1024.0) << " MB of shared memory" << std::endl;
+		return false;
+	}
+
+	SegmentHeader* header = new (mapping) SegmentHeader();
+	header->barrier.arrived = 0;
+	header->barrier.generation = 0;
+	header->barrier.parties = (uint32_t)workerCount;
+	float* planes = (float*)((char*)mapping + HEADER_BYTES);
+
+	std::cout << "Running " << steps << " steps on a " << width << "x" << height << " grid split over "
+		<< workerCount << " processes of " << threads << " threads" << std::endl;
+
+	// anything still buffered would be written again by every worker
+	std::cout.flush();
+
+	std::vector<pid_t> running;
+	bool ok = true;
+	for (int i = 0; i < workerCount; i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			_exit(work(header, planes, width, height, height * i / workerCount, height * (i + 1) / workerCount,
+				steps, threads, isa));
+		}
+		if (pid < 0) {
+			std::cout << "Unable to start worker " << i << std::endl;
+			ok = false;
+			break;
+		}
+		running.push_back(pid);
+	}
+
+	// a worker that is gone leaves the others waiting at the barrier for good
+	if (!ok) {
+		for (pid_t worker : running) {
+			kill(worker, SIGKILL);
+		}
+	}
+	while (!running.empty()) {
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if (pid < 0) {
+			break;
+		}
+		running.erase(std::remove(running.begin(), running.end(), pid), running.end());
+
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+			continue;
+		}
+		if (ok) {
+			if (WIFSIGNALED(status)) {
+				std::cout << "Worker " << pid << " was killed by signal " << WTERMSIG(status);
+			}
+			else {
+				std::cout << "Worker " << pid << " failed";
+			}
+			std::cout << ", stopping the others" << std::endl;
+		}
+		ok = false;
+		for (pid_t worker : running) {
+			kill(worker, SIGKILL);
+		}
+	}
+
+	if (ok) {
+		double seconds = header->seconds;
+		std::cout << seconds * 1000.0 / (steps > 0 ? steps : 1) << " ms per step, "
+			<< (seconds > 0.0 ? (double)width * height * steps / seconds / 1.0e6 : 0.0) << " Mcells/s" << std::endl;
+
+		if (!output.empty()) {
+			ok = CpuSimulation::writePicture(output, width, height, planes + header->picturePlanes[0] * stride,
+				planes + header->picturePlanes[1] * stride, planes + header->picturePlanes[2] * stride);
+		}
+	}
+
+	munmap(mapping, bytes);
+	return ok;
+#endif
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+#include "fluid_kernels.h"
+
+// runs one CpuSimulation over several worker processes, for grids too large
+// for the threads of one process to keep up with, like one worker per socket.
+// the grid is split into horizontal strips of rows, one per worker.
+//
+// every plane lives once in a POSIX shared memory segment, so a strip reads
+// its neighbours' rows in place instead of copying halos. that also covers
+// the advection, whose backtrace can land further than one cell away. the
+// workers wait for each other on a futex barrier in the segment after every
+// pass that reads another strip's rows, which is every jacobi sweep. each
+// worker writes its own rows first, so their pages end up on its memory node.
+//
+// the coordinator only forks the workers, waits for them and gathers the
+// picture from the segment when they are done. linux only
+class SplitRun {
+public:
+	int processes = 2;
+	unsigned int threadsPerProcess = 0;	// 0 splits the hardware threads between the processes
+	KernelIsa isa = KernelIsa::SCALAR;
+
+	SplitRun();
+
+	// runs steps steps of a width x height grid and writes the picture to
+	// output when it is set. prints the timing, false if a worker failed
+	bool run(int width, int height, int steps, const std::string& output);
+};
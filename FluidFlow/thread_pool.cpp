@@ -0,0 +1,160 @@
+#include "thread_pool.h"
+
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount == 0) {
+		threadCount = 1;
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++) {
+		queues.push_back(std::make_unique<Queue>());
+	}
+
+	// the caller of parallelFor is the last worker, so spawn one thread less
+	for (unsigned int i = 0; i + 1 < threadCount; i++) {
+		threads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+
+unsigned int ThreadPool::size() const {
+	return (unsigned int)queues.size();
+}
+
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& task) {
+	if (count <= 0) {
+		return;
+	}
+
+	if (queues.size() == 1) {
+		for (int i = 0; i < count; i++) {
+			task(i);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> jobLock(jobMutex);
+
+	job = &task;
+	remaining = count;
+
+	// contiguous chunks keep neighbouring tiles on the same thread
+	int threadCount = (int)queues.size();
+	for (int i = 0; i < threadCount; i++) {
+		std::lock_guard<std::mutex> lock(queues[i]->mutex);
+		queues[i]->begin = (int)((long long)count * i / threadCount);
+		queues[i]->end = (int)((long long)count * (i + 1) / threadCount);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		generation++;
+	}
+	wake.notify_all();
+
+	work(threadCount - 1);
+
+	std::unique_lock<std::mutex> lock(wakeMutex);
+	done.wait(lock, [this] { return remaining == 0; });
+	job = nullptr;
+}
+
+
+void ThreadPool::workerLoop(unsigned int index) {
+	unsigned long long seen = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wake.wait(lock, [this, seen] { return stopping || generation != seen; });
+			if (stopping) {
+				return;
+			}
+			seen = generation;
+		}
+
+		work(index);
+	}
+}
+
+
+void ThreadPool::work(unsigned int index) {
+	int taskIndex;
+
+	while (true) {
+		while (pop(index, taskIndex)) {
+			(*job)(taskIndex);
+
+			if (remaining.fetch_sub(1) == 1) {
+				std::lock_guard<std::mutex> lock(wakeMutex);
+				done.notify_all();
+			}
+		}
+
+		if (!steal(index)) {
+			return;
+		}
+	}
+}
+
+
+bool ThreadPool::pop(unsigned int index, int& taskIndex) {
+	Queue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+
+	if (queue.begin >= queue.end) {
+		return false;
+	}
+
+	taskIndex = queue.begin++;
+	return true;
+}
+
+
+bool ThreadPool::steal(unsigned int index) {
+	unsigned int count = (unsigned int)queues.size();
+
+	for (unsigned int offset = 1; offset < count; offset++) {
+		Queue& victim = *queues[(index + offset) % count];
+
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			int available = victim.end - victim.begin;
+			if (available <= 0) {
+				continue;
+			}
+
+			// take the back half so the owner keeps working through its front
+			int take = (available + 1) / 2;
+			begin = victim.end - take;
+			end = victim.end;
+			victim.end = begin;
+		}
+
+		Queue& own = *queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		own.begin = begin;
+		own.end = end;
+		return true;
+	}
+
+	return false;
+}
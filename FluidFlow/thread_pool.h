@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// work stealing thread pool used by the cpu solver. every parallelFor splits
+// its index range evenly over the per thread queues, threads pop indices from
+// the front of their own queue and steal half of another queue's remaining
+// range when they run dry
+class ThreadPool {
+public:
+	// threadCount of 0 uses every hardware thread
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// calls task(i) for every i in [0, count) and returns once all are done.
+	// the calling thread takes part in the work
+	void parallelFor(int count, const std::function<void(int)>& task);
+
+	// number of threads working on a parallelFor, including the caller
+	unsigned int size() const;
+
+private:
+	// range of indices still to be run by one thread
+	struct Queue {
+		std::mutex mutex;
+		int begin = 0;
+		int end = 0;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Queue>> queues;		// one per thread, the caller owns the last
+
+	const std::function<void(int)>* job = nullptr;
+	std::atomic<int> remaining{ 0 };
+
+	std::mutex jobMutex;				// serializes parallelFor calls
+	std::mutex wakeMutex;
+	std::condition_variable wake;		// signals workers that a new job started
+	std::condition_variable done;		// signals the caller that remaining hit 0
+	unsigned long long generation = 0;
+	bool stopping = false;
+
+	void workerLoop(unsigned int index);
+	void work(unsigned int index);		// runs tasks until no queue has any left
+	bool pop(unsigned int index, int& taskIndex);
+	bool steal(unsigned int index);
+};
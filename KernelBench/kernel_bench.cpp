@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "fluid_kernels.h"
+#include "thread_pool.h"
+
+// microbenchmark of the FluidKernels. runs every kernel with every instruction
+// set the cpu supports and reports texels per second and the bandwidth of the
+// kernel's compulsory traffic, every plane it touches read or written once.
+// write allocates and the rows a stencil reads twice are not counted, so the
+// GB/s figure is a lower bound of what the memory system actually moved.
+// before timing, every vector version is checked against the scalar one
+// usage: KernelBench [--size width height] [--threads n] [--seconds s]
+
+
+// the planes the kernels read and write, filled like the simulation's start
+struct Grid {
+	int width;
+	int height;
+
+	AlignedPlane velocityX;
+	AlignedPlane velocityY;
+	AlignedPlane pressure;
+	AlignedPlane divergence;
+	AlignedPlane red;
+	AlignedPlane green;
+	AlignedPlane blue;
+
+	// written by the kernels
+	AlignedPlane outX;
+	AlignedPlane outY;
+	AlignedPlane outZ;
+
+	Grid(int width, int height) : width(width), height(height) {
+		size_t cells = (size_t)width * height;
+		for (AlignedPlane* plane : { &velocityX, &velocityY, &pressure, &divergence,
+			&red, &green, &blue, &outX, &outY, &outZ }) {
+			plane->assign(cells, 0.0f);
+		}
+
+		// the swirl of initial_vfield.frag and a smooth pressure and picture
+		for (int y = 0; y < height; y++) {
+			float locY = 2.0f * (y + 0.5f) / height - 1.0f;
+			for (int x = 0; x < width; x++) {
+				float locX = 2.0f * (x + 0.5f) / width - 1.0f;
+				size_t i = (size_t)y * width + x;
+
+				velocityX[i] = 450.0f * std::sin(2.0f * 3.1415f * locY);
+				velocityY[i] = 450.0f * std::sin(2.0f * 3.1415f * locX);
+				pressure[i] = std::cos(5.0f * locX) * std::sin(3.0f * locY);
+				divergence[i] = std::sin(7.0f * locX * locY);
+				red[i] = 0.5f + 0.5f * std::sin(13.0f * locX);
+				green[i] = 0.5f + 0.5f * std::sin(11.0f * locY);
+				blue[i] = locX * locY;
+			}
+		}
+		reset();
+	}
+
+	// puts the planes the in place kernels modify back to their start
+	void reset() {
+		outX = velocityX;
+		outY = velocityY;
+		outZ = pressure;
+	}
+};
+
+
+struct Case {
+	const char* name;
+	double bytesPerTexel;
+	bool perimeter;				// only works on the border texels
+	std::function<void(const FluidKernels&, Grid&, int, int)> run;		// over rows [y0, y1)
+	std::vector<AlignedPlane Grid::*> outputs;
+};
+
+
+static std::vector<Case> cases() {
+	// advection.frag's step with the default millisecondsPerFrame moves the
+	// velocity above by up to 1.35 texels
+	const float scale = 3.0f / 1000.0f;
+
+	std::vector<Case> list;
+	list.push_back({ "advect velocity", 16.0, false, [=](const FluidKernels& k, Grid& g, int y0, int y1) {
+		const float* sources[] = { g.velocityX.data(), g.velocityY.data() };
+		float* targets[] = { g.outX.data(), g.outY.data() };
+		k.advect(g.velocityX.data(), g.velocityY.data(), scale, sources, targets, 2,
+			g.width, g.height, 0, y0, g.width, y1);
+	}, { &Grid::outX, &Grid::outY } });
+
+	list.push_back({ "advect dye", 32.0, false, [=](const FluidKernels& k, Grid& g, int y0, int y1) {
+		const float* sources[] = { g.red.data(), g.green.data(), g.blue.data() };
+		float* targets[] = { g.outX.data(), g.outY.data(), g.outZ.data() };
+		k.advect(g.velocityX.data(), g.velocityY.data(), scale, sources, targets, 3,
+			g.width, g.height, 0, y0, g.width, y1);
+	}, { &Grid::outX, &Grid::outY, &Grid::outZ } });
+
+	list.push_back({ "jacobi", 12.0, false, [](const FluidKernels& k, Grid& g, int y0, int y1) {
+		k.jacobi(g.pressure.data(), g.divergence.data(), g.outZ.data(), -1.0f, 0.25f,
+			g.width, g.height, 0, y0, g.width, y1);
+	}, { &Grid::outZ } });
+
+	list.push_back({ "divergence", 12.0, false, [](const FluidKernels& k, Grid& g, int y0, int y1) {
+		k.divergence(g.velocityX.data(), g.velocityY.data(), g.outZ.data(),
+			g.width, g.height, 0, y0, g.width, y1);
+	}, { &Grid::outZ } });
+
+	list.push_back({ "project", 20.0, false, [](const FluidKernels& k, Grid& g, int y0, int y1) {
+		k.project(g.pressure.data(), g.outX.data(), g.outY.data(),
+			g.width, g.height, 0, y0, g.width, y1);
+	}, { &Grid::outX, &Grid::outY } });
+
+	list.push_back({ "boundary", 8.0, true, [](const FluidKernels& k, Grid& g, int, int) {
+		k.boundary(g.outZ.data(), 1.0f, g.width, g.height);
+	}, { &Grid::outZ } });
+
+	return list;
+}
+
+
+// splits the rows into a few bands per thread, the perimeter kernel runs
+// on the calling thread
+static void runCase(const Case& c, const FluidKernels& kernels, Grid& grid, ThreadPool& pool) {
+	if (c.perimeter) {
+		c.run(kernels, grid, 0, grid.height);
+		return;
+	}
+
+	int bands = std::min((int)pool.size() * 4, grid.height);
+	pool.parallelFor(bands, [&](int band) {
+		int y0 = (int)((long long)grid.height * band / bands);
+		int y1 = (int)((long long)grid.height * (band + 1) / bands);
+		c.run(kernels, grid, y0, y1);
+	});
+}
+
+
+// largest difference to the scalar kernel's output
+static float compareToScalar(const Case& c, const FluidKernels& kernels, Grid& grid, ThreadPool& pool) {
+	grid.reset();
+	runCase(c, FluidKernels::scalar, grid, pool);
+	std::vector<AlignedPlane> expected;
+	for (AlignedPlane Grid::* output : c.outputs) {
+		expected.push_back(grid.*output);
+	}
+
+	grid.reset();
+	runCase(c, kernels, grid, pool);
+
+	float difference = 0.0f;
+	for (size_t o = 0; o < c.outputs.size(); o++) {
+		const AlignedPlane& actual = grid.*c.outputs[o];
+		for (size_t i = 0; i < actual.size(); i++) {
+			difference = std::max(difference, std::abs(actual[i] - expected[o][i]));
+		}
+	}
+	return difference;
+}
+
+
+int main(int argc, char** argv) {
+	int width = 2048;
+	int height = 2048;
+	unsigned int threads = 1;
+	double seconds = 0.5;
+
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+			width = std::atoi(argv[++i]);
+			height = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = (unsigned int)std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+			seconds = std::atof(argv[++i]);
+		}
+	}
+
+	if (width <= 0 || height <= 0) {
+		std::cout << "Invalid grid size " << width << "x" << height << std::endl;
+		return 1;
+	}
+
+	ThreadPool pool(threads);
+	Grid grid(width, height);
+
+	std::vector<const FluidKernels*> tables = { &FluidKernels::scalar };
+	KernelIsa widest = FluidKernels::detect();
+	if (widest != KernelIsa::SCALAR) {
+		tables.push_back(&FluidKernels::avx2);
+	}
+	if (widest == KernelIsa::AVX512) {
+		tables.push_back(&FluidKernels::avx512);
+	}
+
+	std::cout << width << "x" << height << " grid, " << pool.size() << " threads, "
+		<< (double)width * height * 4.0 / (1024.0 * 1024.0) << " MB per plane, widest kernels "
+		<< FluidKernels::best().name << std::endl << std::endl;
+	std::cout << std::left << std::setw(18) << "kernel" << std::setw(9) << "isa" << std::right
+		<< std::setw(12) << "Mtexels/s" << std::setw(10) << "GB/s" << std::setw(10) << "speedup"
+		<< "  max difference to scalar" << std::endl;
+
+	bool exact = true;
+	for (const Case& c : cases()) {
+		double texels = c.perimeter ? 2.0 * (width + height) - 4.0 : (double)width * height;
+		double scalarRate = 0.0;
+
+		for (const FluidKernels* kernels : tables) {
+			float difference = kernels == &FluidKernels::scalar ? 0.0f : compareToScalar(c, *kernels, grid, pool);
+			exact = exact && difference == 0.0f;
+
+			// one untimed run to fault in the pages and warm the caches
+			grid.reset();
+			runCase(c, *kernels, grid, pool);
+
+			int runs = 0;
+			double elapsed = 0.0;
+			auto start = std::chrono::steady_clock::now();
+			while (runs < 3 || elapsed < seconds) {
+				runCase(c, *kernels, grid, pool);
+				runs++;
+				elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			}
+
+			double rate = texels * runs / elapsed;
+			if (kernels == &FluidKernels::scalar) {
+				scalarRate = rate;
+			}
+
+			std::cout << std::left << std::setw(18) << c.name << std::setw(9) << kernels->name << std::right
+				<< std::fixed << std::setprecision(1) << std::setw(12) << rate / 1.0e6
+				<< std::setprecision(2) << std::setw(10) << rate * c.bytesPerTexel / 1.0e9
+				<< std::setw(10) << rate / scalarRate << "  ";
+			std::cout.unsetf(std::ios::fixed);
+			std::cout << std::setprecision(6) << difference << std::endl;
+		}
+	}
+
+	if (!exact) {
+		std::cout << std::endl << "Vector kernels differ from the scalar ones" << std::endl;
+		return 1;
+	}
+	return 0;
+}